@@ -0,0 +1,134 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <new>
+
+
+sfn::arena_resource::arena_resource(const size_t initial_block_size)
+   : m_next_block_size(initial_block_size)
+{
+
+}
+
+
+sfn::arena_resource::~arena_resource()
+{
+   for (const block& b : m_blocks)
+      ::operator delete(b.m_data, std::align_val_t{ alignof(std::max_align_t) });
+}
+
+
+auto sfn::arena_resource::get_marker() const -> marker
+{
+   return marker{ .m_block = m_current_block, .m_offset = m_offset };
+}
+
+
+auto sfn::arena_resource::rewind(const marker& target) -> void
+{
+   m_current_block = target.m_block;
+   m_offset = target.m_offset;
+}
+
+
+auto sfn::arena_resource::reset() -> void
+{
+   rewind(marker{});
+}
+
+
+auto sfn::arena_resource::get_stats() const -> stats
+{
+   stats result{
+      .m_allocation_count = m_allocation_count,
+      .m_upstream_allocation_count = m_upstream_allocation_count
+   };
+   for (int i = 0; i < std::ssize(m_blocks); ++i)
+   {
+      result.m_capacity += m_blocks[i].m_size;
+      if (i < m_current_block)
+         result.m_bytes_used += m_blocks[i].m_size;
+   }
+   if (m_blocks.empty() == false)
+      result.m_bytes_used += m_offset;
+   return result;
+}
+
+
+auto sfn::arena_resource::add_block(const size_t min_size) -> void
+{
+   const size_t size = std::max(m_next_block_size, min_size);
+   std::byte* data = static_cast<std::byte*>(::operator new(size, std::align_val_t{ alignof(std::max_align_t) }));
+   m_blocks.push_back(block{ .m_data = data, .m_size = size });
+   m_next_block_size = 2 * size;
+   ++m_upstream_allocation_count;
+}
+
+
+auto sfn::arena_resource::do_allocate(const size_t bytes, const size_t alignment) -> void*
+{
+   while (true)
+   {
+      if (m_current_block < std::ssize(m_blocks))
+      {
+         const block& current = m_blocks[m_current_block];
+         const uintptr_t begin = reinterpret_cast<uintptr_t>(current.m_data);
+         const uintptr_t aligned = (begin + m_offset + alignment - 1) & ~(uintptr_t{ alignment } - 1);
+         const size_t aligned_offset = aligned - begin;
+         if (aligned_offset + bytes <= current.m_size)
+         {
+            m_offset = aligned_offset + bytes;
+            ++m_allocation_count;
+            return current.m_data + aligned_offset;
+         }
+         if (m_current_block + 1 < std::ssize(m_blocks))
+         {
+            ++m_current_block;
+            m_offset = 0;
+            continue;
+         }
+      }
+      add_block(bytes + alignment);
+      m_current_block = static_cast<int>(std::ssize(m_blocks)) - 1;
+      m_offset = 0;
+   }
+}
+
+
+auto sfn::arena_resource::do_deallocate(void*, const size_t, const size_t) -> void
+{
+
+}
+
+
+auto sfn::arena_resource::do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool
+{
+   return this == &other;
+}
+
+
+auto sfn::get_thread_arena() -> arena_resource&
+{
+   thread_local arena_resource arena;
+   return arena;
+}
+
+
+sfn::arena_scope::arena_scope(arena_resource& arena)
+   : m_arena(arena)
+   , m_marker(arena.get_marker())
+{
+
+}
+
+
+sfn::arena_scope::~arena_scope()
+{
+   m_arena.rewind(m_marker);
+}
+
+
+auto sfn::arena_scope::get_resource() const -> std::pmr::memory_resource*
+{
+   return &m_arena;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+
+namespace sfn
+{
+   // Bump allocator that keeps its blocks. Deallocation is a no-op, memory comes back through rewind() and reset(),
+   // so a warmed-up arena serves repeated queries without touching the heap
+   struct arena_resource final : std::pmr::memory_resource
+   {
+      struct marker
+      {
+         int m_block = 0;
+         size_t m_offset = 0;
+      };
+
+      struct stats
+      {
+         int64_t m_allocation_count = 0;          // served from the arena
+         int64_t m_upstream_allocation_count = 0; // new blocks from the heap
+         size_t m_bytes_used = 0;
+         size_t m_capacity = 0;
+      };
+
+      explicit arena_resource(const size_t initial_block_size = 64 * 1024);
+      ~arena_resource() override;
+      arena_resource(const arena_resource&) = delete;
+      arena_resource& operator=(const arena_resource&) = delete;
+
+      [[nodiscard]] auto get_marker() const -> marker;
+      auto rewind(const marker& target) -> void;
+      auto reset() -> void;
+      [[nodiscard]] auto get_stats() const -> stats;
+
+   private:
+      struct block
+      {
+         std::byte* m_data;
+         size_t m_size;
+      };
+
+      std::vector<block> m_blocks;
+      int m_current_block = 0;
+      size_t m_offset = 0;
+      size_t m_next_block_size;
+      int64_t m_allocation_count = 0;
+      int64_t m_upstream_allocation_count = 0;
+
+      auto add_block(const size_t min_size) -> void;
+      auto do_allocate(const size_t bytes, const size_t alignment) -> void* override;
+      auto do_deallocate(void* ptr, const size_t bytes, const size_t alignment) -> void override;
+      [[nodiscard]] auto do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool override;
+   };
+
+   // Per-thread scratch arena for the graph queries
+   [[nodiscard]] auto get_thread_arena() -> arena_resource&;
+
+   // Rewinds the arena to where it was on construction. Everything allocated inside the scope must be destroyed
+   // before the scope ends, i.e. declared after it
+   struct arena_scope
+   {
+      explicit arena_scope(arena_resource& arena = get_thread_arena());
+      ~arena_scope();
+      arena_scope(const arena_scope&) = delete;
+      arena_scope& operator=(const arena_scope&) = delete;
+
+      [[nodiscard]] auto get_resource() const -> std::pmr::memory_resource*;
+
+   private:
+      arena_resource& m_arena;
+      arena_resource::marker m_marker;
+   };
+}
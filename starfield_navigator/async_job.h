@@ -0,0 +1,139 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+
+
+namespace sfn
+{
+   // Runs the newest submitted computation on its own thread. Every submission bumps the generation, asks a running
+   // computation to stop and replaces one that hasn't started yet. Only the result of the newest generation comes out,
+   // everything older is dropped
+   template<typename T>
+   struct async_job
+   {
+      // Returns nothing if it stopped early
+      using work_type = std::function<std::optional<T>(const std::stop_token&)>;
+
+      explicit async_job();
+      ~async_job();
+      async_job(const async_job&) = delete;
+      async_job& operator=(const async_job&) = delete;
+
+      auto submit(work_type&& work) -> uint64_t;
+
+      // Each result only once
+      [[nodiscard]] auto take_result() -> std::optional<T>;
+
+      // The newest generation hasn't finished yet
+      [[nodiscard]] auto is_busy() const -> bool;
+
+   private:
+      mutable std::mutex m_mutex;
+      std::condition_variable m_cv;
+      std::optional<work_type> m_pending;
+      std::stop_source m_running_stop;
+      uint64_t m_generation = 0; // of the newest submission
+      uint64_t m_finished_generation = 0;
+      std::optional<T> m_result;
+      uint64_t m_result_generation = 0;
+      bool m_stopping = false;
+      std::thread m_thread; // last, it uses everything above
+
+      auto worker_loop() -> void;
+   };
+}
+
+
+template<typename T>
+sfn::async_job<T>::async_job()
+   : m_thread([this]() { worker_loop(); })
+{
+
+}
+
+
+template<typename T>
+sfn::async_job<T>::~async_job()
+{
+   {
+      std::lock_guard lock(m_mutex);
+      m_stopping = true;
+      m_running_stop.request_stop();
+   }
+   m_cv.notify_one();
+   m_thread.join();
+}
+
+
+template<typename T>
+auto sfn::async_job<T>::submit(work_type&& work) -> uint64_t
+{
+   uint64_t generation;
+   {
+      std::lock_guard lock(m_mutex);
+      generation = ++m_generation;
+      m_result.reset(); // older than this submission
+      m_pending.emplace(std::move(work));
+      m_running_stop.request_stop();
+   }
+   m_cv.notify_one();
+   return generation;
+}
+
+
+template<typename T>
+auto sfn::async_job<T>::take_result() -> std::optional<T>
+{
+   std::lock_guard lock(m_mutex);
+   if (m_result_generation != m_generation)
+      return std::nullopt;
+   std::optional<T> result = std::move(m_result);
+   m_result.reset();
+   return result;
+}
+
+
+template<typename T>
+auto sfn::async_job<T>::is_busy() const -> bool
+{
+   std::lock_guard lock(m_mutex);
+   return m_finished_generation != m_generation;
+}
+
+
+template<typename T>
+auto sfn::async_job<T>::worker_loop() -> void
+{
+   std::unique_lock lock(m_mutex);
+   while (true)
+   {
+      m_cv.wait(lock, [&]() { return m_stopping || m_pending.has_value(); });
+      if (m_stopping)
+         return;
+
+      work_type work = std::move(*m_pending);
+      m_pending.reset();
+      const uint64_t generation = m_generation;
+      m_running_stop = std::stop_source{};
+      const std::stop_token token = m_running_stop.get_token();
+
+      lock.unlock();
+      std::optional<T> result = work(token);
+      lock.lock();
+
+      if (generation != m_generation)
+         continue;
+      m_finished_generation = generation;
+      if (result.has_value())
+      {
+         m_result = std::move(result);
+         m_result_generation = generation;
+      }
+   }
+}
@@ -0,0 +1,922 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <numbers>
+#include <random>
+#include <tuple>
+
+#include "arena.h"
+#include "chokepoints.h"
+#include "distance_kernels.h"
+#include "frame_scheduler.h"
+#include "graph.h"
+#include "mesh_lod.h"
+#include "obj_parsing.h"
+#include "render_backend.h"
+#include "scene.h"
+#include "thread_pool.h"
+#include "universe_creation.h"
+
+#pragma warning(push, 0)
+#include <fmt/format.h>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/norm.hpp>
+#pragma warning(pop)
+
+
+namespace
+{
+   using namespace sfn;
+
+
+   // Counted by the replaced global operator new below, on every thread
+   std::atomic<int64_t> heap_allocation_count = 0;
+
+
+   // Textbook O(N^2) Dijkstra that scans for the closest unvisited node, the reference for graph::get_dijkstra()
+   template<typename T>
+   [[nodiscard]] auto get_reference_distances(const graph& g, const int source, const T& weight_getter) -> std::vector<float>
+   {
+      const int node_count = static_cast<int>(std::ssize(g.m_nodes));
+      std::vector<float> distances(node_count, shortest_path::no_distance);
+      std::vector<bool> visited(node_count, false);
+      distances[source] = 0.0f;
+      while (true)
+      {
+         int closest = -1;
+         for (int i = 0; i < node_count; ++i)
+         {
+            if (visited[i] == false && distances[i] != shortest_path::no_distance && (closest == -1 || distances[i] < distances[closest]))
+               closest = i;
+         }
+         if (closest == -1)
+            return distances;
+         visited[closest] = true;
+         for (const int neighbor : g.m_nodes[closest].m_neighbor_nodes)
+            distances[neighbor] = std::min(distances[neighbor], distances[closest] + weight_getter(closest, neighbor));
+      }
+   }
+
+
+   // Same density as the neighborhood of Sol, 2000 systems in a 200 LY cube
+   [[nodiscard]] auto get_sol_density_extent(const int system_count) -> float
+   {
+      return 200.0f * std::cbrt(system_count / 2000.0f);
+   }
+
+
+   [[nodiscard]] auto get_layout_name(const universe_layout layout) -> const char*
+   {
+      switch (layout)
+      {
+      case universe_layout::uniform: return "uniform";
+      case universe_layout::clustered: return "clustered";
+      }
+      std::terminate();
+   }
+
+
+   // The system closest to the given distance from the first one, so routes have a few jumps regardless of size
+   [[nodiscard]] auto get_destination_at(const universe& univ, const float distance) -> int
+   {
+      int best = 1;
+      for (int i = 1; i < std::ssize(univ.m_systems); ++i)
+      {
+         if (std::abs(univ.get_distance(0, i, position_mode::reconstructed) - distance) < std::abs(univ.get_distance(0, best, position_mode::reconstructed) - distance))
+            best = i;
+      }
+      return best;
+   }
+
+
+   // Same format as cc_hyg.txt, HIP ids
+   auto write_synthetic_catalog(const fs::path& path, const int star_count) -> void
+   {
+      std::mt19937 rng(1);
+      std::uniform_real_distribution<float> l_dist(0.0f, 360.0f);
+      std::uniform_real_distribution<float> b_dist(-90.0f, 90.0f);
+      std::uniform_real_distribution<float> dist_dist(1.0f, 1000.0f);
+      std::uniform_real_distribution<float> mag_dist(-2.0f, 15.0f);
+      std::ofstream file(path);
+      file << "# synthetic\n";
+      for (int i = 0; i < star_count; ++i)
+         file << fmt::format("HIP_{};{:.6f};{:.6f};{:.2f};{:.2f};{:.2f}\n", i + 1, l_dist(rng), b_dist(rng), dist_dist(rng), mag_dist(rng), mag_dist(rng));
+   }
+
+
+   // Torus out of quads with v/vt/vn faces, like the C4D exports in assets/
+   auto write_synthetic_obj(const fs::path& path, const int major_segments, const int minor_segments) -> void
+   {
+      constexpr float major_radius = 100.0f;
+      constexpr float minor_radius = 30.0f;
+      constexpr float tau = 2.0f * std::numbers::pi_v<float>;
+      std::ofstream file(path);
+      file << "o Torus\nusemtl Mat\n";
+      for (int i = 0; i < major_segments; ++i)
+      {
+         for (int j = 0; j < minor_segments; ++j)
+         {
+            const float u = tau * i / major_segments;
+            const float v = tau * j / minor_segments;
+            const glm::vec3 normal{ std::cos(u) * std::cos(v), std::sin(u) * std::cos(v), std::sin(v) };
+            const glm::vec3 pos = glm::vec3{ major_radius * std::cos(u), major_radius * std::sin(u), 0.0f } + minor_radius * normal;
+            file << fmt::format("v {} {} {}\nvn {} {} {}\nvt {} {}\n", pos.x, pos.y, pos.z, normal.x, normal.y, normal.z, 1.0f * i / major_segments, 1.0f * j / minor_segments);
+         }
+      }
+      const auto get_index = [&](const int i, const int j) {
+         return (i % major_segments) * minor_segments + (j % minor_segments) + 1;
+      };
+      for (int i = 0; i < major_segments; ++i)
+      {
+         for (int j = 0; j < minor_segments; ++j)
+         {
+            file << "f";
+            for (const int index : { get_index(i, j), get_index(i + 1, j), get_index(i + 1, j + 1), get_index(i, j + 1) })
+               file << fmt::format(" {0}/{0}/{0}", index);
+            file << "\n";
+         }
+      }
+   }
+
+
+   struct benchmark_suite
+   {
+      const suite_options& m_options;
+      std::vector<benchmark_result> m_results;
+
+      template<typename T>
+      auto run(const std::string& name, const double items_per_call, const T& fn) -> void
+      {
+         if (name.find(m_options.m_filter) == std::string::npos)
+            return;
+         m_results.push_back(run_benchmark(name, items_per_call, fn, m_options.m_min_seconds));
+         print_benchmark_result(m_results.back());
+      }
+
+      auto run_universe_benchmarks(const universe& univ, const std::string& label) -> void;
+      auto run_all_pairs_benchmarks(const universe& univ, const std::string& label) -> void;
+      auto run_alignment_benchmark(const std::vector<alignment_target>& targets, const std::string& label) -> void;
+   };
+
+
+   auto benchmark_suite::run_universe_benchmarks(const universe& univ, const std::string& label) -> void
+   {
+      constexpr position_mode mode = position_mode::reconstructed;
+      const int system_count = static_cast<int>(std::ssize(univ.m_systems));
+      const double pair_count = 0.5 * system_count * (system_count - 1);
+      const int destination = get_destination_at(univ, 60.0f);
+
+      run(fmt::format("graph_build/{}", label), pair_count, [&]() {
+         return get_graph_from_universe(univ, 20.0f).m_connections.size();
+      });
+      run(fmt::format("min_jump_range/{}", label), 1.0, [&]() {
+         return get_min_jump_dist(univ, 0, destination, mode);
+      });
+
+      // Routes and betweenness with the range that just connects the pair
+      const float jump_range = get_min_jump_dist(univ, 0, destination, mode) + 0.001f;
+      run(fmt::format("route/{}", label), 1.0, [&]() {
+         return get_route(univ, 0, destination, jump_range, mode).value().m_stops.size();
+      });
+      const graph jump_graph = get_graph_from_universe(univ, jump_range);
+      run(fmt::format("dijkstra/{}", label), 1.0, [&]() {
+         const auto distance_getter = [&](const int i, const int j) {return univ.get_distance(i, j, mode); };
+         return jump_graph.get_jump_path(0, destination, distance_getter).value().m_stops.size();
+      });
+      run(fmt::format("betweenness/{}", label), system_count, [&]() {
+         return get_chokepoint_analysis(jump_graph, univ, mode).m_max_system_betweenness;
+      });
+
+      // The CPU side of one frame from the start camera, --replay has the moving version
+      const scene frame_scene{
+         .m_stars = get_star_instances(univ, mode),
+         .m_bb_trafos = get_bb_trafos(univ),
+         .m_connection_trafos = get_connection_trafos(univ, jump_graph, mode)
+      };
+      const frame_settings settings{
+         .m_camera_mode = wasd_mode{ univ.m_cam_info.m_cam_pos0 },
+         .m_position_mode = mode,
+         .m_resolution = glm::ivec2{ 1280, 720 }
+      };
+      frame_description frame;
+      null_backend backend;
+      run(fmt::format("frame/{}", label), system_count, [&]() {
+         build_frame(univ, frame_scene, settings, nullptr, frame);
+         submit_frame(backend, frame, nullptr);
+         return frame.m_labels.size();
+      });
+   }
+
+
+   // get_absolute_min_jump_range() is a min jump query per pair, only feasible for small universes
+   auto benchmark_suite::run_all_pairs_benchmarks(const universe& univ, const std::string& label) -> void
+   {
+      const int system_count = static_cast<int>(std::ssize(univ.m_systems));
+      run(fmt::format("absolute_min_jump_range/{}", label), 0.5 * system_count * (system_count - 1), [&]() {
+         return get_absolute_min_jump_range(univ, position_mode::reconstructed);
+      });
+   }
+
+
+   auto benchmark_suite::run_alignment_benchmark(const std::vector<alignment_target>& targets, const std::string& label) -> void
+   {
+      CTestOpt opt;
+      opt.m_targets = targets;
+      const std::array<double, 9> params{ 1.0, 2.0, 3.0, 1.1, 0.9, 1.0, 5.0, -5.0, 2.0 };
+      run(fmt::format("alignment_cost/{}", label), static_cast<double>(std::ssize(targets)), [&]() {
+         return opt.optcost(params.data());
+      });
+   }
+}
+
+
+// Only the plain forms, the array and nothrow ones forward to them. Aligned allocations go uncounted
+auto operator new(const std::size_t size) -> void*
+{
+   heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+   if (void* ptr = std::malloc(size == 0 ? 1 : size))
+      return ptr;
+   throw std::bad_alloc{};
+}
+
+auto operator delete(void* ptr) noexcept -> void
+{
+   std::free(ptr);
+}
+
+auto operator delete(void* ptr, std::size_t) noexcept -> void
+{
+   std::free(ptr);
+}
+
+
+auto sfn::print_benchmark_result(const benchmark_result& result) -> void
+{
+   fmt::print(
+      "{:<40} {:>12.0f} ns/it {:>14.3e} items/s ({} iterations)\n",
+      result.m_name, result.m_ns_per_iteration, result.m_items_per_second, result.m_iterations
+   );
+}
+
+
+auto sfn::write_benchmark_json(
+   const std::vector<benchmark_result>& results,
+   const std::string& path
+) -> bool
+{
+   std::ofstream file(path);
+   if (file.is_open() == false)
+      return false;
+
+#ifdef NDEBUG
+   constexpr const char* build_type = "release";
+#else
+   constexpr const char* build_type = "debug";
+#endif
+   file << "{\n  \"context\": {\n";
+   file << fmt::format("    \"num_cpus\": {},\n", std::thread::hardware_concurrency());
+   file << fmt::format("    \"threads\": {},\n", get_thread_pool().get_thread_count());
+   file << fmt::format("    \"simd_level\": \"{}\",\n", get_simd_level_name(get_simd_level()));
+   file << fmt::format("    \"library_build_type\": \"{}\"\n", build_type);
+   file << "  },\n  \"benchmarks\": [\n";
+   for (int i = 0; i < std::ssize(results); ++i)
+   {
+      const benchmark_result& result = results[i];
+      file << fmt::format(
+         "    {{\"name\": \"{0}\", \"run_name\": \"{0}\", \"run_type\": \"iteration\", \"iterations\": {1}, "
+         "\"real_time\": {2:.1f}, \"cpu_time\": {2:.1f}, \"time_unit\": \"ns\", \"items_per_second\": {3:.6e}}}{4}\n",
+         result.m_name, result.m_iterations, result.m_ns_per_iteration, result.m_items_per_second, i + 1 < std::ssize(results) ? "," : ""
+      );
+   }
+   file << "  ]\n}\n";
+   return file.good();
+}
+
+
+auto sfn::get_synthetic_universe(
+   const int system_count,
+   const float extent,
+   const uint32_t seed,
+   const universe_layout layout
+) -> universe
+{
+   std::mt19937 rng(seed);
+   std::uniform_real_distribution<float> pos_dist(-0.5f * extent, 0.5f * extent);
+   std::uniform_real_distribution<float> mag_dist(-2.0f, 15.0f);
+
+   // A cluster per 100 systems, 80% of the systems in them
+   std::vector<glm::vec3> cluster_centers(std::max(1, system_count / 100));
+   for (glm::vec3& center : cluster_centers)
+      center = glm::vec3{ pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+   std::uniform_int_distribution<int> cluster_dist(0, static_cast<int>(std::ssize(cluster_centers)) - 1);
+   std::normal_distribution<float> offset_dist(0.0f, 0.05f * extent);
+   std::uniform_real_distribution<float> unit_dist(0.0f, 1.0f);
+
+   universe result;
+   result.m_systems.reserve(system_count);
+   for (int i = 0; i < system_count; ++i)
+   {
+      glm::vec3 pos{ pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+      if (layout == universe_layout::clustered && unit_dist(rng) < 0.8f)
+         pos = cluster_centers[cluster_dist(rng)] + glm::vec3{ offset_dist(rng), offset_dist(rng), offset_dist(rng) };
+      const system_size size = (i % 2 == 0) ? system_size::big : system_size::small;
+      constexpr bool speculative = false;
+      result.m_systems.emplace_back(pos, fmt::format("SYN {}", i), "", "", size, mag_dist(rng), speculative);
+   }
+   result.init();
+   return result;
+}
+
+
+auto sfn::run_layout_benchmark(const int system_count) -> void
+{
+   const universe univ = get_synthetic_universe(system_count, 300.0f, 1);
+   const double pair_count = 0.5 * system_count * (system_count - 1);
+
+   // Array of structs: what the loops did through system::get_position()
+   const auto aos = [&]() {
+      float sum = 0.0f;
+      for (int i = 0; i < system_count; ++i)
+      {
+         const glm::vec3 pos_i = univ.m_systems[i].get_position(position_mode::reconstructed);
+         for (int j = i + 1; j < system_count; ++j)
+            sum += glm::distance(pos_i, univ.m_systems[j].get_position(position_mode::reconstructed));
+      }
+      return sum;
+   };
+
+   const auto soa = [&]() {
+      const position_arrays& positions = univ.m_arrays.get_positions(position_mode::reconstructed);
+      const float* x = positions.m_x.data();
+      const float* y = positions.m_y.data();
+      const float* z = positions.m_z.data();
+      float sum = 0.0f;
+      for (int i = 0; i < system_count; ++i)
+      {
+         for (int j = i + 1; j < system_count; ++j)
+         {
+            const float dx = x[j] - x[i];
+            const float dy = y[j] - y[i];
+            const float dz = z[j] - z[i];
+            sum += std::sqrt(dx * dx + dy * dy + dz * dz);
+         }
+      }
+      return sum;
+   };
+
+   fmt::print("all-pairs distances, {} systems\n", system_count);
+   print_benchmark_result(run_benchmark("AoS (system::get_position)", pair_count, aos));
+   print_benchmark_result(run_benchmark("SoA (universe_arrays)", pair_count, soa));
+}
+
+
+auto sfn::run_kernel_benchmark(const int system_count) -> bool
+{
+   const universe univ = get_synthetic_universe(system_count, 300.0f, 1);
+   const position_arrays& positions = univ.m_arrays.get_positions(position_mode::reconstructed);
+   const point_span all = positions.get_span();
+   const point_span shifted = positions.get_span(1, system_count); // odd offset, so loads are unaligned
+   const point_span head = positions.get_span(0, system_count - 1);
+   constexpr float radius = 30.0f;
+   constexpr int block_size = 256;
+   const point_span block_a = positions.get_span(0, std::min(block_size, system_count));
+
+   std::vector<float> out(system_count);
+   std::vector<int> indices(system_count);
+   std::vector<float> block(static_cast<size_t>(block_a.m_count) * system_count);
+
+   bool all_correct = true;
+   const simd_level supported = get_supported_simd_level();
+   fmt::print("distance kernels, {} systems, supported: {}\n", system_count, get_simd_level_name(supported));
+   for (int level_index = 0; level_index <= static_cast<int>(supported); ++level_index)
+   {
+      const simd_level level = static_cast<simd_level>(level_index);
+      set_simd_level(level);
+
+      // Correctness against glm
+      float max_error = 0.0f;
+      const auto check = [&](const float value, const float expected) {
+         max_error = std::max(max_error, std::abs(value - expected) / std::max(1.0f, expected));
+      };
+      for (int i = 0; i < system_count; i += std::max(1, system_count / 64))
+      {
+         const glm::vec3 from = positions.get(i);
+         get_distances(from, shifted, out.data());
+         for (int j = 0; j < shifted.m_count; ++j)
+            check(out[j], glm::distance(from, positions.get(j + 1)));
+
+         get_distances2(from, shifted, out.data());
+         for (int j = 0; j < shifted.m_count; ++j)
+            check(out[j], glm::distance2(from, positions.get(j + 1)));
+
+         int expected_count = 0;
+         for (int j = 1; j < system_count; ++j)
+         {
+            if (glm::distance2(from, positions.get(j)) <= radius * radius)
+               ++expected_count;
+         }
+         const int count = get_within_radius(from, shifted, radius, indices.data(), out.data());
+         if (count != expected_count)
+            all_correct = false;
+         for (int k = 0; k < count; ++k)
+            check(out[k], glm::distance2(from, positions.get(indices[k])));
+      }
+      get_paired_distances(head, shifted, out.data());
+      for (int j = 0; j < head.m_count; ++j)
+         check(out[j], glm::distance(positions.get(j), positions.get(j + 1)));
+      get_distance2_block(block_a, all, block.data());
+      for (int i = 0; i < block_a.m_count; ++i)
+      {
+         for (int j = 0; j < system_count; ++j)
+            check(block[static_cast<size_t>(i) * system_count + j], glm::distance2(positions.get(i), positions.get(j)));
+      }
+      constexpr float tolerance = 1e-5f;
+      const bool correct = all_correct && max_error < tolerance;
+      all_correct = correct;
+      fmt::print("{}: max relative error {:.2e} {}\n", get_simd_level_name(level), max_error, correct ? "ok" : "MISMATCH");
+
+      // Throughput
+      const double pair_count = static_cast<double>(system_count);
+      const auto one_to_many = [&]() {
+         get_distances(positions.get(0), all, out.data());
+         return out[system_count / 2];
+      };
+      const auto within_radius = [&]() {
+         return get_within_radius(positions.get(0), all, radius, indices.data(), out.data());
+      };
+      const auto many_to_many = [&]() {
+         get_distance2_block(block_a, all, block.data());
+         return block[block.size() / 2];
+      };
+      const std::string prefix = fmt::format("{} ", get_simd_level_name(level));
+      print_benchmark_result(run_benchmark(prefix + "one to many", pair_count, one_to_many, 0.2));
+      print_benchmark_result(run_benchmark(prefix + "within radius", pair_count, within_radius, 0.2));
+      print_benchmark_result(run_benchmark(prefix + "block", pair_count * block_a.m_count, many_to_many, 0.2));
+   }
+   set_simd_level(supported);
+   return all_correct;
+}
+
+
+auto sfn::run_scaling_benchmark(const int system_count) -> void
+{
+   // Dense enough that most pairs need several jumps
+   const universe univ = get_synthetic_universe(system_count, 60.0f, 1);
+   const int hardware_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+   std::vector<int> thread_counts;
+   for (int thread_count = 1; thread_count < std::min(hardware_threads, 64); thread_count *= 2)
+      thread_counts.push_back(thread_count);
+   thread_counts.push_back(std::min(hardware_threads, 64));
+
+   const double pair_count = 0.5 * system_count * (system_count - 1);
+   const auto min_jump_range = [&]() {
+      return get_absolute_min_jump_range(univ, position_mode::reconstructed);
+   };
+   const auto graph_build = [&]() {
+      return get_graph_from_universe(univ, 20.0f).m_connections.size();
+   };
+
+   fmt::print("thread scaling, {} systems, {} hardware threads\n", system_count, hardware_threads);
+   double min_jump_baseline = 0.0;
+   double graph_baseline = 0.0;
+   for (const int thread_count : thread_counts)
+   {
+      set_thread_count(thread_count);
+      const benchmark_result min_jump = run_benchmark(fmt::format("{:>2} threads min jump range", thread_count), pair_count, min_jump_range);
+      const benchmark_result graph = run_benchmark(fmt::format("{:>2} threads graph build", thread_count), pair_count, graph_build);
+      if (thread_count == 1)
+      {
+         min_jump_baseline = min_jump.m_ns_per_iteration;
+         graph_baseline = graph.m_ns_per_iteration;
+      }
+      print_benchmark_result(min_jump);
+      print_benchmark_result(graph);
+      const double min_jump_speedup = min_jump_baseline / min_jump.m_ns_per_iteration;
+      fmt::print(
+         "   speedup {:.2f}x ({:.0f}% efficiency), graph build {:.2f}x\n",
+         min_jump_speedup, 100.0 * min_jump_speedup / thread_count, graph_baseline / graph.m_ns_per_iteration
+      );
+   }
+   set_thread_count(hardware_threads);
+}
+
+
+auto sfn::run_arena_benchmark(const int system_count) -> bool
+{
+   const universe univ = get_synthetic_universe(system_count, 60.0f, 1);
+   const auto run_queries = [&]() {
+      float sum = 0.0f;
+      for (int j = 1; j < system_count; ++j)
+         sum += get_min_jump_dist(univ, 0, j, position_mode::reconstructed);
+      return sum;
+   };
+
+   const arena_resource& arena = get_thread_arena();
+   std::ignore = run_queries(); // warmup, grows the arena and the row scratch to their working size
+   const arena_resource::stats before = arena.get_stats();
+   const int64_t heap_before = heap_allocation_count.load();
+   std::ignore = run_queries();
+   const int64_t heap_allocations = heap_allocation_count.load() - heap_before;
+   const arena_resource::stats after = arena.get_stats();
+
+   const int query_count = system_count - 1;
+   fmt::print("min jump queries, {} systems\n", system_count);
+   fmt::print(
+      "arena allocations per query: {:.1f}, heap allocations after warmup: {}, arena capacity: {} KB\n",
+      static_cast<double>(after.m_allocation_count - before.m_allocation_count) / query_count,
+      heap_allocations,
+      after.m_capacity / 1024
+   );
+   print_benchmark_result(run_benchmark("min jump queries", query_count, run_queries));
+   return heap_allocations == 0;
+}
+
+
+auto sfn::run_dijkstra_benchmark(const int system_count) -> bool
+{
+   constexpr position_mode mode = position_mode::reconstructed;
+   const universe univ = get_synthetic_universe(system_count, get_sol_density_extent(system_count), 1);
+   const graph jump_graph = get_graph_from_universe(univ, 20.0f);
+   const auto distance_getter = [&](const int i, const int j) {return univ.get_distance(i, j, mode); };
+
+   // Distances have to match the reference exactly. Ties can pick other predecessors, so those only have to add up
+   bool all_correct = true;
+   for (int source = 0; source < system_count; source += std::max(1, system_count / 16))
+   {
+      const shortest_path_tree tree = jump_graph.get_dijkstra(source, distance_getter);
+      const std::vector<float> expected = get_reference_distances(jump_graph, source, distance_getter);
+      int mismatch_count = 0;
+      for (int i = 0; i < system_count; ++i)
+      {
+         const shortest_path& entry = tree.m_entries[i];
+         bool correct = entry.m_shortest_distance == expected[i];
+         if (entry.m_previous_vertex_index.has_value())
+         {
+            const int previous = *entry.m_previous_vertex_index;
+            correct = correct && tree.get_distance_from_source(previous) + distance_getter(previous, i) == entry.m_shortest_distance;
+         }
+         else
+         {
+            correct = correct && (i == source || entry.m_shortest_distance == shortest_path::no_distance);
+         }
+         mismatch_count += correct == false;
+      }
+      all_correct = all_correct && mismatch_count == 0;
+      if (mismatch_count > 0)
+         fmt::print("source {}: {} MISMATCH\n", source, mismatch_count);
+   }
+   fmt::print("dijkstra against the reference, {} systems, {} connections: {}\n", system_count, jump_graph.m_connections.size(), all_correct ? "ok" : "MISMATCH");
+
+   print_benchmark_result(run_benchmark("dijkstra", 1.0, [&]() {
+      return jump_graph.get_dijkstra(0, distance_getter).m_entries.size();
+   }));
+   print_benchmark_result(run_benchmark("reference dijkstra", 1.0, [&]() {
+      return get_reference_distances(jump_graph, 0, distance_getter).size();
+   }));
+   return all_correct;
+}
+
+
+auto sfn::run_catalog_benchmark(const int star_count) -> bool
+{
+   // Roughly the star density around Sol, 0.004 per cubic light-year
+   std::mt19937 rng(1);
+   const float extent = std::cbrt(star_count / 0.004f);
+   std::uniform_real_distribution<float> pos_dist(-0.5f * extent, 0.5f * extent);
+   std::uniform_real_distribution<float> mag_dist(-2.0f, 15.0f);
+   std::vector<catalog_star> stars;
+   stars.reserve(star_count);
+   for (int i = 0; i < star_count; ++i)
+      stars.push_back(catalog_star{ .m_position = { pos_dist(rng), pos_dist(rng), pos_dist(rng) }, .m_abs_mag = mag_dist(rng), .m_name = fmt::format("CAT {}", i), .m_known = i % 100 == 0 });
+   const star_catalog catalog = get_star_catalog(stars);
+
+   const glm::mat4 trafo = glm::rotate(glm::translate(glm::mat4{ 1.0f }, glm::vec3{ 30, -10, 5 }), 0.7f, glm::vec3{ 0, 1, 0 });
+   const std::vector<std::pair<std::string, catalog_query>> queries{
+      { "sphere, bright", catalog_query{ .m_region = sphere{ .m_center = { 40, 0, 0 }, .m_radius = 60.0f }, .m_max_abs_mag = 5.0f } },
+      { "box, distance band", catalog_query{ .m_region = bb_3D{ .m_min = { -100, -20, -20 }, .m_max = { 0, 20, 20 } }, .m_min_distance = 30.0f, .m_max_distance = 80.0f } },
+      { "transformed box, scored", catalog_query{
+         .m_region = transformed_bb{ .m_bb = bb_3D{ .m_min = { -60, -30, -30 }, .m_max = { 0, 30, 30 } }, .m_trafo = trafo },
+         .m_min_abs_mag = 0.0f, .m_max_abs_mag = 10.0f,
+         .m_weights = candidate_score_weights{ .m_brightness = 1.0f, .m_closeness = 0.05f, .m_centrality = 0.02f }
+      } }
+   };
+
+   // Full scan with the same tests, only counting
+   const auto get_full_scan_count = [&](const catalog_query& query) {
+      const glm::mat4 inverse_trafo = std::holds_alternative<transformed_bb>(query.m_region) ? glm::inverse(std::get<transformed_bb>(query.m_region).m_trafo) : glm::mat4{ 1.0f };
+      int count = 0;
+      for (const catalog_star& star : stars)
+      {
+         const float distance = glm::distance(star.m_position, query.m_band_center);
+         bool inside = false;
+         if (const sphere* s = std::get_if<sphere>(&query.m_region))
+            inside = glm::distance2(star.m_position, s->m_center) <= s->m_radius * s->m_radius;
+         else
+         {
+            const bb_3D& bb = std::holds_alternative<bb_3D>(query.m_region) ? std::get<bb_3D>(query.m_region) : std::get<transformed_bb>(query.m_region).m_bb;
+            const glm::vec3 pos = apply_trafo(inverse_trafo, star.m_position);
+            inside = glm::all(glm::greaterThanEqual(pos, bb.m_min)) && glm::all(glm::lessThanEqual(pos, bb.m_max));
+         }
+         count += inside
+            && star.m_abs_mag >= query.m_min_abs_mag && star.m_abs_mag <= query.m_max_abs_mag
+            && (query.m_exclude_known == false || star.m_known == false)
+            && distance >= query.m_min_distance && distance <= query.m_max_distance;
+      }
+      return count;
+   };
+
+   fmt::print("catalog queries, {} stars, {} cells\n", star_count, std::ssize(catalog.m_cell_offsets) - 1);
+   bool all_match = true;
+   for (const auto& [name, query] : queries)
+   {
+      const int match_count = catalog.query(query).m_match_count;
+      const int expected_count = get_full_scan_count(query);
+      if (match_count != expected_count)
+      {
+         fmt::print("{}: {} matches, full scan has {}\n", name, match_count, expected_count);
+         all_match = false;
+      }
+      print_benchmark_result(run_benchmark(fmt::format("{} ({} matches)", name, match_count), 1.0, [&]() {
+         return catalog.query(query).m_match_count;
+      }));
+   }
+   return all_match;
+}
+
+
+auto sfn::run_scheduler_benchmark() -> bool
+{
+   // Power of two steps, so the linger and the animation intervals fall exactly on them
+   constexpr double step = 1.0 / 1024.0;
+   constexpr int step_count = 2048;
+   struct timeline_result
+   {
+      int m_draw_count = 0;
+      double m_last_wait = 0.0;
+      bool m_waits_correct = true; // no decision sleeps past the next animation frame
+   };
+   const auto run_timeline = [&](frame_scheduler& scheduler, const double animation_fps) {
+      timeline_result result;
+      for (int i = 0; i < step_count; ++i)
+      {
+         const double now = i * step;
+         const frame_decision decision = scheduler.decide(now, animation_fps);
+         if (decision.m_draw)
+         {
+            scheduler.mark_drawn(now);
+            ++result.m_draw_count;
+            continue;
+         }
+         result.m_last_wait = decision.m_wait_seconds;
+         if (animation_fps > 0.0 && now + decision.m_wait_seconds > scheduler.m_last_draw_time + 1.0 / animation_fps)
+            result.m_waits_correct = false;
+      }
+      return result;
+   };
+
+   bool all_correct = true;
+   const auto check = [&](const char* name, const bool correct, const int draw_count) {
+      all_correct = all_correct && correct;
+      fmt::print("{}: {} draws in {} steps {}\n", name, draw_count, step_count, correct ? "ok" : "MISMATCH");
+   };
+
+   // Full rate for the linger after an invalidation, then it sleeps as long as it may
+   {
+      frame_scheduler scheduler;
+      scheduler.invalidate(redraw_input, 0.0);
+      const timeline_result result = run_timeline(scheduler, 0.0);
+      const int linger_steps = static_cast<int>(scheduler.m_config.m_linger_seconds / step);
+      check("linger", result.m_draw_count == linger_steps && result.m_last_wait == scheduler.m_config.m_max_wait_seconds, result.m_draw_count);
+   }
+
+   // Only animation frames, and the waits end on them
+   {
+      constexpr double animation_fps = 16.0;
+      frame_scheduler scheduler;
+      const timeline_result result = run_timeline(scheduler, animation_fps);
+      const int expected = static_cast<int>(step_count * step * animation_fps);
+      check("animation", result.m_draw_count == expected && result.m_waits_correct, result.m_draw_count);
+   }
+
+   // Disabled draws every time
+   {
+      frame_scheduler scheduler;
+      scheduler.m_enabled = false;
+      const timeline_result result = run_timeline(scheduler, 0.0);
+      check("disabled", result.m_draw_count == step_count, result.m_draw_count);
+   }
+
+   frame_scheduler scheduler;
+   scheduler.mark_drawn(0.0);
+   print_benchmark_result(run_benchmark("decide", 1.0, [&]() {
+      return scheduler.decide(0.25, 60.0).m_wait_seconds;
+   }, 0.2));
+   return all_correct;
+}
+
+
+auto sfn::run_lod_benchmark(const int star_count) -> bool
+{
+   bool all_correct = true;
+
+   // Meshes: triangle counts and everything on the unit sphere
+   const lod_meshes sphere_lods = get_sphere_lods();
+   for (int level = 0; level < lod_count; ++level)
+   {
+      float max_error = 0.0f;
+      for (int i = 0; i < sphere_lods.m_count[level]; ++i)
+         max_error = std::max(max_error, std::abs(glm::length(sphere_lods.m_vertices[sphere_lods.m_first[level] + i].m_position) - 1.0f));
+      const int subdivisions = lod_count - level;
+      const bool correct = sphere_lods.m_count[level] == 60 * (1 << (2 * subdivisions)) && max_error < 1e-5f;
+      all_correct = all_correct && correct;
+      fmt::print("sphere level {}: {} triangles {}\n", level, sphere_lods.m_count[level] / 3, correct ? "ok" : "MISMATCH");
+   }
+   if (std::ssize(get_cylinder(16)) != 12 * 16)
+   {
+      fmt::print("cylinder: wrong vertex count\n");
+      all_correct = false;
+   }
+
+   // Looking into a cube of stars from its edge, so there are all levels and culled ones
+   const universe univ = get_synthetic_universe(star_count, 300.0f, 1);
+   const point_span positions = univ.m_arrays.get_positions(position_mode::reconstructed).get_span(1, star_count); // unaligned
+   const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+   const glm::mat4 view = glm::lookAt(glm::vec3{ -150, 20, 10 }, glm::vec3{ 0, 0, 0 }, glm::vec3{ 0, 0, 1 });
+   constexpr float viewport_height = 1080.0f;
+   constexpr float radius = 0.3f;
+   const lod_projection lod_proj = get_lod_projection(projection, view, viewport_height, radius);
+   const lod_thresholds thresholds{};
+
+   // Reference with glm. Stars within rounding of a threshold or the frustum border may go either way
+   const glm::mat4 view_projection = projection * view;
+   const glm::vec2 extent{ radius * std::abs(projection[0][0]), radius * std::abs(projection[1][1]) };
+   std::vector<uint8_t> expected(positions.m_count);
+   std::vector<bool> borderline(positions.m_count);
+   for (int i = 0; i < positions.m_count; ++i)
+   {
+      const glm::vec4 clip = view_projection * glm::vec4{ positions.m_x[i], positions.m_y[i], positions.m_z[i], 1.0f };
+      const bool visible = clip.w > 0.0f && std::abs(clip.x) <= clip.w + extent.x && std::abs(clip.y) <= clip.w + extent.y;
+      const float size = visible ? lod_proj.m_pixel_numerator / clip.w : -1.0f;
+      constexpr float epsilon = 1e-4f;
+      bool near_border = std::abs(clip.w) < epsilon
+         || std::abs(std::abs(clip.x) - clip.w - extent.x) < epsilon * std::abs(clip.w)
+         || std::abs(std::abs(clip.y) - clip.w - extent.y) < epsilon * std::abs(clip.w);
+      uint8_t level = size < 0.0f ? 1 : 0;
+      for (const float threshold : thresholds.m_min_pixels)
+      {
+         level += size < threshold;
+         near_border = near_border || std::abs(size - threshold) < epsilon * threshold;
+      }
+      expected[i] = level;
+      borderline[i] = near_border;
+   }
+   std::array<int, culled_level + 1> level_counts{};
+   for (const uint8_t level : expected)
+      ++level_counts[level];
+   fmt::print("lod levels, {} stars: {} {} {} impostors {} culled {}\n", positions.m_count, level_counts[0], level_counts[1], level_counts[2], level_counts[impostor_level], level_counts[culled_level]);
+
+   std::vector<uint8_t> levels(positions.m_count);
+   lod_buckets buckets;
+   const simd_level supported = get_supported_simd_level();
+   for (int level_index = 0; level_index <= static_cast<int>(supported); ++level_index)
+   {
+      const simd_level level = static_cast<simd_level>(level_index);
+      set_simd_level(level);
+      get_lod_levels(lod_proj, positions, thresholds, levels.data());
+      int mismatch_count = 0;
+      for (int i = 0; i < positions.m_count; ++i)
+         mismatch_count += levels[i] != expected[i] && borderline[i] == false;
+
+      // Buckets are sorted by level and keep the original order within one
+      bucket_by_level(levels, buckets);
+      for (int l = 0; l <= culled_level; ++l)
+      {
+         for (int k = buckets.m_offsets[l]; k < buckets.m_offsets[l + 1]; ++k)
+         {
+            const bool in_order = k == buckets.m_offsets[l] || buckets.m_indices[k - 1] < buckets.m_indices[k];
+            mismatch_count += levels[buckets.m_indices[k]] != l || in_order == false;
+         }
+      }
+      mismatch_count += buckets.m_offsets[culled_level + 1] != positions.m_count;
+      const bool correct = mismatch_count == 0;
+      all_correct = all_correct && correct;
+      fmt::print("{}: {} mismatches {}\n", get_simd_level_name(level), mismatch_count, correct ? "ok" : "MISMATCH");
+
+      const std::string prefix = fmt::format("{} ", get_simd_level_name(level));
+      print_benchmark_result(run_benchmark(prefix + "lod levels", positions.m_count, [&]() {
+         get_lod_levels(lod_proj, positions, thresholds, levels.data());
+         return levels[positions.m_count / 2];
+      }, 0.2));
+   }
+   set_simd_level(supported);
+   print_benchmark_result(run_benchmark("bucketing", positions.m_count, [&]() {
+      bucket_by_level(levels, buckets);
+      return buckets.m_offsets[impostor_level];
+   }, 0.2));
+   return all_correct;
+}
+
+
+auto sfn::run_benchmark_suite(const suite_options& options) -> bool
+{
+   benchmark_suite suite{ .m_options = options };
+   const int system_count = options.m_system_count;
+   fmt::print("benchmark suite, {} systems, {} threads\n", system_count, get_thread_pool().get_thread_count());
+
+   for (const universe_layout layout : { universe_layout::uniform, universe_layout::clustered })
+   {
+      const std::string label = fmt::format("{}/{}", get_layout_name(layout), system_count);
+      const universe univ = get_synthetic_universe(system_count, get_sol_density_extent(system_count), 1, layout);
+      suite.run_universe_benchmarks(univ, label);
+
+      std::vector<alignment_target> targets;
+      for (int i = 0; i < system_count; ++i)
+      {
+         const glm::vec3 pos = univ.m_arrays.get_positions(position_mode::reconstructed).get(i);
+         targets.push_back(alignment_target{ .m_fiction_pos = pos, .m_real_pos = 1.1f * pos + glm::vec3{ 3, 2, 1 } });
+      }
+      suite.run_alignment_benchmark(targets, label);
+
+      constexpr int small_count = 40;
+      suite.run_all_pairs_benchmarks(get_synthetic_universe(small_count, 60.0f, 1, layout), fmt::format("{}/{}", get_layout_name(layout), small_count));
+   }
+
+   // Real data, the catalog needs to be built with catalogs/build_hyg_cc.py first
+   if (fs::exists("cc_hyg.txt") && fs::exists("system_data.txt"))
+   {
+      suite.run("catalog_load/real", 1.0, []() {
+         return get_real_entries("cc_hyg.txt").m_stars.size();
+      });
+      universe_creator creator;
+      creator_result result = 0.0f;
+      while (std::holds_alternative<float>(result))
+         result = creator.get();
+      const universe& univ = std::get<universe>(result);
+      suite.run_universe_benchmarks(univ, "real");
+      suite.run_all_pairs_benchmarks(univ, "real");
+      suite.run_alignment_benchmark(creator.opt.m_targets, "real");
+   }
+   else
+   {
+      fmt::print("cc_hyg.txt or system_data.txt not found, skipping the real universe\n");
+   }
+
+   // Files
+   const fs::path catalog_path = fs::temp_directory_path() / "sfn_benchmark_catalog.txt";
+   constexpr int catalog_star_count = 100'000;
+   write_synthetic_catalog(catalog_path, catalog_star_count);
+   suite.run(fmt::format("catalog_load/synthetic/{}", catalog_star_count), catalog_star_count, [&]() {
+      return get_real_entries(catalog_path.string()).m_stars.size();
+   });
+   fs::remove(catalog_path);
+
+   const fs::path obj_path = fs::temp_directory_path() / "sfn_benchmark_torus.obj";
+   for (const auto [major_segments, minor_segments] : { std::pair{ 48, 24 }, std::pair{ 512, 256 } })
+   {
+      const int face_count = major_segments * minor_segments;
+      write_synthetic_obj(obj_path, major_segments, minor_segments);
+      suite.run(fmt::format("obj_load/synthetic/{}", face_count), face_count, [&]() {
+         return get_complete_obj_info(obj_path, -1.0f).m_vertices.size();
+      });
+      suite.run(fmt::format("obj_load_smoothed/synthetic/{}", face_count), face_count, [&]() {
+         return get_complete_obj_info(obj_path, 0.5f).m_vertices.size();
+      });
+
+      // The first call cooks, the rest load the cache
+      (void)get_cooked_obj_info(obj_path, -1.0f);
+      suite.run(fmt::format("obj_load_cooked/synthetic/{}", face_count), face_count, [&]() {
+         return get_cooked_obj_info(obj_path, -1.0f).m_vertices.size();
+      });
+      fs::remove(obj_path);
+      fs::remove(fs::path(obj_path) += ".meshcache");
+   }
+   for (const char* asset : { "assets/Sphere.obj", "assets/Cylinder.obj" })
+   {
+      if (fs::exists(asset))
+      {
+         suite.run(fmt::format("obj_load/{}", fs::path(asset).stem().string()), 1.0, [&]() {
+            return get_complete_obj_info(asset, -1.0f).m_vertices.size();
+         });
+         suite.run(fmt::format("obj_load_cooked/{}", fs::path(asset).stem().string()), 1.0, [&]() {
+            return get_cooked_obj_info(asset, -1.0f).m_vertices.size();
+         });
+      }
+   }
+
+   if (options.m_json_path.has_value())
+   {
+      if (write_benchmark_json(suite.m_results, *options.m_json_path) == false)
+      {
+         fmt::print("couldn't write {}\n", *options.m_json_path);
+         return false;
+      }
+      fmt::print("wrote {} results to {}\n", std::ssize(suite.m_results), *options.m_json_path);
+   }
+   return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "universe.h"
+
+
+namespace sfn
+{
+   struct benchmark_result
+   {
+      std::string m_name;
+      int m_iterations = 0;
+      double m_ns_per_iteration = 0.0;
+      double m_items_per_second = 0.0;
+   };
+
+   // Calls fn until min_seconds have passed and reports the mean duration. fn returns something that depends on the
+   // work so it can't be optimized away
+   template<typename T>
+   [[nodiscard]] auto run_benchmark(const std::string& name, const double items_per_call, const T& fn, const double min_seconds = 0.5) -> benchmark_result;
+   auto print_benchmark_result(const benchmark_result& result) -> void;
+
+   // Google Benchmark's JSON layout, so its compare.py and other tooling can read it
+   [[nodiscard]] auto write_benchmark_json(const std::vector<benchmark_result>& results, const std::string& path) -> bool;
+
+   // uniform: evenly in a cube. clustered: most systems in gaussian blobs, the rest as uniform background
+   enum class universe_layout{uniform, clustered};
+   [[nodiscard]] auto get_synthetic_universe(const int system_count, const float extent, const uint32_t seed, const universe_layout layout = universe_layout::uniform) -> universe;
+
+   struct suite_options
+   {
+      int m_system_count = 2000;
+      std::string m_filter; // only benchmarks with this in their name
+      std::optional<std::string> m_json_path;
+      double m_min_seconds = 0.3;
+   };
+
+   // Graph build, routing, min jump range, all-pairs analysis, alignment cost, catalog and OBJ loading on synthetic
+   // universes, plus the real data if cc_hyg.txt and system_data.txt are there. Returns false if the JSON can't be
+   // written
+   [[nodiscard]] auto run_benchmark_suite(const suite_options& options) -> bool;
+
+   auto run_layout_benchmark(const int system_count) -> void;
+
+   // Checks every supported SIMD level against glm, then times it. Returns false on a mismatch
+   [[nodiscard]] auto run_kernel_benchmark(const int system_count) -> bool;
+
+   // Absolute min jump range and the graph build with 1, 2, 4... threads up to the hardware, at most 64
+   auto run_scaling_benchmark(const int system_count) -> void;
+
+   // Min jump queries out of the thread arena. Returns false if the warmed-up queries still allocate on the heap, in
+   // or outside the arena
+   [[nodiscard]] auto run_arena_benchmark(const int system_count) -> bool;
+
+   // Dijkstra from a spread of sources against a plain O(N^2) reference. Returns false if a distance or predecessor
+   // doesn't match
+   [[nodiscard]] auto run_dijkstra_benchmark(const int system_count) -> bool;
+
+   // Catalog region queries with attribute filters on a synthetic catalog, checked against a full scan. Returns false
+   // on a mismatch
+   [[nodiscard]] auto run_catalog_benchmark(const int star_count) -> bool;
+
+   // Frame scheduler decisions on simulated timelines: the linger after an invalidation, animation rates and the
+   // disabled scheduler. Returns false if a decision is off
+   [[nodiscard]] auto run_scheduler_benchmark() -> bool;
+
+   // Star LOD levels for every supported SIMD level against glm, the bucketing and the procedural meshes. Returns
+   // false on a mismatch
+   [[nodiscard]] auto run_lod_benchmark(const int star_count) -> bool;
+}
+
+
+template<typename T>
+auto sfn::run_benchmark(
+   const std::string& name,
+   const double items_per_call,
+   const T& fn,
+   const double min_seconds
+) -> benchmark_result
+{
+   using clock = std::chrono::high_resolution_clock;
+   static volatile double sink = 0.0;
+
+   sink = sink + static_cast<double>(fn()); // warmup
+
+   int iterations = 0;
+   const auto t0 = clock::now();
+   auto t1 = t0;
+   do
+   {
+      sink = sink + static_cast<double>(fn());
+      ++iterations;
+      t1 = clock::now();
+   } while (std::chrono::duration<double>(t1 - t0).count() < min_seconds);
+
+   const double total_ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+   const double ns_per_iteration = total_ns / iterations;
+   return benchmark_result{
+      .m_name = name,
+      .m_iterations = iterations,
+      .m_ns_per_iteration = ns_per_iteration,
+      .m_items_per_second = items_per_call / (ns_per_iteration * 1e-9)
+   };
+}
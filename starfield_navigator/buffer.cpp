@@ -567,6 +567,12 @@ sfn::vao::vao(
 }
 
 
+sfn::vao::vao()
+{
+   glCreateVertexArrays(1, &m_vao_id);
+}
+
+
 auto sfn::vao::bind() const -> void
 {
    glBindVertexArray(m_vao_id);
@@ -168,6 +168,9 @@ namespace sfn
 
       explicit vao(const buffers& buffers, const id vbo_id, const shader_program& shader, const std::optional<GLuint> index_buffer_opengl_id);
       explicit vao(const buffers& buffers, const id vbo_id, const shader_program& shader);
+
+      // Without any attributes, for draws that only use gl_VertexID
+      explicit vao();
       auto bind() const -> void;
    };
 
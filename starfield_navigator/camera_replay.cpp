@@ -0,0 +1,310 @@
+#include "camera_replay.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "render_backend.h"
+#include "scene.h"
+#include "tools.h"
+
+#pragma warning(push, 0)
+#include <fmt/format.h>
+#include <glm/geometric.hpp>
+#pragma warning(pop)
+
+
+namespace
+{
+   using namespace sfn;
+
+
+   [[nodiscard]] auto get_ns_since(const std::chrono::high_resolution_clock::time_point& t0) -> int64_t
+   {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - t0).count();
+   }
+
+
+   // For CSV headers, no spaces
+   [[nodiscard]] auto get_replay_phase_column(const replay_phase phase) -> const char*
+   {
+      switch (phase)
+      {
+      case replay_phase::culling: return "culling_ns";
+      case replay_phase::label_projection: return "label_projection_ns";
+      case replay_phase::list: return "list_ns";
+      case replay_phase::upload: return "upload_ns";
+      }
+      std::terminate();
+   }
+
+
+   struct phase_summary
+   {
+      double m_mean_us = 0.0;
+      double m_p95_us = 0.0;
+      double m_max_us = 0.0;
+   };
+
+
+   [[nodiscard]] auto get_summary(std::vector<int64_t> values) -> phase_summary
+   {
+      if (values.empty())
+         return phase_summary{};
+      std::ranges::sort(values);
+      double sum = 0.0;
+      for (const int64_t value : values)
+         sum += static_cast<double>(value);
+      const size_t p95_index = std::min(values.size() - 1, static_cast<size_t>(0.95 * values.size()));
+      return phase_summary{
+         .m_mean_us = sum / std::size(values) / 1000.0,
+         .m_p95_us = values[p95_index] / 1000.0,
+         .m_max_us = values.back() / 1000.0
+      };
+   }
+}
+
+
+auto sfn::camera_path::get_frame_count() const -> int
+{
+   if (m_keyframes.empty())
+      return 0;
+   return m_keyframes.back().m_frame + 1;
+}
+
+
+auto sfn::camera_path::get_pose(const int frame) const -> camera_pose
+{
+   const auto next = std::ranges::upper_bound(m_keyframes, frame, {}, &camera_keyframe::m_frame);
+   if (next == std::begin(m_keyframes))
+      return m_keyframes.front().m_pose;
+   if (next == std::end(m_keyframes))
+      return m_keyframes.back().m_pose;
+   const camera_keyframe& a = *std::prev(next);
+   const camera_keyframe& b = *next;
+   const float t = static_cast<float>(frame - a.m_frame) / (b.m_frame - a.m_frame);
+   return camera_pose{
+      .m_pos = glm::mix(a.m_pose.m_pos, b.m_pose.m_pos, t),
+      .m_target = glm::mix(a.m_pose.m_target, b.m_pose.m_target, t)
+   };
+}
+
+
+auto sfn::get_trailer_path(const cam_info& info) -> camera_path
+{
+   // trailer_mode advances by 0.002 per frame
+   constexpr int frame_count = 500;
+   const auto get_keyframe = [&](const int frame, const glm::vec3& pos) {
+      return camera_keyframe{ .m_frame = frame, .m_pose = camera_pose{.m_pos = pos, .m_target = pos + info.m_cs.m_front } };
+   };
+   return camera_path{
+      .m_keyframes = { get_keyframe(0, info.m_cam_pos0), get_keyframe(frame_count - 1, info.m_cam_pos1) }
+   };
+}
+
+
+auto sfn::read_camera_path(const std::string& filename) -> std::optional<camera_path>
+{
+   std::ifstream input(filename);
+   if (input.is_open() == false)
+      return std::nullopt;
+
+   camera_path result;
+   for (std::string line; getline(input, line); )
+   {
+      line = get_trimmed_str(line.substr(0, line.find('#')));
+      if (line.empty())
+         continue;
+      const std::vector<std::string> split = get_split_string(line, ";");
+      if (split.size() != 7)
+         return std::nullopt;
+      result.m_keyframes.push_back(camera_keyframe{
+         .m_frame = std::stoi(split[0]),
+         .m_pose = camera_pose{
+            .m_pos = { std::stof(split[1]), std::stof(split[2]), std::stof(split[3]) },
+            .m_target = { std::stof(split[4]), std::stof(split[5]), std::stof(split[6]) }
+         }
+      });
+   }
+   if (result.m_keyframes.empty())
+      return std::nullopt;
+   std::ranges::stable_sort(result.m_keyframes, {}, &camera_keyframe::m_frame);
+   return result;
+}
+
+
+auto sfn::write_camera_path(const camera_path& path, const std::string& filename) -> bool
+{
+   std::ofstream file(filename);
+   if (file.is_open() == false)
+      return false;
+   file << "# frame;x;y;z;target x;target y;target z\n";
+   for (const camera_keyframe& keyframe : path.m_keyframes)
+   {
+      const glm::vec3& pos = keyframe.m_pose.m_pos;
+      const glm::vec3& target = keyframe.m_pose.m_target;
+      file << fmt::format("{};{};{};{};{};{};{}\n", keyframe.m_frame, pos.x, pos.y, pos.z, target.x, target.y, target.z);
+   }
+   return file.good();
+}
+
+
+auto sfn::cull_systems(
+   const universe& univ,
+   const position_mode mode,
+   const glm::mat4& view_projection,
+   std::vector<int>& visible
+) -> void
+{
+   constexpr float margin = 1.2f; // in NDC
+   visible.clear();
+   const position_arrays& positions = univ.m_arrays.get_positions(mode);
+   for (int i = 0; i < positions.size(); ++i)
+   {
+      const glm::vec4 clip = view_projection * glm::vec4{ positions.get(i), 1.0f };
+      if (clip.w <= 0.0f)
+         continue;
+      const float limit = margin * clip.w;
+      if (std::abs(clip.x) <= limit && std::abs(clip.y) <= limit && clip.z <= clip.w)
+         visible.push_back(i);
+   }
+}
+
+
+auto sfn::project_labels(
+   const universe& univ,
+   const position_mode mode,
+   const glm::mat4& view_projection,
+   const glm::vec2& resolution,
+   const glm::vec3& cam_pos,
+   const std::span<const int> visible,
+   std::vector<label_placement>& placements
+) -> void
+{
+   placements.clear();
+   const position_arrays& positions = univ.m_arrays.get_positions(mode);
+   for (const int i : visible)
+   {
+      if (univ.m_systems[i].get_useful_name().has_value() == false)
+         continue;
+      const glm::vec3 position = positions.get(i);
+      const glm::vec4 clip = view_projection * glm::vec4{ position, 1.0f };
+      glm::vec2 screen_pos = 0.5f * (glm::vec2(clip) / clip.w + 1.0f);
+      screen_pos[1] = 1.0f - screen_pos[1];
+      placements.push_back(label_placement{
+         .m_system_index = i,
+         .m_screen_pos = screen_pos * resolution,
+         .m_distance = glm::distance(cam_pos, position)
+      });
+   }
+}
+
+
+auto sfn::get_replay_phase_name(const replay_phase phase) -> const char*
+{
+   switch (phase)
+   {
+   case replay_phase::culling: return "culling";
+   case replay_phase::label_projection: return "label projection";
+   case replay_phase::list: return "list";
+   case replay_phase::upload: return "upload";
+   }
+   std::terminate();
+}
+
+
+sfn::scoped_phase_timer::scoped_phase_timer(replay_frame* frame, const replay_phase phase)
+   : m_frame(frame)
+   , m_phase(phase)
+   , m_t0(std::chrono::high_resolution_clock::now())
+{
+
+}
+
+
+sfn::scoped_phase_timer::~scoped_phase_timer()
+{
+   if (m_frame != nullptr)
+      m_frame->m_phase_ns[static_cast<int>(m_phase)] += get_ns_since(m_t0);
+}
+
+
+auto sfn::get_replay_report_text(const replay_report& report) -> std::string
+{
+   std::string result = fmt::format("{} frames{}\n", std::ssize(report.m_frames), report.m_headless ? ", headless" : "");
+   result += fmt::format("{:<17} {:>8} {:>8} {:>8}\n", "us", "mean", "p95", "max");
+   const auto print_row = [&](const char* name, const auto& getter) {
+      std::vector<int64_t> values;
+      values.reserve(report.m_frames.size());
+      for (const replay_frame& frame : report.m_frames)
+         values.push_back(getter(frame));
+      const phase_summary summary = get_summary(std::move(values));
+      result += fmt::format("{:<17} {:>8.1f} {:>8.1f} {:>8.1f}\n", name, summary.m_mean_us, summary.m_p95_us, summary.m_max_us);
+   };
+   for (int i = 0; i < replay_phase_count; ++i)
+   {
+      if (report.m_headless && static_cast<replay_phase>(i) == replay_phase::list)
+         continue;
+      print_row(get_replay_phase_name(static_cast<replay_phase>(i)), [&](const replay_frame& frame) {return frame.m_phase_ns[i]; });
+   }
+   print_row("cpu total", [](const replay_frame& frame) {return frame.m_cpu_ns; });
+   return result;
+}
+
+
+auto sfn::write_replay_csv(const replay_report& report, const std::string& filename) -> bool
+{
+   std::ofstream file(filename);
+   if (file.is_open() == false)
+      return false;
+   file << "frame";
+   for (int i = 0; i < replay_phase_count; ++i)
+      file << "," << get_replay_phase_column(static_cast<replay_phase>(i));
+   file << ",cpu_ns\n";
+   for (int frame_index = 0; frame_index < std::ssize(report.m_frames); ++frame_index)
+   {
+      const replay_frame& frame = report.m_frames[frame_index];
+      file << frame_index;
+      for (const int64_t ns : frame.m_phase_ns)
+         file << "," << ns;
+      file << "," << frame.m_cpu_ns << "\n";
+   }
+   return file.good();
+}
+
+
+auto sfn::run_headless_replay(
+   const universe& univ,
+   const camera_path& path,
+   const glm::ivec2& resolution
+) -> replay_report
+{
+   // What the engine shows at startup
+   constexpr position_mode mode = position_mode::reconstructed;
+   scene scene;
+   scene.m_stars = get_star_instances(univ, mode);
+   scene.m_bb_trafos = get_bb_trafos(univ);
+   scene.m_connection_trafos = get_connection_trafos(univ, get_graph_from_universe(univ, 20.0f), mode);
+
+   frame_settings settings{
+      .m_camera_mode = replay_mode{ .m_path = std::make_shared<const camera_path>(path) },
+      .m_position_mode = mode,
+      .m_resolution = resolution,
+      .m_selection = univ.find_index_by_name("SOL").value_or(0)
+   };
+   frame_description frame;
+   null_backend backend;
+   replay_report report;
+   report.m_headless = true;
+   report.m_frames.reserve(path.get_frame_count());
+   for (int frame_index = 0; frame_index < path.get_frame_count(); ++frame_index)
+   {
+      const auto t0 = std::chrono::high_resolution_clock::now();
+      replay_frame& timings = report.m_frames.emplace_back();
+      std::get<replay_mode>(settings.m_camera_mode).m_frame = frame_index;
+      settings.m_steady_time = frame_index / 60.0f;
+      build_frame(univ, scene, settings, &timings, frame);
+      submit_frame(backend, frame, &timings);
+      timings.m_cpu_ns = get_ns_since(t0);
+   }
+   return report;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "universe.h"
+
+#pragma warning(push, 0)
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#pragma warning(pop)
+
+
+namespace sfn
+{
+   struct camera_pose
+   {
+      glm::vec3 m_pos;
+      glm::vec3 m_target;
+   };
+
+   struct camera_keyframe
+   {
+      int m_frame = 0;
+      camera_pose m_pose;
+   };
+
+   // Poses between keyframes are interpolated linearly, like trailer_mode. Keyframes are sorted by frame
+   struct camera_path
+   {
+      std::vector<camera_keyframe> m_keyframes;
+
+      [[nodiscard]] auto get_frame_count() const -> int;
+      [[nodiscard]] auto get_pose(const int frame) const -> camera_pose;
+   };
+
+   // The reveal trailer movement, one trailer_mode loop of 500 frames
+   [[nodiscard]] auto get_trailer_path(const cam_info& info) -> camera_path;
+
+   // One keyframe per line: "frame;x;y;z;target x;target y;target z", # starts a comment
+   [[nodiscard]] auto read_camera_path(const std::string& filename) -> std::optional<camera_path>;
+   [[nodiscard]] auto write_camera_path(const camera_path& path, const std::string& filename) -> bool;
+
+   struct label_placement
+   {
+      int m_system_index;
+      glm::vec2 m_screen_pos;
+      float m_distance; // from the camera
+   };
+
+   // Systems in front of the camera and inside the viewport, with a margin so labels don't pop at the border
+   auto cull_systems(const universe& univ, const position_mode mode, const glm::mat4& view_projection, std::vector<int>& visible) -> void;
+
+   // Screen positions of the visible systems that have a name to show
+   auto project_labels(
+      const universe& univ,
+      const position_mode mode,
+      const glm::mat4& view_projection,
+      const glm::vec2& resolution,
+      const glm::vec3& cam_pos,
+      const std::span<const int> visible,
+      std::vector<label_placement>& placements
+   ) -> void;
+
+   enum class replay_phase { culling, label_projection, list, upload };
+   constexpr inline int replay_phase_count = 4;
+   [[nodiscard]] auto get_replay_phase_name(const replay_phase phase) -> const char*;
+
+   struct replay_frame
+   {
+      std::array<int64_t, replay_phase_count> m_phase_ns{};
+      int64_t m_cpu_ns = 0; // the whole CPU side of the frame, phases are part of it
+   };
+
+   struct replay_report
+   {
+      std::vector<replay_frame> m_frames;
+      bool m_headless = false; // no list phase, that needs ImGui
+   };
+
+   // Adds its lifetime to a phase of the frame. Does nothing without one, so call sites don't need to check
+   struct scoped_phase_timer
+   {
+      replay_frame* m_frame;
+      replay_phase m_phase;
+      std::chrono::high_resolution_clock::time_point m_t0;
+
+      explicit scoped_phase_timer(replay_frame* frame, const replay_phase phase);
+      ~scoped_phase_timer();
+
+      scoped_phase_timer(const scoped_phase_timer&) = delete;
+      scoped_phase_timer& operator=(const scoped_phase_timer&) = delete;
+   };
+
+   // Table of mean, p95 and max per phase
+   [[nodiscard]] auto get_replay_report_text(const replay_report& report) -> std::string;
+   [[nodiscard]] auto write_replay_csv(const replay_report& report, const std::string& filename) -> bool;
+
+   // Flies the path through build_frame() and a null_backend, which is the engine's CPU frame path without GL or ImGui
+   [[nodiscard]] auto run_headless_replay(const universe& univ, const camera_path& path, const glm::ivec2& resolution) -> replay_report;
+}
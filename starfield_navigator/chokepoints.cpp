@@ -0,0 +1,280 @@
+#include "chokepoints.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "thread_pool.h"
+
+
+namespace
+{
+   using namespace sfn;
+
+   // Compressed adjacency. m_slots maps each half edge to its connection in graph::m_sorted_connections
+   struct adjacency
+   {
+      std::vector<int> m_offsets;
+      std::vector<int> m_neighbors;
+      std::vector<float> m_weights;
+      std::vector<int> m_slots;
+   };
+
+
+   [[nodiscard]] auto get_adjacency(
+      const graph& jump_graph,
+      const universe& universe,
+      const position_mode mode
+   ) -> adjacency
+   {
+      const int node_count = static_cast<int>(std::ssize(jump_graph.m_nodes));
+      const auto get_pair_key = [](const int a, const int b) {
+         return (static_cast<uint64_t>(std::min(a, b)) << 32) | static_cast<uint32_t>(std::max(a, b));
+      };
+      std::unordered_map<uint64_t, int> slot_by_pair;
+      slot_by_pair.reserve(jump_graph.m_sorted_connections.size());
+      for (int slot = 0; slot < std::ssize(jump_graph.m_sorted_connections); ++slot)
+      {
+         const connection& con = jump_graph.m_connections.at(jump_graph.m_sorted_connections[slot]);
+         slot_by_pair.emplace(get_pair_key(con.m_node_index0, con.m_node_index1), slot);
+      }
+
+      adjacency result;
+      result.m_offsets.reserve(node_count + 1);
+      result.m_offsets.push_back(0);
+      for (int i = 0; i < node_count; ++i)
+      {
+         for (const int neighbor : jump_graph.m_nodes[i].m_neighbor_nodes)
+         {
+            result.m_neighbors.push_back(neighbor);
+            result.m_weights.push_back(universe.get_distance(i, neighbor, mode));
+            result.m_slots.push_back(slot_by_pair.at(get_pair_key(i, neighbor)));
+         }
+         result.m_offsets.push_back(static_cast<int>(std::ssize(result.m_neighbors)));
+      }
+      return result;
+   }
+
+
+   // Everything one thread needs for its share of the sources, reused from source to source
+   struct brandes_lane
+   {
+      std::vector<double> m_system_sums;
+      std::vector<double> m_connection_sums;
+
+      std::vector<float> m_distances;
+      std::vector<double> m_path_counts;
+      std::vector<double> m_dependencies;
+      std::vector<int> m_settle_order;
+      std::vector<int> m_predecessor_counts;
+      std::vector<int> m_predecessors;      // at the offsets of the node they lead to
+      std::vector<int> m_predecessor_edges; // half edges from the predecessors, same layout
+      std::vector<std::pair<float, int>> m_heap;
+
+      explicit brandes_lane(const int node_count, const int connection_count, const int half_edge_count)
+         : m_system_sums(node_count, 0.0)
+         , m_connection_sums(connection_count, 0.0)
+         , m_distances(node_count)
+         , m_path_counts(node_count)
+         , m_dependencies(node_count)
+         , m_predecessor_counts(node_count)
+         , m_predecessors(half_edge_count)
+         , m_predecessor_edges(half_edge_count)
+      {
+         m_settle_order.reserve(node_count);
+      }
+
+      auto add_source(const adjacency& adj, const int source) -> void;
+   };
+
+
+   auto brandes_lane::add_source(const adjacency& adj, const int source) -> void
+   {
+      std::ranges::fill(m_distances, shortest_path::no_distance);
+      std::ranges::fill(m_path_counts, 0.0);
+      std::ranges::fill(m_dependencies, 0.0);
+      std::ranges::fill(m_predecessor_counts, 0);
+      m_settle_order.clear();
+      m_heap.clear();
+
+      // Dijkstra, counting the shortest paths and remembering all predecessors on them
+      constexpr auto heap_order = std::greater<>{};
+      m_distances[source] = 0.0f;
+      m_path_counts[source] = 1.0;
+      m_heap.emplace_back(0.0f, source);
+      while (m_heap.empty() == false)
+      {
+         std::ranges::pop_heap(m_heap, heap_order);
+         const auto [distance, current] = m_heap.back();
+         m_heap.pop_back();
+         if (distance > m_distances[current])
+            continue;
+         m_settle_order.push_back(current);
+
+         for (int half_edge = adj.m_offsets[current]; half_edge < adj.m_offsets[current + 1]; ++half_edge)
+         {
+            const int neighbor = adj.m_neighbors[half_edge];
+            const float neighbor_distance = distance + adj.m_weights[half_edge];
+            if (neighbor_distance < m_distances[neighbor])
+            {
+               m_distances[neighbor] = neighbor_distance;
+               m_path_counts[neighbor] = 0.0;
+               m_predecessor_counts[neighbor] = 0;
+               m_heap.emplace_back(neighbor_distance, neighbor);
+               std::ranges::push_heap(m_heap, heap_order);
+            }
+            if (neighbor_distance == m_distances[neighbor])
+            {
+               const int predecessor_index = adj.m_offsets[neighbor] + m_predecessor_counts[neighbor]++;
+               m_path_counts[neighbor] += m_path_counts[current];
+               m_predecessors[predecessor_index] = current;
+               m_predecessor_edges[predecessor_index] = half_edge;
+            }
+         }
+      }
+
+      // Dependencies flow back from the farthest systems
+      for (auto it = std::rbegin(m_settle_order); it != std::rend(m_settle_order); ++it)
+      {
+         const int node = *it;
+         for (int k = 0; k < m_predecessor_counts[node]; ++k)
+         {
+            const int predecessor = m_predecessors[adj.m_offsets[node] + k];
+            const int half_edge = m_predecessor_edges[adj.m_offsets[node] + k];
+            const double share = m_path_counts[predecessor] / m_path_counts[node] * (1.0 + m_dependencies[node]);
+            m_dependencies[predecessor] += share;
+            m_connection_sums[adj.m_slots[half_edge]] += share;
+         }
+         if (node != source)
+            m_system_sums[node] += m_dependencies[node];
+      }
+   }
+
+
+   // Iterative Tarjan DFS, the graph can be too deep for recursion
+   auto add_articulation_points_and_bridges(
+      const adjacency& adj,
+      chokepoint_analysis& result
+   ) -> void
+   {
+      const int node_count = static_cast<int>(std::ssize(adj.m_offsets)) - 1;
+      std::vector<int> discovery(node_count, -1);
+      std::vector<int> low(node_count, 0);
+      std::vector<int> parent_edge(node_count, -1);
+      std::vector<int> next_edge(node_count, 0);
+      std::vector<bool> is_articulation(node_count, false);
+      std::vector<int> stack;
+      int time = 0;
+
+      for (int root = 0; root < node_count; ++root)
+      {
+         if (discovery[root] != -1)
+            continue;
+         int root_children = 0;
+         discovery[root] = low[root] = time++;
+         next_edge[root] = adj.m_offsets[root];
+         stack.push_back(root);
+         while (stack.empty() == false)
+         {
+            const int node = stack.back();
+            if (next_edge[node] < adj.m_offsets[node + 1])
+            {
+               const int half_edge = next_edge[node]++;
+               const int neighbor = adj.m_neighbors[half_edge];
+               if (adj.m_slots[half_edge] == parent_edge[node])
+                  continue;
+               if (discovery[neighbor] != -1)
+               {
+                  low[node] = std::min(low[node], discovery[neighbor]);
+                  continue;
+               }
+               discovery[neighbor] = low[neighbor] = time++;
+               parent_edge[neighbor] = adj.m_slots[half_edge];
+               next_edge[neighbor] = adj.m_offsets[neighbor];
+               stack.push_back(neighbor);
+               if (node == root)
+                  ++root_children;
+               continue;
+            }
+
+            stack.pop_back();
+            if (stack.empty())
+               break;
+            const int parent = stack.back();
+            low[parent] = std::min(low[parent], low[node]);
+            if (low[node] > discovery[parent])
+               result.m_bridges.push_back(parent_edge[node]);
+            if (parent != root && low[node] >= discovery[parent])
+               is_articulation[parent] = true;
+         }
+         if (root_children > 1)
+            is_articulation[root] = true;
+      }
+
+      for (int i = 0; i < node_count; ++i)
+      {
+         if (is_articulation[i])
+            result.m_articulation_points.push_back(i);
+      }
+      std::ranges::sort(result.m_bridges);
+   }
+
+} // namespace {}
+
+
+auto sfn::chokepoint_analysis::is_outdated(
+   const graph& jump_graph,
+   const position_mode mode
+) const -> bool
+{
+   return m_jump_range != jump_graph.m_jump_range || m_position_mode != mode || std::ssize(m_system_betweenness) != std::ssize(jump_graph.m_nodes);
+}
+
+
+auto sfn::get_chokepoint_analysis(
+   const graph& jump_graph,
+   const universe& universe,
+   const position_mode mode
+) -> chokepoint_analysis
+{
+   const adjacency adj = get_adjacency(jump_graph, universe, mode);
+   const int node_count = static_cast<int>(std::ssize(jump_graph.m_nodes));
+   const int connection_count = static_cast<int>(std::ssize(jump_graph.m_sorted_connections));
+
+   // One lane per thread, sources strided over the lanes so their cost evens out
+   const int lane_count = std::min(get_thread_pool().get_thread_count(), std::max(1, node_count));
+   std::vector<std::optional<brandes_lane>> lanes(lane_count);
+   parallel_for(0, lane_count, [&](const int lane_index) {
+      brandes_lane& lane = lanes[lane_index].emplace(node_count, connection_count, static_cast<int>(std::ssize(adj.m_neighbors)));
+      for (int source = lane_index; source < node_count; source += lane_count)
+         lane.add_source(adj, source);
+   }, 1);
+
+   // Every route was counted from both of its ends
+   chokepoint_analysis result{
+      .m_jump_range = jump_graph.m_jump_range,
+      .m_position_mode = mode,
+      .m_system_betweenness = std::vector<float>(node_count),
+      .m_connection_betweenness = std::vector<float>(connection_count)
+   };
+   for (int i = 0; i < node_count; ++i)
+   {
+      double sum = 0.0;
+      for (const std::optional<brandes_lane>& lane : lanes)
+         sum += lane->m_system_sums[i];
+      result.m_system_betweenness[i] = static_cast<float>(sum / 2.0);
+   }
+   for (int i = 0; i < connection_count; ++i)
+   {
+      double sum = 0.0;
+      for (const std::optional<brandes_lane>& lane : lanes)
+         sum += lane->m_connection_sums[i];
+      result.m_connection_betweenness[i] = static_cast<float>(sum / 2.0);
+   }
+   if (node_count > 0)
+      result.m_max_system_betweenness = std::ranges::max(result.m_system_betweenness);
+   if (connection_count > 0)
+      result.m_max_connection_betweenness = std::ranges::max(result.m_connection_betweenness);
+
+   add_articulation_points_and_bridges(adj, result);
+   return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "graph.h"
+#include "universe.h"
+
+
+namespace sfn
+{
+   struct chokepoint_analysis
+   {
+      float m_jump_range = 0.0f; // of the graph it was computed on
+      position_mode m_position_mode = position_mode::reconstructed;
+
+      // Number of shortest routes between other systems that go through a system or connection. Connections are
+      // indexed like graph::m_sorted_connections
+      std::vector<float> m_system_betweenness;
+      std::vector<float> m_connection_betweenness;
+      float m_max_system_betweenness = 0.0f;
+      float m_max_connection_betweenness = 0.0f;
+
+      // Systems and connections whose removal splits their part of the graph
+      std::vector<int> m_articulation_points;
+      std::vector<int> m_bridges; // indices into graph::m_sorted_connections
+
+      [[nodiscard]] auto is_outdated(const graph& jump_graph, const position_mode mode) const -> bool;
+   };
+
+   // Brandes' algorithm with one Dijkstra per source, the sources spread over the thread pool. Every thread adds into
+   // its own accumulators, they are summed at the end. Articulation points and bridges come from one DFS
+   [[nodiscard]] auto get_chokepoint_analysis(const graph& jump_graph, const universe& universe, const position_mode mode) -> chokepoint_analysis;
+}
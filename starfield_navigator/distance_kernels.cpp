@@ -0,0 +1,422 @@
+#include "distance_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SFN_TARGET(x)
+#else
+#define SFN_TARGET(x) __attribute__((target(x)))
+#endif
+
+
+namespace
+{
+   using namespace sfn;
+
+   struct kernel_table
+   {
+      using distances_fn = void(*)(const glm::vec3&, const point_span&, float*, bool);
+      using paired_fn = void(*)(const point_span&, const point_span&, float*);
+      using within_radius_fn = int(*)(const glm::vec3&, const point_span&, float, int*, float*);
+
+      distances_fn m_distances;
+      paired_fn m_paired;
+      within_radius_fn m_within_radius;
+   };
+
+
+   // scalar ------------------------------------------------------------------------------------------------------------
+   auto distances_scalar(const glm::vec3& from, const point_span& points, float* out, const bool root) -> void
+   {
+      for (int i = 0; i < points.m_count; ++i)
+      {
+         const float dx = points.m_x[i] - from[0];
+         const float dy = points.m_y[i] - from[1];
+         const float dz = points.m_z[i] - from[2];
+         const float d2 = dx * dx + dy * dy + dz * dz;
+         out[i] = root ? std::sqrt(d2) : d2;
+      }
+   }
+
+   auto paired_scalar(const point_span& a, const point_span& b, float* out) -> void
+   {
+      for (int i = 0; i < a.m_count; ++i)
+      {
+         const float dx = a.m_x[i] - b.m_x[i];
+         const float dy = a.m_y[i] - b.m_y[i];
+         const float dz = a.m_z[i] - b.m_z[i];
+         out[i] = std::sqrt(dx * dx + dy * dy + dz * dz);
+      }
+   }
+
+   auto within_radius_scalar(const glm::vec3& from, const point_span& points, const float radius2, int* out_indices, float* out_distances2) -> int
+   {
+      int count = 0;
+      for (int i = 0; i < points.m_count; ++i)
+      {
+         const float dx = points.m_x[i] - from[0];
+         const float dy = points.m_y[i] - from[1];
+         const float dz = points.m_z[i] - from[2];
+         const float d2 = dx * dx + dy * dy + dz * dz;
+         if (d2 > radius2)
+            continue;
+         out_indices[count] = points.m_first_index + i;
+         out_distances2[count] = d2;
+         ++count;
+      }
+      return count;
+   }
+
+
+   // SSE4 --------------------------------------------------------------------------------------------------------------
+   SFN_TARGET("sse4.1")
+   auto distances_sse4(const glm::vec3& from, const point_span& points, float* out, const bool root) -> void
+   {
+      const __m128 fx = _mm_set1_ps(from[0]);
+      const __m128 fy = _mm_set1_ps(from[1]);
+      const __m128 fz = _mm_set1_ps(from[2]);
+      int i = 0;
+      for (; i + 4 <= points.m_count; i += 4)
+      {
+         const __m128 dx = _mm_sub_ps(_mm_loadu_ps(points.m_x + i), fx);
+         const __m128 dy = _mm_sub_ps(_mm_loadu_ps(points.m_y + i), fy);
+         const __m128 dz = _mm_sub_ps(_mm_loadu_ps(points.m_z + i), fz);
+         __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+         if (root)
+            d2 = _mm_sqrt_ps(d2);
+         _mm_storeu_ps(out + i, d2);
+      }
+      distances_scalar(from, points.get_subspan(i, points.m_count - i), out + i, root);
+   }
+
+   SFN_TARGET("sse4.1")
+   auto paired_sse4(const point_span& a, const point_span& b, float* out) -> void
+   {
+      int i = 0;
+      for (; i + 4 <= a.m_count; i += 4)
+      {
+         const __m128 dx = _mm_sub_ps(_mm_loadu_ps(a.m_x + i), _mm_loadu_ps(b.m_x + i));
+         const __m128 dy = _mm_sub_ps(_mm_loadu_ps(a.m_y + i), _mm_loadu_ps(b.m_y + i));
+         const __m128 dz = _mm_sub_ps(_mm_loadu_ps(a.m_z + i), _mm_loadu_ps(b.m_z + i));
+         const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+         _mm_storeu_ps(out + i, _mm_sqrt_ps(d2));
+      }
+      paired_scalar(a.get_subspan(i, a.m_count - i), b.get_subspan(i, b.m_count - i), out + i);
+   }
+
+   SFN_TARGET("sse4.1")
+   auto within_radius_sse4(const glm::vec3& from, const point_span& points, const float radius2, int* out_indices, float* out_distances2) -> int
+   {
+      const __m128 fx = _mm_set1_ps(from[0]);
+      const __m128 fy = _mm_set1_ps(from[1]);
+      const __m128 fz = _mm_set1_ps(from[2]);
+      const __m128 r2 = _mm_set1_ps(radius2);
+      alignas(16) float d2_lanes[4];
+      int count = 0;
+      int i = 0;
+      for (; i + 4 <= points.m_count; i += 4)
+      {
+         const __m128 dx = _mm_sub_ps(_mm_loadu_ps(points.m_x + i), fx);
+         const __m128 dy = _mm_sub_ps(_mm_loadu_ps(points.m_y + i), fy);
+         const __m128 dz = _mm_sub_ps(_mm_loadu_ps(points.m_z + i), fz);
+         const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+         unsigned int mask = static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(d2, r2)));
+         if (mask == 0)
+            continue;
+         _mm_store_ps(d2_lanes, d2);
+         for (; mask != 0; mask &= mask - 1)
+         {
+            const int lane = std::countr_zero(mask);
+            out_indices[count] = points.m_first_index + i + lane;
+            out_distances2[count] = d2_lanes[lane];
+            ++count;
+         }
+      }
+      return count + within_radius_scalar(from, points.get_subspan(i, points.m_count - i), radius2, out_indices + count, out_distances2 + count);
+   }
+
+
+   // AVX2 --------------------------------------------------------------------------------------------------------------
+   SFN_TARGET("avx2")
+   auto distances_avx2(const glm::vec3& from, const point_span& points, float* out, const bool root) -> void
+   {
+      const __m256 fx = _mm256_set1_ps(from[0]);
+      const __m256 fy = _mm256_set1_ps(from[1]);
+      const __m256 fz = _mm256_set1_ps(from[2]);
+      int i = 0;
+      for (; i + 8 <= points.m_count; i += 8)
+      {
+         const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(points.m_x + i), fx);
+         const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(points.m_y + i), fy);
+         const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(points.m_z + i), fz);
+         __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+         if (root)
+            d2 = _mm256_sqrt_ps(d2);
+         _mm256_storeu_ps(out + i, d2);
+      }
+      distances_scalar(from, points.get_subspan(i, points.m_count - i), out + i, root);
+   }
+
+   SFN_TARGET("avx2")
+   auto paired_avx2(const point_span& a, const point_span& b, float* out) -> void
+   {
+      int i = 0;
+      for (; i + 8 <= a.m_count; i += 8)
+      {
+         const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(a.m_x + i), _mm256_loadu_ps(b.m_x + i));
+         const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(a.m_y + i), _mm256_loadu_ps(b.m_y + i));
+         const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(a.m_z + i), _mm256_loadu_ps(b.m_z + i));
+         const __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+         _mm256_storeu_ps(out + i, _mm256_sqrt_ps(d2));
+      }
+      paired_scalar(a.get_subspan(i, a.m_count - i), b.get_subspan(i, b.m_count - i), out + i);
+   }
+
+   SFN_TARGET("avx2")
+   auto within_radius_avx2(const glm::vec3& from, const point_span& points, const float radius2, int* out_indices, float* out_distances2) -> int
+   {
+      const __m256 fx = _mm256_set1_ps(from[0]);
+      const __m256 fy = _mm256_set1_ps(from[1]);
+      const __m256 fz = _mm256_set1_ps(from[2]);
+      const __m256 r2 = _mm256_set1_ps(radius2);
+      alignas(32) float d2_lanes[8];
+      int count = 0;
+      int i = 0;
+      for (; i + 8 <= points.m_count; i += 8)
+      {
+         const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(points.m_x + i), fx);
+         const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(points.m_y + i), fy);
+         const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(points.m_z + i), fz);
+         const __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+         unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_cmp_ps(d2, r2, _CMP_LE_OQ)));
+         if (mask == 0)
+            continue;
+         _mm256_store_ps(d2_lanes, d2);
+         for (; mask != 0; mask &= mask - 1)
+         {
+            const int lane = std::countr_zero(mask);
+            out_indices[count] = points.m_first_index + i + lane;
+            out_distances2[count] = d2_lanes[lane];
+            ++count;
+         }
+      }
+      return count + within_radius_scalar(from, points.get_subspan(i, points.m_count - i), radius2, out_indices + count, out_distances2 + count);
+   }
+
+
+   // AVX-512 -----------------------------------------------------------------------------------------------------------
+   // Masked loads handle the tail, so these have no scalar remainder
+   SFN_TARGET("avx512f")
+   auto distances_avx512(const glm::vec3& from, const point_span& points, float* out, const bool root) -> void
+   {
+      const __m512 fx = _mm512_set1_ps(from[0]);
+      const __m512 fy = _mm512_set1_ps(from[1]);
+      const __m512 fz = _mm512_set1_ps(from[2]);
+      for (int i = 0; i < points.m_count; i += 16)
+      {
+         const __mmask16 lanes = static_cast<__mmask16>(points.m_count - i >= 16 ? 0xffff : (1u << (points.m_count - i)) - 1);
+         const __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, points.m_x + i), fx);
+         const __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, points.m_y + i), fy);
+         const __m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, points.m_z + i), fz);
+         __m512 d2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+         if (root)
+            d2 = _mm512_sqrt_ps(d2);
+         _mm512_mask_storeu_ps(out + i, lanes, d2);
+      }
+   }
+
+   SFN_TARGET("avx512f")
+   auto paired_avx512(const point_span& a, const point_span& b, float* out) -> void
+   {
+      for (int i = 0; i < a.m_count; i += 16)
+      {
+         const __mmask16 lanes = static_cast<__mmask16>(a.m_count - i >= 16 ? 0xffff : (1u << (a.m_count - i)) - 1);
+         const __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, a.m_x + i), _mm512_maskz_loadu_ps(lanes, b.m_x + i));
+         const __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, a.m_y + i), _mm512_maskz_loadu_ps(lanes, b.m_y + i));
+         const __m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, a.m_z + i), _mm512_maskz_loadu_ps(lanes, b.m_z + i));
+         const __m512 d2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+         _mm512_mask_storeu_ps(out + i, lanes, _mm512_sqrt_ps(d2));
+      }
+   }
+
+   SFN_TARGET("avx512f")
+   auto within_radius_avx512(const glm::vec3& from, const point_span& points, const float radius2, int* out_indices, float* out_distances2) -> int
+   {
+      const __m512 fx = _mm512_set1_ps(from[0]);
+      const __m512 fy = _mm512_set1_ps(from[1]);
+      const __m512 fz = _mm512_set1_ps(from[2]);
+      const __m512 r2 = _mm512_set1_ps(radius2);
+      const __m512i lane_offsets = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+      int count = 0;
+      for (int i = 0; i < points.m_count; i += 16)
+      {
+         const __mmask16 lanes = static_cast<__mmask16>(points.m_count - i >= 16 ? 0xffff : (1u << (points.m_count - i)) - 1);
+         const __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, points.m_x + i), fx);
+         const __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, points.m_y + i), fy);
+         const __m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, points.m_z + i), fz);
+         const __m512 d2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+         const __mmask16 hits = _mm512_mask_cmp_ps_mask(lanes, d2, r2, _CMP_LE_OQ);
+         if (hits == 0)
+            continue;
+         const __m512i indices = _mm512_add_epi32(_mm512_set1_epi32(points.m_first_index + i), lane_offsets);
+         _mm512_mask_compressstoreu_epi32(out_indices + count, hits, indices);
+         _mm512_mask_compressstoreu_ps(out_distances2 + count, hits, d2);
+         count += std::popcount(static_cast<unsigned int>(hits));
+      }
+      return count;
+   }
+
+
+   [[nodiscard]] auto detect_simd_level() -> simd_level
+   {
+#if defined(_MSC_VER)
+      int info[4];
+      __cpuid(info, 0);
+      const int max_leaf = info[0];
+      __cpuid(info, 1);
+      const bool sse41 = (info[2] & (1 << 19)) != 0;
+      const bool osxsave = (info[2] & (1 << 27)) != 0;
+      bool avx2 = false;
+      bool avx512f = false;
+      if (max_leaf >= 7)
+      {
+         __cpuidex(info, 7, 0);
+         avx2 = (info[1] & (1 << 5)) != 0;
+         avx512f = (info[1] & (1 << 16)) != 0;
+      }
+      // The OS also has to save the wide registers
+      const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+      if (avx512f && (xcr0 & 0xe6) == 0xe6)
+         return simd_level::avx512;
+      if (avx2 && (xcr0 & 0x6) == 0x6)
+         return simd_level::avx2;
+      if (sse41)
+         return simd_level::sse4;
+      return simd_level::scalar;
+#else
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx512f"))
+         return simd_level::avx512;
+      if (__builtin_cpu_supports("avx2"))
+         return simd_level::avx2;
+      if (__builtin_cpu_supports("sse4.1"))
+         return simd_level::sse4;
+      return simd_level::scalar;
+#endif
+   }
+
+
+   [[nodiscard]] auto get_kernel_table(const simd_level level) -> kernel_table
+   {
+      switch (level)
+      {
+      case simd_level::avx512: return kernel_table{ distances_avx512, paired_avx512, within_radius_avx512 };
+      case simd_level::avx2:   return kernel_table{ distances_avx2, paired_avx2, within_radius_avx2 };
+      case simd_level::sse4:   return kernel_table{ distances_sse4, paired_sse4, within_radius_sse4 };
+      default:                 return kernel_table{ distances_scalar, paired_scalar, within_radius_scalar };
+      }
+   }
+
+   std::atomic<simd_level> active_level = get_supported_simd_level();
+
+   [[nodiscard]] auto get_kernels() -> kernel_table
+   {
+      return get_kernel_table(active_level.load(std::memory_order_relaxed));
+   }
+
+} // namespace {}
+
+
+auto sfn::get_supported_simd_level() -> simd_level
+{
+   static const simd_level level = detect_simd_level();
+   return level;
+}
+
+
+auto sfn::get_simd_level() -> simd_level
+{
+   return active_level.load(std::memory_order_relaxed);
+}
+
+
+auto sfn::get_simd_level_name(const simd_level level) -> const char*
+{
+   switch (level)
+   {
+   case simd_level::avx512: return "AVX-512";
+   case simd_level::avx2:   return "AVX2";
+   case simd_level::sse4:   return "SSE4";
+   default:                 return "scalar";
+   }
+}
+
+
+auto sfn::set_simd_level(const simd_level level) -> void
+{
+   active_level = std::min(level, get_supported_simd_level());
+}
+
+
+auto sfn::point_span::get_subspan(const int offset, const int count) const -> point_span
+{
+   return point_span{
+      .m_x = m_x + offset,
+      .m_y = m_y + offset,
+      .m_z = m_z + offset,
+      .m_count = count,
+      .m_first_index = m_first_index + offset
+   };
+}
+
+
+auto sfn::get_distances2(const glm::vec3& from, const point_span& points, float* out) -> void
+{
+   get_kernels().m_distances(from, points, out, false);
+}
+
+
+auto sfn::get_distances(const glm::vec3& from, const point_span& points, float* out) -> void
+{
+   get_kernels().m_distances(from, points, out, true);
+}
+
+
+auto sfn::get_paired_distances(const point_span& a, const point_span& b, float* out) -> void
+{
+   get_kernels().m_paired(a, b, out);
+}
+
+
+auto sfn::get_within_radius(
+   const glm::vec3& from,
+   const point_span& points,
+   const float radius,
+   int* out_indices,
+   float* out_distances2
+) -> int
+{
+   return get_kernels().m_within_radius(from, points, radius * radius, out_indices, out_distances2);
+}
+
+
+auto sfn::get_distance2_block(const point_span& a, const point_span& b, float* out) -> void
+{
+   const kernel_table kernels = get_kernels();
+   constexpr int tile_size = 1024; // 12 KB of b per tile
+   for (int tile_begin = 0; tile_begin < b.m_count; tile_begin += tile_size)
+   {
+      const point_span tile = b.get_subspan(tile_begin, std::min(tile_size, b.m_count - tile_begin));
+      for (int i = 0; i < a.m_count; ++i)
+      {
+         const glm::vec3 from{ a.m_x[i], a.m_y[i], a.m_z[i] };
+         kernels.m_distances(from, tile, out + static_cast<size_t>(i) * b.m_count + tile_begin, false);
+      }
+   }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#pragma warning(push, 0)
+#include <glm/vec3.hpp>
+#pragma warning(pop)
+
+
+namespace sfn
+{
+   enum class simd_level { scalar, sse4, avx2, avx512 };
+
+   // Highest level the CPU supports, detected once
+   [[nodiscard]] auto get_supported_simd_level() -> simd_level;
+   [[nodiscard]] auto get_simd_level() -> simd_level;
+   [[nodiscard]] auto get_simd_level_name(const simd_level level) -> const char*;
+
+   // For comparisons. Gets clamped to what the CPU supports
+   auto set_simd_level(const simd_level level) -> void;
+
+   // Non-owning view of structure-of-arrays positions. m_first_index is the index of the first point in its owner,
+   // so indices reported by the kernels refer to the full arrays
+   struct point_span
+   {
+      const float* m_x = nullptr;
+      const float* m_y = nullptr;
+      const float* m_z = nullptr;
+      int m_count = 0;
+      int m_first_index = 0;
+
+      [[nodiscard]] auto get_subspan(const int offset, const int count) const -> point_span;
+   };
+
+   // One to many: out[i] = |from - points[i]|^2 or |from - points[i]|
+   auto get_distances2(const glm::vec3& from, const point_span& points, float* out) -> void;
+   auto get_distances(const glm::vec3& from, const point_span& points, float* out) -> void;
+
+   // Element-wise: out[i] = |a[i] - b[i]|. Both spans need the same count
+   auto get_paired_distances(const point_span& a, const point_span& b, float* out) -> void;
+
+   // Points with |from - point|^2 <= radius^2, compacted into the outputs. Both outputs need room for points.m_count
+   // elements. Returns the number of points written
+   [[nodiscard]] auto get_within_radius(const glm::vec3& from, const point_span& points, const float radius, int* out_indices, float* out_distances2) -> int;
+
+   // Many to many: out[i * b.m_count + j] = |a[i] - b[j]|^2. Computed in tiles so b stays in cache
+   auto get_distance2_block(const point_span& a, const point_span& b, float* out) -> void;
+}
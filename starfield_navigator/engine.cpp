@@ -1,12 +1,17 @@
 #include "engine.h"
-#include "obj_parsing.h"
+#include "itinerary.h"
+#include "k_shortest_paths.h"
+#include "pareto_routes.h"
+#include "profiler.h"
+#include "route_cache.h"
+
+#include <numeric>
 
 
 #pragma warning(push, 0)
 #include <GLFW/glfw3.h> // after glad
 #include <imgui.h>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/vector_angle.hpp>
 #include "fonts/FontAwesomeSolid.hpp"
 #include "fonts/DroidSans.hpp"
 #include "fonts/IconsFontAwesome5.h"
@@ -27,143 +32,6 @@ namespace
       ImGui::Text(text.c_str());
    }
 
-   template<is_alternative<projection_params> T>
-   [[nodiscard]] auto get_projection_matrix(const config& config, const T& param) -> glm::mat4
-   {
-      const float aspect = static_cast<float>(config.res_x) / config.res_y;
-      if constexpr (std::same_as<T, perspective_params>)
-      {
-         constexpr float x_fov = glm::radians(60.0f);
-         const float y_fov = x_fov / aspect;
-         return glm::perspective(y_fov, aspect, 0.1f, 3000.0f);
-      }
-      else if constexpr (std::same_as<T, ortho_params>)
-      {
-         const float frustum_width = param.width;
-         return glm::ortho(
-            -0.5f * frustum_width,
-            0.5f * frustum_width,
-            -0.5f * frustum_width/ aspect,
-            0.5f * frustum_width/ aspect,
-            0.0f,
-            500.0f
-         );
-      }
-   }
-
-
-   [[nodiscard]] auto get_indicator_mesh(
-      const glm::vec3& center,
-      const cs& cs
-   ) -> std::vector<position_vertex_data>
-   {
-      std::vector<position_vertex_data> result;
-      result.reserve(128);
-
-      constexpr float cross_extension = 1.0;
-      result.push_back(position_vertex_data{ .m_position = center - cross_extension* cs.m_front });
-      result.push_back(position_vertex_data{ .m_position = center + cross_extension* cs.m_front });
-      result.push_back(position_vertex_data{ .m_position = center - cross_extension* cs.m_right });
-      result.push_back(position_vertex_data{ .m_position = center + cross_extension* cs.m_right });
-      result.push_back(position_vertex_data{ .m_position = center - cross_extension* cs.m_up });
-      result.push_back(position_vertex_data{ .m_position = center + cross_extension* cs.m_up });
-
-      constexpr int circle_segments = 32;
-      const auto i_to_pos = [&](int i){
-         i = i % circle_segments;
-         const float angle = 1.0f * i / circle_segments * 2.0f * std::numbers::pi_v<float>;
-         const float x_rel = cross_extension * std::cos(angle);
-         const float y_rel = cross_extension * std::sin(angle);
-         return center + cs.m_right * x_rel + cs.m_front * y_rel;
-      };
-      for(int i=0; i<circle_segments; ++i)
-      {
-         result.push_back(position_vertex_data{ .m_position = i_to_pos(i)});
-         result.push_back(position_vertex_data{ .m_position = i_to_pos(i+1)});
-      }
-
-      return result;
-   }
-
-   const std::vector<position_vertex_data> sphere_mesh = get_position_vertex_data(get_complete_obj_info("assets/Sphere.obj", -1.0f));
-   const std::vector<position_vertex_data> cylinder_mesh = get_position_vertex_data(get_complete_obj_info("assets/Cylinder.obj", -1.0f));
-
-   [[nodiscard]] auto get_bb_mesh(
-      const bb_3D& old_coord_bb,
-      const glm::mat4& trafo
-   ) -> std::vector<glm::vec3>
-   {
-      const auto forward = [&](const glm::vec3& in) {
-         return apply_trafo(trafo, in);
-      };
-
-      const glm::vec3 bottom_p0 = old_coord_bb.m_min + glm::vec3{ 0, 0, 0 } *old_coord_bb.get_size();
-      const glm::vec3 bottom_p1 = old_coord_bb.m_min + glm::vec3{ 1, 0, 0 } *old_coord_bb.get_size();
-      const glm::vec3 bottom_p2 = old_coord_bb.m_min + glm::vec3{ 1, 1, 0 } *old_coord_bb.get_size();
-      const glm::vec3 bottom_p3 = old_coord_bb.m_min + glm::vec3{ 0, 1, 0 } *old_coord_bb.get_size();
-      const glm::vec3 top_p0 = old_coord_bb.m_min + glm::vec3{ 0, 0, 1 } *old_coord_bb.get_size();
-      const glm::vec3 top_p1 = old_coord_bb.m_min + glm::vec3{ 1, 0, 1 } *old_coord_bb.get_size();
-      const glm::vec3 top_p2 = old_coord_bb.m_min + glm::vec3{ 1, 1, 1 } *old_coord_bb.get_size();
-      const glm::vec3 top_p3 = old_coord_bb.m_min + glm::vec3{ 0, 1, 1 } *old_coord_bb.get_size();
-
-
-      std::vector<glm::vec3> result;
-      result.reserve(24);
-
-      // bottom
-      result.push_back(forward(bottom_p0));
-      result.push_back(forward(bottom_p1));
-      result.push_back(forward(bottom_p1));
-      result.push_back(forward(bottom_p2));
-      result.push_back(forward(bottom_p2));
-      result.push_back(forward(bottom_p3));
-      result.push_back(forward(bottom_p3));
-      result.push_back(forward(bottom_p0));
-
-      // top
-      result.push_back(forward(top_p0));
-      result.push_back(forward(top_p1));
-      result.push_back(forward(top_p1));
-      result.push_back(forward(top_p2));
-      result.push_back(forward(top_p2));
-      result.push_back(forward(top_p3));
-      result.push_back(forward(top_p3));
-      result.push_back(forward(top_p0));
-
-      // connections
-      result.push_back(forward(bottom_p0));
-      result.push_back(forward(top_p0));
-      result.push_back(forward(bottom_p1));
-      result.push_back(forward(top_p1));
-      result.push_back(forward(bottom_p2));
-      result.push_back(forward(top_p2));
-      result.push_back(forward(bottom_p3));
-      result.push_back(forward(top_p3));
-
-      return result;
-   }
-
-   std::vector<line_vertex_data> jump_line_mesh;
-   std::vector<position_vertex_data> indicator_mesh;
-
-
-   // written so it yields (0, -1, 0) for 0, 0, 1 parameters, which is how the geometry is set up
-   [[nodiscard]] auto get_cartesian_from_spherical(
-      const float phi_offset,
-      const float theta,
-      const float r,
-      const cs& cs
-   ) -> glm::vec3
-   {
-      const float phi = -std::numbers::pi_v<float> / 2 + phi_offset;
-      const float equation_theta = -theta + std::numbers::pi_v<float> / 2.0f;
-      const float x = r * std::cos(phi) * std::sin(equation_theta);
-      const float y = r * std::sin(phi) * std::sin(equation_theta);
-      const float z = r * std::cos(equation_theta);
-      return glm::vec3{} + x * cs.m_right + y * cs.m_front + z * cs.m_up;
-   }
-
-
    auto tooltip(const char* text) -> void
    {
       if (ImGui::IsItemHovered())
@@ -177,46 +45,81 @@ namespace
    }
 
 
-   [[nodiscard]] auto get_obj_trafo_between_points(
-      const glm::vec3& p0,
-      const glm::vec3& p1,
-      const float diameter
-   ) -> glm::mat4
-   {
-      glm::mat4 trafo(1.0f);
-
-      constexpr glm::vec3 galactic_cylinder{ 1, 0, 0 };
-      const glm::vec3 target_direction = glm::normalize(p1 - p0);
-      const float length = glm::distance(p1, p0);
-
-      trafo = glm::translate(trafo, p0);
-
-      const auto axis = glm::cross(galactic_cylinder, target_direction);
-      const float angle = glm::orientedAngle(galactic_cylinder, target_direction, axis);
-      trafo = glm::rotate(trafo, angle, axis);
-      const float radius = 0.5f * diameter;
-      trafo = glm::scale(trafo, glm::vec3{ length, radius, radius });
-      return trafo;
-   }
+   // ImGui's callbacks, ours forward to them
+   GLFWkeyfun imgui_key_callback = nullptr;
+   GLFWcharfun imgui_char_callback = nullptr;
+   GLFWcursorposfun imgui_cursor_pos_callback = nullptr;
 
 
-   struct mouse_movement_visitor
+   // Runs on the graph job's thread. Cancellation is checked between the stages
+   [[nodiscard]] auto compute_routes(
+      const universe& univ,
+      const route_request& request,
+      std::optional<graph>&& reused_graph,
+      const std::stop_token& stop
+   ) -> std::optional<route_result>
    {
-      glm::vec2 m_mouse_movement;
-
-      template<typename T>
-      auto operator()([[maybe_unused]] T& alternative) -> void
+      route_result result{ .m_request = request };
+      if (request.m_with_min_jump_range)
+         result.m_min_jump_range = get_route_cache().get_min_jump_dist(univ, request.m_source_index, request.m_destination_index, request.m_position_mode) + 0.001f;
+      if (stop.stop_requested())
+         return std::nullopt;
+
+      const float jump_range = request.m_jump_range.has_value() ? *request.m_jump_range : result.m_min_jump_range.value();
+      result.m_graph = (reused_graph.has_value() && reused_graph->m_jump_range == jump_range) ? std::move(*reused_graph) : get_graph_from_universe(univ, jump_range);
+      if (stop.stop_requested())
+         return std::nullopt;
+      if (request.m_route_mode.has_value() == false)
+         return result;
+
+      const int source = request.m_source_index;
+      const int destination = request.m_destination_index;
+      if (request.m_route_mode == route_mode::shortest)
       {
-         
+         result.m_path = get_route_cache().get_route(univ, result.m_graph, source, destination, request.m_position_mode);
+         return result;
       }
-
-      template<centery T>
-      auto operator()(T& alternative) -> void
+      if (request.m_route_mode == route_mode::alternatives)
       {
-         alternative.horiz_angle_offset += -0.005f * m_mouse_movement[0];
-         alternative.vert_angle_offset += 0.005f * m_mouse_movement[1];
+         for (ranked_route& route : get_k_shortest_paths(result.m_graph, univ, source, destination, request.m_alternative_count, request.m_position_mode))
+         {
+            std::string label = fmt::format("{} jumps, {:.1f} LY", std::ssize(route.m_path.m_stops) - 1, route.m_total_distance);
+            result.m_route_choices.emplace_back(std::move(label), std::move(route.m_path));
+         }
       }
-   };
+      else
+      {
+         for (pareto_route& route : get_pareto_routes(result.m_graph, univ, source, destination, request.m_position_mode))
+         {
+            std::string label = fmt::format("{} jumps, {:.1f} LY, longest jump {:.1f} LY", route.m_jump_count, route.m_total_distance, route.m_max_hop);
+            result.m_route_choices.emplace_back(std::move(label), std::move(route.m_path));
+         }
+      }
+      if (stop.stop_requested())
+         return std::nullopt;
+      if (result.m_route_choices.empty() == false)
+         result.m_path = result.m_route_choices.front().second;
+      return result;
+   }
+
+
+   // Runs on the analysis job's thread, on its own copy of the graph
+   [[nodiscard]] auto compute_analysis(
+      const universe& univ,
+      const analysis_request& request,
+      const graph& jump_graph,
+      const std::stop_token& stop
+   ) -> std::optional<analysis_result>
+   {
+      analysis_result result;
+      if (request.m_with_territory)
+         result.m_territory = get_faction_territory(jump_graph, univ, request.m_position_mode);
+      if (stop.stop_requested())
+         return std::nullopt;
+      if (request.m_with_chokepoints)
+         result.m_chokepoints = get_chokepoint_analysis(jump_graph, univ, request.m_position_mode);
+      return result;
+   }
 
 } // namespace {}
 
@@ -241,16 +144,10 @@ sfn::engine::engine(const config& config, std::unique_ptr<graphics_context>&& gc
    : m_config(config)
    , m_graphics_context(std::move(gc))
    , m_universe(std::move(universe))
-   , m_buffers2(128)
-   , m_shader_stars("star_shader")
-   , m_shader_lines("line_shader")
-   , m_shader_indicator("indicator_shader")
-   , m_shader_bb("bb_shader")
-   , m_shader_connection("connection_shader")
-   , m_framebuffers(m_textures)
 {
-   update_ssbo_bb();
-   update_ssbo_colors_and_positions(0.0f);
+   edit_scene().m_bb_trafos = get_bb_trafos(m_universe);
+   update_star_instances(0.0f);
+   update_selector_rows();
 
    if (engine_ptr != nullptr)
       std::terminate();
@@ -258,40 +155,9 @@ sfn::engine::engine(const config& config, std::unique_ptr<graphics_context>&& gc
    glfwSetFramebufferSizeCallback(get_window(), engine::static_resize_callback);
    glfwSetScrollCallback(get_window(), engine::static_scroll_callback);
    glfwSetMouseButtonCallback(get_window(), engine::static_mouse_button_callback);
-
-   std::vector<segment_type> buffer_layout;
-   buffer_layout.emplace_back(ubo_segment(sizeof(mvp_type), "ubo_mvp"));
-
-   buffer_layout.emplace_back(get_soa_vbo_segment(sphere_mesh));
-   buffer_layout.emplace_back(get_soa_vbo_segment<line_vertex_data>(100*100));
-   buffer_layout.emplace_back(get_soa_vbo_segment<position_vertex_data>(128));
-   buffer_layout.emplace_back(ssbo_segment(m_star_props_ssbo.get_byte_count(), "star_ssbo"));
-   buffer_layout.emplace_back(get_soa_vbo_segment(cylinder_mesh));
-   const std::vector<id> segment_ids = m_buffers2.create_buffer(std::move(buffer_layout), usage_pattern::dynamic_draw);
-   m_mvp_ubo_id = segment_ids[0];
-   m_star_vbo_id = segment_ids[1];
-   m_jump_lines_vbo_id = segment_ids[2];
-   m_indicator_vbo_id = segment_ids[3];
-   m_star_ssbo_id = segment_ids[4];
-   m_cylinder_vbo_id = segment_ids[5];
-
-   m_binding_point_man.add(m_mvp_ubo_id);
-   m_binding_point_man.add(m_star_ssbo_id);
-   m_main_fb = m_framebuffers.get_efault_fb();
-
-   const buffer& buffer_ref = m_buffers2.get_single_buffer_ref();
-   bind_ubo("ubo_mvp", buffer_ref, m_mvp_ubo_id, m_shader_stars);
-   bind_ubo("ubo_mvp", buffer_ref, m_mvp_ubo_id, m_shader_lines);
-   bind_ubo("ubo_mvp", buffer_ref, m_mvp_ubo_id, m_shader_connection);
-   bind_ssbo("star_ssbo", buffer_ref, m_star_ssbo_id, m_shader_stars);
-   bind_ssbo("star_ssbo", buffer_ref, m_star_ssbo_id, m_shader_connection);
-   bind_ssbo("star_ssbo", buffer_ref, m_star_ssbo_id, m_shader_bb);
-
-   m_vao_stars.emplace(m_buffers2, m_star_vbo_id, m_shader_stars);
-   m_vao_jump_lines.emplace(m_buffers2, m_jump_lines_vbo_id, m_shader_lines);
-   m_vao_connection_lines.emplace(m_buffers2, m_cylinder_vbo_id, m_shader_connection);
-   m_vao_indicator.emplace(m_buffers2, m_indicator_vbo_id, m_shader_indicator);
-   m_vao_bb.emplace(m_buffers2, m_cylinder_vbo_id, m_shader_bb);
+   imgui_key_callback = glfwSetKeyCallback(get_window(), engine::static_key_callback);
+   imgui_char_callback = glfwSetCharCallback(get_window(), engine::static_char_callback);
+   imgui_cursor_pos_callback = glfwSetCursorPosCallback(get_window(), engine::static_cursor_pos_callback);
 }
 
 
@@ -318,6 +184,30 @@ auto engine::static_mouse_button_callback(GLFWwindow* window, int button, int ac
 }
 
 
+auto engine::static_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) -> void
+{
+   engine_ptr->invalidate(redraw_input);
+   if (imgui_key_callback != nullptr)
+      imgui_key_callback(window, key, scancode, action, mods);
+}
+
+
+auto engine::static_char_callback(GLFWwindow* window, unsigned int codepoint) -> void
+{
+   engine_ptr->invalidate(redraw_input);
+   if (imgui_char_callback != nullptr)
+      imgui_char_callback(window, codepoint);
+}
+
+
+auto engine::static_cursor_pos_callback(GLFWwindow* window, double x, double y) -> void
+{
+   engine_ptr->invalidate(redraw_input);
+   if (imgui_cursor_pos_callback != nullptr)
+      imgui_cursor_pos_callback(window, x, y);
+}
+
+
 auto sfn::engine::resize_callback(
    [[maybe_unused]] GLFWwindow* window,
    int new_width,
@@ -328,7 +218,7 @@ auto sfn::engine::resize_callback(
       return;
    m_config.res_x = new_width;
    m_config.res_y = new_height;
-   glViewport(0, 0, new_width, new_height);
+   m_gl_backend.set_viewport(new_width, new_height);
    draw_frame();
 }
 
@@ -340,6 +230,7 @@ auto sfn::engine::scroll_callback(
 ) -> void
 {
    imgui_context::scroll_callback(window, xoffset, yoffset);
+   invalidate(redraw_input);
    const auto zoom = [&]<typename T>(T& mode){
       if constexpr (centery<T>)
       {
@@ -354,7 +245,8 @@ auto sfn::engine::scroll_callback(
 auto engine::mouse_button_callback(GLFWwindow* window, int button, int action, int mods) -> void
 {
    imgui_context::mouse_button_callback(window, button, action, mods);
-   
+   invalidate(redraw_input);
+
    constexpr auto is_cursor_in_window = [](GLFWwindow* window){
       int window_width, window_height;
       glfwGetWindowSize(window, &window_width, &window_height);
@@ -377,157 +269,112 @@ auto engine::mouse_button_callback(GLFWwindow* window, int button, int action, i
 
 auto sfn::engine::draw_frame() -> void
 {
+   SFN_PROFILE_ZONE("draw_frame");
    const timing_info timing_info = m_frame_pacer.get_timing_info();
-
-   m_framebuffers.bind_fb(m_main_fb, fb_target::full);
-   m_framebuffers.clear_depth(m_main_fb);
-   constexpr glm::vec3 bg_color{};
-   m_framebuffers.clear_color(m_main_fb, bg_color, 0);
-
-   m_graphics_context->m_imgui_context.frame_begin();
-   if (m_mouse_mover.has_value())
+   const auto cpu_t0 = std::chrono::high_resolution_clock::now();
+   if (m_replay.has_value())
    {
-      std::visit(mouse_movement_visitor{ m_mouse_mover->get_mouse_movement(this->get_window()) }, m_camera_mode);
+      m_replay_frame = &m_replay->m_report.m_frames.emplace_back();
+      m_list_selection = m_replay->m_selection;
+      m_show_star_labels = true;
    }
-   const auto center_tiler = [&]<typename T>(T & mode) {
-      if constexpr (centery<T>)
-      {
-         if (is_button_pressed(this->get_window(), GLFW_KEY_W))
-            mode.vert_angle_offset += 0.01f;
-         if (is_button_pressed(this->get_window(), GLFW_KEY_S))
-            mode.vert_angle_offset -= 0.01f;
-         if (is_button_pressed(this->get_window(), GLFW_KEY_A))
-            mode.horiz_angle_offset -= 0.01f;
-         if (is_button_pressed(this->get_window(), GLFW_KEY_D))
-            mode.horiz_angle_offset += 0.01f;
-      }
-   };
-   std::visit(center_tiler, m_camera_mode);
-
-   const auto pitch_limiter = [&]<typename T>(T & mode) {
-      if constexpr (centery<T>)
-      {
-         constexpr float half_pi = glm::radians(85.0f);
-         mode.vert_angle_offset = std::clamp(mode.vert_angle_offset, -half_pi, half_pi);
-      }
-   };
-   std::visit(pitch_limiter, m_camera_mode);
 
-   if (std::holds_alternative<wasd_mode>(m_camera_mode))
+   m_graphics_context->m_imgui_context.frame_begin();
+   update_graph_job();
+   update_analysis_job();
+   update_camera(m_camera_mode, m_universe.m_cam_info, get_camera_input(timing_info.m_last_frame_duration));
+   const frame_settings settings = get_frame_settings(timing_info.m_steady_time);
+   if (m_replay_frame != nullptr)
    {
-      auto& camera_pos = std::get<wasd_mode>(m_camera_mode).m_camera_pos;
-      constexpr float ly_per_sec = 10.0f;
-      const float move_distance = timing_info.m_last_frame_duration * ly_per_sec;
-      if (is_button_pressed(this->get_window(), GLFW_KEY_W))
-         camera_pos += move_distance * m_universe.m_cam_info.m_cs.m_front;
-      if (is_button_pressed(this->get_window(), GLFW_KEY_S))
-         camera_pos += -move_distance * m_universe.m_cam_info.m_cs.m_front;
-      if (is_button_pressed(this->get_window(), GLFW_KEY_A))
-         camera_pos += -move_distance * m_universe.m_cam_info.m_cs.m_right;
-      if (is_button_pressed(this->get_window(), GLFW_KEY_D))
-         camera_pos += move_distance * m_universe.m_cam_info.m_cs.m_right;
+      build_frame(m_universe, m_scene, settings, m_replay_frame, m_frame);
+      m_displayed_frame = &m_frame;
    }
-
-   // calculate things
-   update_mvp_member();
-   if(std::holds_alternative<trailer_mode>(m_camera_mode))
+   else
    {
-      float& progress = std::get<trailer_mode>(m_camera_mode).m_progress;
-      progress = std::fmod(progress + 0.002f, 1.0f);
+      // The update thread builds this while the previous frame is drawn below
+      m_frame_pipeline.request(settings, get_scene_snapshot());
+      m_displayed_frame = &m_frame_pipeline.acquire();
    }
+   submit_frame(m_gl_backend, *m_displayed_frame, m_replay_frame);
 
-   // upload things
-   gpu_upload();
+   draw_frame_labels();
+   if (m_show_candidates)
+      draw_candidate_overlay();
 
-   // render things
-   glEnable(GL_DEPTH_CLAMP);
-   // draw bb
-   if (this->m_show_bb)
-   {
-      m_vao_bb->bind();
-      m_shader_bb.use();
-      m_shader_bb.set_uniform("time", timing_info.m_steady_time);
-      glDisable(GL_DEPTH_TEST);
-      glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<GLsizei>(cylinder_mesh.size()), 12);
-      glEnable(GL_DEPTH_TEST);
-   }
+   // GUI
+   this->gui_draw();
+   if (m_show_profiler)
+      draw_profiler_overlay();
+   if (m_show_frame_stats)
+      draw_frame_stats_overlay();
 
-   if (std::holds_alternative<jumps_mode>(m_gui_mode))
    {
-      m_vao_connection_lines->bind();
-      m_shader_connection.use();
-      glDepthMask(false);
-      glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<GLsizei>(cylinder_mesh.size()), m_connection_trafo_count);
-      glDepthMask(true);
-
-      m_vao_jump_lines->bind();
-      m_shader_lines.use();
-      m_shader_lines.set_uniform("time", timing_info.m_steady_time);
-      glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(jump_line_mesh.size()));
+      SFN_PROFILE_ZONE("imgui render");
+      m_graphics_context->m_imgui_context.frame_end();
    }
-   else if (std::holds_alternative<connections_mode>(m_gui_mode))
+   if (m_replay_frame != nullptr)
+      m_replay_frame->m_cpu_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - cpu_t0).count();
+   m_frame_pacer.mark_swap_begin();
    {
-      m_vao_connection_lines->bind();
-      m_shader_connection.use();
-      glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<GLsizei>(cylinder_mesh.size()), m_connection_trafo_count);
+      SFN_PROFILE_ZONE("swap");
+      glfwSwapBuffers(this->get_window());
+      glfwPollEvents();
    }
+   m_frame_pacer.mark_frame_end();
+   update_replay();
+}
 
-   
-   if (std::holds_alternative<circle_mode>(m_camera_mode))
-   {
-      m_vao_indicator->bind();
-      m_shader_indicator.use();
-      glDisable(GL_DEPTH_TEST);
-      glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(indicator_mesh.size()));
-      glEnable(GL_DEPTH_TEST);
-   }
-   else if (std::holds_alternative<galactic_circle_mode>(m_camera_mode))
+
+auto sfn::engine::draw_loop() -> void
+{
+   while (glfwWindowShouldClose(this->get_window()) == false)
    {
-      m_vao_indicator->bind();
-      m_shader_indicator.use();
-      glDisable(GL_DEPTH_TEST);
-      glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(indicator_mesh.size()));
-      glEnable(GL_DEPTH_TEST);
-
-      const glm::vec3 system_pos = m_universe.m_systems[m_list_selection].get_position(m_position_mode);
-      const float distance = glm::distance(system_pos, this->get_camera_pos());
-      if (distance < 50.0f)
+      if (needs_continuous_frames())
+         invalidate(redraw_camera);
+      const frame_decision decision = m_frame_scheduler.decide(glfwGetTime(), get_animation_fps());
+      if (decision.m_draw)
+      {
+         this->draw_frame();
+         m_frame_scheduler.mark_drawn(glfwGetTime());
+      }
+      else
       {
-         constexpr float dist_from_center = 1.1f;
-         constexpr glm::vec4 color{ 1, 0, 0, 1 };
-         this->draw_text("0",   system_pos + dist_from_center * glm::vec3{  1,  0, 0 }, glm::vec2{}, color);
-         this->draw_text("90",  system_pos + dist_from_center * glm::vec3{  0,  1, 0 }, glm::vec2{}, color);
-         this->draw_text("180", system_pos + dist_from_center * glm::vec3{ -1,  0, 0 }, glm::vec2{}, color);
-         this->draw_text("270", system_pos + dist_from_center * glm::vec3{  0, -1, 0 }, glm::vec2{}, color);
+         // Callbacks invalidate on any input
+         glfwWaitEventsTimeout(decision.m_wait_seconds);
       }
    }
+}
 
-   m_vao_stars->bind();
-   m_shader_stars.use();
-   m_shader_stars.set_uniform("time", timing_info.m_steady_time);
-   glEnable(GL_DEPTH_TEST);
-   glDepthMask(true);
-   glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<GLsizei>(sphere_mesh.size()), static_cast<GLsizei>(m_universe.m_systems.size()));
 
-   if(m_show_star_labels)
-      draw_system_labels();
+auto sfn::engine::invalidate(const redraw_reason reason) -> void
+{
+   m_frame_scheduler.invalidate(reason, glfwGetTime());
+}
 
-   // GUI
-   this->gui_draw();
 
-   m_graphics_context->m_imgui_context.frame_end();
-   glfwSwapBuffers(this->get_window());
-   glfwPollEvents();
-   m_frame_pacer.mark_frame_end();
+auto sfn::engine::needs_continuous_frames() const -> bool
+{
+   const bool camera_animated = std::holds_alternative<trailer_mode>(m_camera_mode) || std::holds_alternative<replay_mode>(m_camera_mode);
+   const bool movement_key_held = std::ranges::any_of(std::array{ GLFW_KEY_W, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_D }, [&](const int key) {
+      return is_button_pressed(this->get_window(), key);
+   });
+
+   // The overlays measure the loop, throttling would skew them
+   const bool measuring = m_show_profiler || m_show_frame_stats || m_recorded_path.has_value();
+   // Pending graph and analysis jobs are polled once a frame
+   const bool graph_pending = m_graph_job.is_busy() || m_analysis_job.is_busy();
+   return camera_animated || movement_key_held || m_mouse_mover.has_value() || measuring || graph_pending;
 }
 
 
-auto sfn::engine::draw_loop() -> void
+auto sfn::engine::get_animation_fps() const -> double
 {
-   while (glfwWindowShouldClose(this->get_window()) == false)
-   {
-      this->draw_frame();
-   }
+   // Dashes on the bounding box and the jump route move continuously
+   if (m_show_bb || (std::holds_alternative<jumps_mode>(m_gui_mode) && m_scene.m_jump_lines.empty() == false))
+      return 15.0;
+
+   // The selected star blinks in quarter seconds
+   return 8.0;
 }
 
 
@@ -535,7 +382,27 @@ auto sfn::engine::draw_loop() -> void
 auto sfn::engine::draw_list() -> bool
 {
    static ImGuiTextFilter filter;
-   filter.Draw((const char*)ICON_FA_SEARCH " Filter");
+   if (filter.Draw((const char*)ICON_FA_SEARCH " Filter"))
+      m_selector.m_filter_dirty = true;
+
+   // Only re-run the filter when its input changed
+   if (m_selector.m_filter_dirty)
+   {
+      m_selector.m_filtered_indices.clear();
+      for (int i = 0; i < std::ssize(m_selector.m_rows); ++i)
+      {
+         if (filter.PassFilter(m_selector.m_rows[i].m_filter_str.c_str()))
+            m_selector.m_filtered_indices.push_back(i);
+      }
+
+      // Nothing matches literally, try prefix/fuzzy search over the names instead
+      if (m_selector.m_filtered_indices.empty() && filter.IsActive())
+      {
+         for (const name_match& match : m_universe.m_name_index.search(filter.InputBuf, 20))
+            m_selector.m_filtered_indices.push_back(match.m_system_index);
+      }
+      m_selector.m_filter_dirty = false;
+   }
 
    int old_selection = m_list_selection;
    if (ImGui::BeginTable("##table_selector", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY))
@@ -546,53 +413,47 @@ auto sfn::engine::draw_list() -> bool
       ImGui::TableSetupColumn("real name", ImGuiTableColumnFlags_None);
       ImGui::TableHeadersRow();
 
-      for (int i = 0; i < m_universe.m_systems.size(); i++)
+      // Only the visible rows are touched
+      ImGuiListClipper clipper;
+      clipper.Begin(static_cast<int>(std::ssize(m_selector.m_filtered_indices)));
+      while (clipper.Step())
       {
-         if (filter.PassFilter(m_universe.m_systems[i].get_name().c_str()) == false)
-            continue;
-         const bool is_selected = (m_list_selection == i);
-
-         ImGui::TableNextRow();
-         ImGui::TableSetColumnIndex(0);
-         right_align_text(fmt::format("{}", i));
-
-         const galactic_coord gc = get_galactic(m_universe.m_systems[i].get_position(m_position_mode));
+         for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
+         {
+            const int i = m_selector.m_filtered_indices[row];
+            const selector_row& entry = m_selector.m_rows[i];
+            const bool is_selected = (m_list_selection == i);
 
-         std::string tooltip_str = fmt::format(
-            "Original name: {}\nGalactic coord:\nl: {:.1f} deg\nb: {:.1f} deg\ndist: {:.1f} LY",
-            m_universe.m_systems[i].m_name, glm::degrees(gc.m_l), glm::degrees(gc.m_b), gc.m_dist
-         );
-         if (m_universe.m_systems[i].m_speculative == true)
-            tooltip_str = "SPECULATIVE!\n" + tooltip_str;
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            right_align_text(entry.m_index_str);
 
-         {
-            ImGui::TableSetColumnIndex(1);
-            const std::optional<std::string> name = m_universe.m_systems[i].get_starfield_name();
-            ImVec4 text_color = name.has_value() ? (ImVec4)ImColor::HSV(1.0f, 0.0f, 1.0f) : (ImVec4)ImColor::HSV(0.0f, 0.0f, 0.5f);
-            if (m_universe.m_systems[i].m_speculative == true)
-               text_color = (ImVec4)ImColor(1.0f, 1.0f, 0.0f);
-            ImGui::PushStyleColor(ImGuiCol_Text, text_color);
-            const std::string imgui_label = fmt::format("{} ##LC{}", name.value_or("unknown"), i);
-            if (ImGui::Selectable(imgui_label.c_str(), is_selected))
             {
-               m_list_selection = i;
+               ImGui::TableSetColumnIndex(1);
+               ImVec4 text_color = entry.m_has_sf_name ? (ImVec4)ImColor::HSV(1.0f, 0.0f, 1.0f) : (ImVec4)ImColor::HSV(0.0f, 0.0f, 0.5f);
+               if (entry.m_speculative == true)
+                  text_color = (ImVec4)ImColor(1.0f, 1.0f, 0.0f);
+               ImGui::PushStyleColor(ImGuiCol_Text, text_color);
+               if (ImGui::Selectable(entry.m_sf_label.c_str(), is_selected))
+               {
+                  m_list_selection = i;
+               }
+               ImGui::PopStyleColor();
+
+               tooltip(entry.m_tooltip.c_str());
             }
-            ImGui::PopStyleColor();
-            
-            tooltip(tooltip_str.c_str());
-         }
-         {
-            ImGui::TableSetColumnIndex(2);
-            const std::string imgui_label = fmt::format("{} ##RC{}", m_universe.m_systems[i].m_astronomic_name, i);
-            if (m_universe.m_systems[i].m_speculative == true)
-               ImGui::PushStyleColor(ImGuiCol_Text, (ImVec4)ImColor(1.0f, 1.0f, 0.0f));
-            if (ImGui::Selectable(imgui_label.c_str(), is_selected))
             {
-               m_list_selection = i;
+               ImGui::TableSetColumnIndex(2);
+               if (entry.m_speculative == true)
+                  ImGui::PushStyleColor(ImGuiCol_Text, (ImVec4)ImColor(1.0f, 1.0f, 0.0f));
+               if (ImGui::Selectable(entry.m_real_label.c_str(), is_selected))
+               {
+                  m_list_selection = i;
+               }
+               if (entry.m_speculative == true)
+                  ImGui::PopStyleColor();
+               tooltip(entry.m_tooltip.c_str());
             }
-            if (m_universe.m_systems[i].m_speculative == true)
-               ImGui::PopStyleColor();
-            tooltip(tooltip_str.c_str());
          }
       }
       ImGui::EndTable();
@@ -601,23 +462,52 @@ auto sfn::engine::draw_list() -> bool
 }
 
 
+auto sfn::engine::update_selector_rows() -> void
+{
+   m_selector.m_rows.clear();
+   m_selector.m_rows.reserve(m_universe.m_systems.size());
+   for (int i = 0; i < std::ssize(m_universe.m_systems); ++i)
+   {
+      const system& sys = m_universe.m_systems[i];
+      const galactic_coord gc = get_galactic(sys.get_position(m_position_mode));
+      const std::optional<std::string> sf_name = sys.get_starfield_name();
+
+      selector_row row{
+         .m_filter_str = sys.get_name(),
+         .m_index_str = fmt::format("{}", i),
+         .m_sf_label = fmt::format("{} ##LC{}", sf_name.value_or("unknown"), i),
+         .m_real_label = fmt::format("{} ##RC{}", sys.m_astronomic_name.get(), i),
+         .m_tooltip = fmt::format(
+            "Original name: {}\nGalactic coord:\nl: {:.1f} deg\nb: {:.1f} deg\ndist: {:.1f} LY",
+            sys.m_name.get(), glm::degrees(gc.m_l), glm::degrees(gc.m_b), gc.m_dist
+         ),
+         .m_has_sf_name = sf_name.has_value(),
+         .m_speculative = sys.m_speculative
+      };
+      if (sys.m_speculative == true)
+         row.m_tooltip = "SPECULATIVE!\n" + row.m_tooltip;
+      m_selector.m_rows.push_back(std::move(row));
+   }
+   m_selector.m_filter_dirty = true;
+}
+
+
 auto sfn::engine::draw_jump_calculations(const bool switched_into_tab) -> void
 {
    // static float jump_range = 20.0f;
-   static std::optional<jump_path> path;
 
    static bool first_plot = true;
    bool course_changed = first_plot || switched_into_tab;
    first_plot = false;
 
 
-   if (ImGui::Button(fmt::format("Source: {} {}", m_universe.m_systems[m_source_index].m_name, (const char*)ICON_FA_MAP_MARKER_ALT).c_str()))
+   if (ImGui::Button(fmt::format("Source: {} {}", m_universe.m_systems[m_source_index].m_name.get(), (const char*)ICON_FA_MAP_MARKER_ALT).c_str()))
    {
       course_changed = true;
       m_source_index = m_list_selection;
    }
    ImGui::SameLine();
-   if (ImGui::Button(fmt::format("Destination: {} {}", m_universe.m_systems[m_destination_index].m_name, (const char*)ICON_FA_MAP_MARKER_ALT).c_str()))
+   if (ImGui::Button(fmt::format("Destination: {} {}", m_universe.m_systems[m_destination_index].m_name.get(), (const char*)ICON_FA_MAP_MARKER_ALT).c_str()))
    {
       course_changed = true;
       m_destination_index = m_list_selection;
@@ -630,86 +520,128 @@ auto sfn::engine::draw_jump_calculations(const bool switched_into_tab) -> void
       m_universe.get_distance(m_source_index, m_destination_index, m_position_mode)
    ).c_str());
 
-   static float slider_min = 0.0f;
-   static float slider_max = 100.0f;
-   
-   if (course_changed)
+   // New endpoints start at their minimum range, which the graph job finds
+   const bool endpoints_changed = course_changed;
+   if (endpoints_changed)
+   {
+      m_jump_slider_max = m_universe.get_distance(m_source_index, m_destination_index, m_position_mode) + 0.001f;
+      m_min_range_outdated = true;
+   }
+
+   course_changed |= ImGui::SliderFloat("jump range", &m_gui_mode.get_jumprange(), m_jump_slider_min, m_jump_slider_max);
+   if (m_graph_job.is_busy())
    {
-      slider_min = get_min_jump_dist(m_universe, m_source_index, m_destination_index, m_position_mode) + 0.001f;
-      slider_max = m_universe.get_distance(m_source_index, m_destination_index, m_position_mode) + 0.001f;
-      m_gui_mode.get_jumprange() = slider_min;
+      ImGui::SameLine();
+      ImGui::TextDisabled(fmt::format("{} computing...", (const char*)ICON_FA_HOURGLASS_HALF).c_str());
    }
 
-   course_changed |= ImGui::SliderFloat("jump range", &m_gui_mode.get_jumprange(), slider_min, slider_max);
+   static route_mode mode = route_mode::shortest;
+   static int alternative_count = 5;
+   bool path_changed = false;
+   if (ImGui::RadioButton("Shortest distance", mode == route_mode::shortest))
+   {
+      mode = route_mode::shortest;
+      course_changed = true;
+   }
+   ImGui::SameLine();
+   if (ImGui::RadioButton("Alternatives", mode == route_mode::alternatives))
+   {
+      mode = route_mode::alternatives;
+      course_changed = true;
+   }
+   ImGui::SameLine();
+   if (ImGui::RadioButton("Pareto front", mode == route_mode::pareto))
+   {
+      mode = route_mode::pareto;
+      course_changed = true;
+   }
+   if (mode == route_mode::alternatives)
+      course_changed |= ImGui::SliderInt("alternatives", &alternative_count, 2, 10);
 
-   static std::vector<std::string> path_strings;
-   // Graph and path update
+   // Graph and routes are computed in the background. The last ones stay up until the new ones are in
    if (course_changed || switched_into_tab)
    {
-      m_starfield_graph = get_graph_from_universe(m_universe, m_gui_mode.get_jumprange());
-      build_connection_mesh_from_graph(m_starfield_graph);
-
-      const auto distance_getter = [&](const int i, const int j) {return m_universe.get_distance(i, j, m_position_mode); };
-      path = m_starfield_graph.get_jump_path(m_source_index, m_destination_index, distance_getter);
+      submit_graph_job(route_request{
+         .m_source_index = m_source_index,
+         .m_destination_index = m_destination_index,
+         .m_jump_range = endpoints_changed ? std::nullopt : std::optional<float>(m_gui_mode.get_jumprange()),
+         .m_with_min_jump_range = m_min_range_outdated,
+         .m_route_mode = mode,
+         .m_alternative_count = alternative_count,
+         .m_position_mode = m_position_mode
+      });
+   }
+   if (m_route_result.has_value())
+   {
+      if (m_route_result->m_min_jump_range.has_value())
+      {
+         m_jump_slider_min = *m_route_result->m_min_jump_range;
+         m_min_range_outdated = false;
+      }
+      m_route_choices = std::move(m_route_result->m_route_choices);
+      m_route_selection = 0;
+      m_displayed_path = std::move(m_route_result->m_path);
+      path_changed = true;
+      m_route_result.reset();
+   }
 
-      if (path.has_value())
+   if (m_route_choices.empty() == false)
+   {
+      if (ImGui::BeginCombo("route", m_route_choices[m_route_selection].first.c_str()))
       {
-         path_strings.clear();
-         float travelled_distance = 0.0f;
-         for (int i = 0; i < path->m_stops.size() - 1; ++i)
+         for (int i = 0; i < std::ssize(m_route_choices); ++i)
          {
-            const int this_stop_system = path->m_stops[i];
-            const int next_stop_system = path->m_stops[i + 1];
-            const float dist = glm::distance(
-               m_universe.m_systems[this_stop_system].get_position(m_position_mode),
-               m_universe.m_systems[next_stop_system].get_position(m_position_mode)
-            );
-            travelled_distance += dist;
-
-            path_strings.push_back(fmt::format(
-               "Jump {}: {} to {}. Distance: {:.1f} LY\n",
-               i+1,
-               m_universe.m_systems[this_stop_system].m_name,
-               m_universe.m_systems[next_stop_system].m_name,
-               dist
-            ));
+            if (ImGui::Selectable(m_route_choices[i].first.c_str(), i == m_route_selection))
+            {
+               m_route_selection = i;
+               m_displayed_path = m_route_choices[i].second;
+               path_changed = true;
+            }
          }
-         path_strings.push_back("-----");
-         path_strings.push_back(fmt::format("Travelled distance: {:.1f} LY", travelled_distance));
+         ImGui::EndCombo();
+      }
+   }
 
-         // update vertices
-         jump_line_mesh.clear();
-         travelled_distance = 0.0f;
-         for (int i = 0; i < path->m_stops.size() - 1; ++i)
-         {
-            const int this_stop_system = path->m_stops[i];
-            const int next_stop_system = path->m_stops[i + 1];
-            const float dist = glm::distance(
-               m_universe.m_systems[this_stop_system].get_position(m_position_mode),
-               m_universe.m_systems[next_stop_system].get_position(m_position_mode)
-            );
-
-            jump_line_mesh.push_back(
-               line_vertex_data{
-                  .m_position = m_universe.m_systems[this_stop_system].get_position(m_position_mode),
-                  .m_progress = travelled_distance
-               }
-            );
-            travelled_distance += dist;
-            jump_line_mesh.push_back(
-               line_vertex_data{
-                  .m_position = m_universe.m_systems[next_stop_system].get_position(m_position_mode),
-                  .m_progress = travelled_distance
-               }
-            );
-         }
+   if (ImGui::CollapsingHeader("Itinerary"))
+   {
+      if (ImGui::Button(fmt::format("Add {}", m_universe.m_systems[m_list_selection].get_name()).c_str()))
+         m_waypoints.push_back(m_list_selection);
+      ImGui::SameLine();
+      if (ImGui::Button("Clear"))
+         m_waypoints.clear();
+      ImGui::SameLine();
+      if (ImGui::Button("Plan route") && std::ssize(m_waypoints) >= 2)
+      {
+         const std::optional<itinerary> plan = get_itinerary(m_starfield_graph, m_universe, m_waypoints, m_position_mode);
+         m_route_choices.clear();
+         m_displayed_path = plan.has_value() ? std::optional<jump_path>(plan->m_path) : std::nullopt;
+         if (plan.has_value())
+            m_waypoints = plan->m_waypoint_order;
+         path_changed = true;
       }
 
-      
+      std::optional<int> removed_waypoint;
+      for (int i = 0; i < std::ssize(m_waypoints); ++i)
+      {
+         ImGui::PushID(i);
+         if (ImGui::SmallButton("x"))
+            removed_waypoint = i;
+         ImGui::SameLine();
+         ImGui::Text(fmt::format("{}: {}", i + 1, m_universe.m_systems[m_waypoints[i]].get_name()).c_str());
+         ImGui::PopID();
+      }
+      if (removed_waypoint.has_value())
+         m_waypoints.erase(std::begin(m_waypoints) + *removed_waypoint);
    }
 
+   if (path_changed && m_displayed_path.has_value())
+      set_displayed_path(*m_displayed_path);
+
+   const cache_stats route_stats = get_route_cache().get_route_stats();
+   ImGui::TextDisabled(fmt::format("Route cache: {:.0f}% hits ({} queries)", 100.0 * route_stats.get_hit_rate(), route_stats.m_hits + route_stats.m_misses).c_str());
+
    // Path display
-   if (path.has_value() == false)
+   if (m_displayed_path.has_value() == false)
    {
       ImGui::Text("Jump range not large enough\n");
    }
@@ -718,7 +650,7 @@ auto sfn::engine::draw_jump_calculations(const bool switched_into_tab) -> void
       const auto avail = ImGui::GetContentRegionAvail();
       if (ImGui::BeginListBox("##result", ImVec2(-FLT_MIN, avail.y)))
       {
-         for (const std::string& path_string : path_strings)
+         for (const std::string& path_string : m_path_strings)
             ImGui::Text(path_string.c_str());
          ImGui::EndListBox();
       }
@@ -726,121 +658,233 @@ auto sfn::engine::draw_jump_calculations(const bool switched_into_tab) -> void
 }
 
 
-auto engine::bind_ubo(
-   const std::string& name,
-   const buffer& buffer_ref,
-   const id segment_id,
-   const shader_program& shader
-) const -> void
+auto sfn::engine::set_displayed_path(const jump_path& path) -> void
 {
-   const GLuint block_index = glGetUniformBlockIndex(shader.m_opengl_id, name.c_str());
-   const int binding_point = m_binding_point_man.get_point(segment_id);
-   glUniformBlockBinding(shader.m_opengl_id, block_index, binding_point);
-   glBindBufferBase(GL_UNIFORM_BUFFER, binding_point, buffer_ref.m_buffer_opengl_id);
-
-   const auto segment_size = buffer_ref.get_segment_size(segment_id);
-   const auto offset_in_buffer = buffer_ref.get_segment_offset(segment_id);
-   glBindBufferRange(GL_UNIFORM_BUFFER, binding_point, buffer_ref.m_buffer_opengl_id, offset_in_buffer, segment_size);
+   m_path_strings.clear();
+   float travelled_distance = 0.0f;
+   for (int i = 0; i < path.m_stops.size() - 1; ++i)
+   {
+      const int this_stop_system = path.m_stops[i];
+      const int next_stop_system = path.m_stops[i + 1];
+      const float dist = glm::distance(
+         m_universe.m_systems[this_stop_system].get_position(m_position_mode),
+         m_universe.m_systems[next_stop_system].get_position(m_position_mode)
+      );
+      travelled_distance += dist;
+
+      m_path_strings.push_back(fmt::format(
+         "Jump {}: {} to {}. Distance: {:.1f} LY\n",
+         i+1,
+         m_universe.m_systems[this_stop_system].m_name.get(),
+         m_universe.m_systems[next_stop_system].m_name.get(),
+         dist
+      ));
+   }
+   m_path_strings.push_back("-----");
+   m_path_strings.push_back(fmt::format("Travelled distance: {:.1f} LY", travelled_distance));
+
+   // update vertices
+   edit_scene().m_jump_lines.clear();
+   travelled_distance = 0.0f;
+   for (int i = 0; i < path.m_stops.size() - 1; ++i)
+   {
+      const int this_stop_system = path.m_stops[i];
+      const int next_stop_system = path.m_stops[i + 1];
+      const float dist = glm::distance(
+         m_universe.m_systems[this_stop_system].get_position(m_position_mode),
+         m_universe.m_systems[next_stop_system].get_position(m_position_mode)
+      );
+
+      edit_scene().m_jump_lines.push_back(
+         line_vertex_data{
+            .m_position = m_universe.m_systems[this_stop_system].get_position(m_position_mode),
+            .m_progress = travelled_distance
+         }
+      );
+      travelled_distance += dist;
+      edit_scene().m_jump_lines.push_back(
+         line_vertex_data{
+            .m_position = m_universe.m_systems[next_stop_system].get_position(m_position_mode),
+            .m_progress = travelled_distance
+         }
+      );
+   }
 }
 
 
-auto engine::bind_ssbo(
-   const std::string& name,
-   const buffer& buffer_ref,
-   const id segment_id,
-   const shader_program& shader
-) const -> void
+auto engine::get_camera_input(const float frame_duration) -> camera_input
 {
-   const GLuint block_index = glGetProgramResourceIndex(shader.m_opengl_id, GL_SHADER_STORAGE_BLOCK, name.c_str());
+   return camera_input{
+      .m_forward = is_button_pressed(this->get_window(), GLFW_KEY_W),
+      .m_backward = is_button_pressed(this->get_window(), GLFW_KEY_S),
+      .m_left = is_button_pressed(this->get_window(), GLFW_KEY_A),
+      .m_right = is_button_pressed(this->get_window(), GLFW_KEY_D),
+      .m_mouse_movement = m_mouse_mover.has_value() ? m_mouse_mover->get_mouse_movement(this->get_window()) : glm::vec2{},
+      .m_frame_duration = frame_duration
+   };
+}
 
-   const int binding_point = m_binding_point_man.get_point(segment_id);
-   glShaderStorageBlockBinding(shader.m_opengl_id, block_index, binding_point);
-   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding_point, buffer_ref.m_buffer_opengl_id);
 
-   const auto segment_size = buffer_ref.get_segment_size(segment_id);
-   const auto offset_in_buffer = buffer_ref.get_segment_offset(segment_id);
-   glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding_point, buffer_ref.m_buffer_opengl_id, offset_in_buffer, segment_size);
+auto engine::get_frame_settings(const float steady_time) const -> frame_settings
+{
+   return frame_settings{
+      .m_camera_mode = m_camera_mode,
+      .m_projection_params = m_projection_params,
+      .m_position_mode = m_position_mode,
+      .m_resolution = glm::ivec2{ m_config.res_x, m_config.res_y },
+      .m_selection = m_list_selection,
+      .m_steady_time = steady_time,
+      .m_show_bb = m_show_bb,
+      .m_show_labels = m_show_star_labels,
+      .m_show_route = std::holds_alternative<jumps_mode>(m_gui_mode)
+   };
 }
 
 
-auto engine::gpu_upload() const -> void
+auto sfn::engine::build_displayed_connection_mesh() -> void
 {
-   m_buffers2.upload_ubo(m_mvp_ubo_id, as_bytes(m_current_mvp));
-   m_buffers2.upload_vbo(m_star_vbo_id, as_bytes(sphere_mesh));
-   m_buffers2.upload_vbo(m_jump_lines_vbo_id, as_bytes(jump_line_mesh));
-   m_buffers2.upload_vbo(m_indicator_vbo_id, as_bytes(indicator_mesh));
-   m_buffers2.upload_vbo(m_cylinder_vbo_id, as_bytes(cylinder_mesh));
-
-   m_buffers2.upload_ssbo(m_star_ssbo_id, as_bytes(m_star_props_ssbo), 0);
+   if (std::holds_alternative<connections_mode>(m_gui_mode) == false || m_connection_display == connection_display::all)
+      edit_scene().m_connection_trafos = get_connection_trafos(m_universe, m_starfield_graph, m_position_mode);
+   else if (m_connection_display == connection_display::faction_borders)
+      build_border_connection_mesh();
+   else
+      build_chokepoint_connection_mesh();
 }
 
 
-auto engine::update_mvp_member() -> void
+auto sfn::engine::submit_graph_job(const route_request& request) -> void
 {
-   m_current_mvp.selected_index = m_list_selection;
-   m_current_mvp.m_cam_pos = get_camera_pos();
-   m_current_mvp.m_selected_system_pos = m_universe.m_systems[m_list_selection].get_position(m_position_mode);
-   m_current_mvp.m_projection = std::visit(
-      [&](const auto& alternative) {return get_projection_matrix(m_config, alternative); },
-      m_projection_params
-   );
-   m_current_mvp.m_view = std::visit(
-      [&](const auto& x) {return get_view_matrix(x); },
-      m_camera_mode
-   );
+   // The graph only depends on the range, a copy is cheaper than a rebuild
+   std::optional<graph> reused_graph;
+   if (request.m_jump_range == m_starfield_graph.m_jump_range)
+      reused_graph = m_starfield_graph;
+   m_graph_job.submit([this, request, reused_graph = std::move(reused_graph)](const std::stop_token& stop) mutable {
+      return compute_routes(m_universe, request, std::move(reused_graph), stop);
+   });
 }
 
 
-auto engine::get_camera_pos() const -> glm::vec3
+auto sfn::engine::update_graph_job() -> void
 {
-   const auto visitor = [&]<typename T>(const T& mode) -> glm::vec3{
-      if constexpr(std::same_as<T, wasd_mode>)
-      {
-         return mode.m_camera_pos;
-      }
-      else if constexpr (std::same_as<T, trailer_mode>)
-      {
-         return glm::mix(m_universe.m_cam_info.m_cam_pos0, m_universe.m_cam_info.m_cam_pos1, mode.m_progress);
-      }
-      else if constexpr (centery<T>)
-      {
-         const glm::vec3 offset = get_cartesian_from_spherical(mode.horiz_angle_offset, mode.vert_angle_offset, mode.distance, get_cs());
-         return m_universe.m_systems[mode.m_planet].get_position(m_position_mode) + offset;
-      }
-   };
-   return std::visit(visitor, m_camera_mode);
+   std::optional<route_result> result = m_graph_job.take_result();
+   if (result.has_value() == false)
+      return;
+   m_gui_mode.get_jumprange() = result->m_graph.m_jump_range;
+   m_starfield_graph = std::move(result->m_graph);
+   build_displayed_connection_mesh();
+   if (result->m_request.m_route_mode.has_value())
+      m_route_result = std::move(result);
+   invalidate(redraw_data);
 }
 
 
+auto sfn::engine::edit_scene() -> scene&
+{
+   m_scene_dirty = true;
+   return m_scene;
+}
+
 
+auto sfn::engine::get_scene_snapshot() -> std::shared_ptr<const scene>
+{
+   // Copied only after changes. Frames still being built keep the old one alive
+   if (m_scene_dirty)
+   {
+      m_scene_snapshot = std::make_shared<const scene>(m_scene);
+      m_scene_dirty = false;
+   }
+   return m_scene_snapshot;
+}
 
 
-auto sfn::engine::build_connection_mesh_from_graph(
-   const graph& connection_graph
-) -> void
+auto sfn::engine::build_border_connection_mesh() -> void
 {
-   m_connection_trafo_count = std::clamp(
-      static_cast<int>(std::ssize(connection_graph.m_connections)),
-      0,
-      static_cast<int>(std::ssize(m_star_props_ssbo.connection_trafos))-1
-   );
-
-   int i = 0;
-   for (const auto& [key, con] : connection_graph.m_connections)
+   edit_scene().m_connection_trafos.clear();
+   for (const connection& border : m_territory.m_border_connections)
    {
-      if (i >= std::ssize(m_star_props_ssbo.connection_trafos))
-         return;
+      const glm::vec3& p0 = m_universe.m_systems[border.m_node_index0].get_position(m_position_mode);
+      const glm::vec3& p1 = m_universe.m_systems[border.m_node_index1].get_position(m_position_mode);
+      edit_scene().m_connection_trafos.push_back(get_obj_trafo_between_points(p0, p1, 0.05f));
+   }
+}
+
+
+auto sfn::engine::build_chokepoint_connection_mesh() -> void
+{
+   // The betweenness is indexed like the connections of its graph. Until the analysis job brings the one for the
+   // current graph, the last mesh stays up
+   if (m_chokepoints.m_jump_range != m_starfield_graph.m_jump_range)
+      return;
 
+   // The connection shader has no per-instance color, so the heat goes into the thickness. Busiest first, the backend
+   // drops what doesn't fit into its buffer
+   std::vector<int> slots(std::ssize(m_chokepoints.m_connection_betweenness));
+   std::iota(std::begin(slots), std::end(slots), 0);
+   const auto busier = [&](const int a, const int b) {
+      return m_chokepoints.m_connection_betweenness[a] > m_chokepoints.m_connection_betweenness[b];
+   };
+   std::ranges::stable_sort(slots, busier);
+   edit_scene().m_connection_trafos.clear();
+   for (int i = 0; i < std::ssize(slots); ++i)
+   {
+      const connection& con = m_starfield_graph.m_connections.at(m_starfield_graph.m_sorted_connections[slots[i]]);
+      const float heat = m_chokepoints.m_max_connection_betweenness > 0.0f ? m_chokepoints.m_connection_betweenness[slots[i]] / m_chokepoints.m_max_connection_betweenness : 0.0f;
       const glm::vec3& p0 = m_universe.m_systems[con.m_node_index0].get_position(m_position_mode);
       const glm::vec3& p1 = m_universe.m_systems[con.m_node_index1].get_position(m_position_mode);
-      m_star_props_ssbo.connection_trafos[i] = get_obj_trafo_between_points(p0, p1, 0.05f);
-      ++i;
+      edit_scene().m_connection_trafos.push_back(get_obj_trafo_between_points(p0, p1, 0.02f + 0.3f * std::sqrt(heat)));
    }
 }
 
 
+auto sfn::engine::get_analysis_request() const -> std::optional<analysis_request>
+{
+   const bool connections_shown = std::holds_alternative<connections_mode>(m_gui_mode);
+   const bool territory_shown = m_star_color_mode == star_color_mode::factions
+      || (connections_shown && m_connection_display == connection_display::faction_borders);
+   const bool chokepoints_shown = m_star_color_mode == star_color_mode::chokepoints
+      || (connections_shown && m_connection_display == connection_display::chokepoints);
+   const analysis_request request{
+      .m_jump_range = m_starfield_graph.m_jump_range,
+      .m_position_mode = m_position_mode,
+      .m_with_territory = territory_shown && m_territory.is_outdated(m_starfield_graph, m_position_mode),
+      .m_with_chokepoints = chokepoints_shown && m_chokepoints.is_outdated(m_starfield_graph, m_position_mode)
+   };
+   if (request.m_with_territory == false && request.m_with_chokepoints == false)
+      return std::nullopt;
+   return request;
+}
+
+
+auto sfn::engine::update_analysis_job() -> void
+{
+   if (std::optional<analysis_result> result = m_analysis_job.take_result(); result.has_value())
+   {
+      if (result->m_territory.has_value())
+         m_territory = std::move(*result->m_territory);
+      if (result->m_chokepoints.has_value())
+         m_chokepoints = std::move(*result->m_chokepoints);
+      m_submitted_analysis.reset();
+      if (std::holds_alternative<connections_mode>(m_gui_mode) && m_connection_display != connection_display::all)
+         build_displayed_connection_mesh();
+      if (m_star_color_mode == star_color_mode::factions || m_star_color_mode == star_color_mode::chokepoints)
+         update_star_instances(m_abs_mag_threshold);
+      invalidate(redraw_data);
+   }
+
+   // A job that's already on its way for the same graph is left running
+   const std::optional<analysis_request> request = get_analysis_request();
+   if (request.has_value() == false || request == m_submitted_analysis)
+      return;
+   m_submitted_analysis = request;
+   m_analysis_job.submit([this, request = *request, jump_graph = m_starfield_graph](const std::stop_token& stop) {
+      return compute_analysis(m_universe, request, jump_graph, stop);
+   });
+}
+
+
 auto sfn::engine::gui_draw() -> void
 {
+   SFN_PROFILE_ZONE("gui");
    bool view_mode_changed = false;
    {
       normal_imgui_window w(glm::ivec2{ 250, 0 }, glm::ivec2{ 500, 60 }, fmt::format("Camera {}", (const char*)ICON_FA_VIDEO).c_str());
@@ -891,6 +935,7 @@ auto sfn::engine::gui_draw() -> void
    bool selection_changed = false;
    {
       normal_imgui_window w(glm::ivec2{ 0, 0 }, glm::ivec2{ 250, 500 }, "System selector");
+      scoped_phase_timer timer(m_replay_frame, replay_phase::list);
       selection_changed = draw_list();
    }
    {
@@ -898,6 +943,11 @@ auto sfn::engine::gui_draw() -> void
 
       ImGui::Checkbox("Show star names", &m_show_star_labels);
       ImGui::Checkbox("Show bounding box", &m_show_bb);
+      ImGui::Checkbox("Show profiler", &m_show_profiler);
+      ImGui::SameLine();
+      ImGui::Checkbox("Show frame stats", &m_show_frame_stats);
+      ImGui::Checkbox("Render on demand", &m_frame_scheduler.m_enabled);
+      tooltip("Only draws at full rate while something changes, animations run slower when idle");
       {
          static int radio_selected = 0;
          const int old_selected = radio_selected;
@@ -919,15 +969,57 @@ auto sfn::engine::gui_draw() -> void
             ImGui::PushItemWidth(-FLT_MIN);
             if (ImGui::SliderFloat("", &m_abs_mag_threshold, 0.0f, 20.0f))
             {
-               this->update_ssbo_colors_and_positions(m_abs_mag_threshold);
+               this->update_star_instances(m_abs_mag_threshold);
             }
             ImGui::PopItemWidth();
             tooltip("Stars with magnitude higher than this (=darker) are dimmed");
          }
 
+         ImGui::SameLine();
+         if (ImGui::RadioButton("reachability", &radio_selected, 2))
+         {
+            m_star_color_mode = star_color_mode::reachability;
+         }
+         ImGui::SameLine();
+         if (ImGui::RadioButton("factions", &radio_selected, 3))
+         {
+            m_star_color_mode = star_color_mode::factions;
+         }
+         tooltip("Every system goes to the faction with the closest home system, along the jumps at the current range");
+         ImGui::SameLine();
+         if (ImGui::RadioButton("chokepoints", &radio_selected, 4))
+         {
+            m_star_color_mode = star_color_mode::chokepoints;
+         }
+         tooltip("Betweenness centrality: how many shortest routes at the current range go through a system. Systems that would split the map are white");
+         if (m_star_color_mode == star_color_mode::reachability)
+         {
+            bool budget_changed = false;
+            if (ImGui::RadioButton("jumps", m_isochrone_budget.m_metric == isochrone_metric::jumps))
+            {
+               m_isochrone_budget.m_metric = isochrone_metric::jumps;
+               budget_changed = true;
+            }
+            ImGui::SameLine();
+            if (ImGui::RadioButton("light-years", m_isochrone_budget.m_metric == isochrone_metric::distance))
+            {
+               m_isochrone_budget.m_metric = isochrone_metric::distance;
+               budget_changed = true;
+            }
+            ImGui::PushItemWidth(-FLT_MIN);
+            if (m_isochrone_budget.m_metric == isochrone_metric::jumps)
+               budget_changed |= ImGui::SliderInt("##max_jumps", &m_isochrone_budget.m_max_jumps, 1, 10);
+            else
+               budget_changed |= ImGui::SliderFloat("##max_distance", &m_isochrone_budget.m_max_distance, 10.0f, 200.0f);
+            ImGui::PopItemWidth();
+            tooltip("Systems reachable from the selected one at the current jump range, within this many jumps or light-years");
+            if (budget_changed)
+               this->update_star_instances(m_abs_mag_threshold);
+         }
+
          if (radio_selected != old_selected)
          {
-            this->update_ssbo_colors_and_positions(m_abs_mag_threshold);
+            this->update_star_instances(m_abs_mag_threshold);
          }
       }
       
@@ -959,16 +1051,21 @@ auto sfn::engine::gui_draw() -> void
       if (ImGui::RadioButton("Reconstructed", m_position_mode==position_mode::reconstructed))
       {
          m_position_mode = position_mode::reconstructed;
-         this->update_ssbo_colors_and_positions(m_abs_mag_threshold);
-         this->build_connection_mesh_from_graph(m_starfield_graph);
+         this->update_star_instances(m_abs_mag_threshold);
+         this->build_displayed_connection_mesh();
+         this->update_selector_rows();
       }
       ImGui::SameLine();
       if (ImGui::RadioButton("Accurate", m_position_mode == position_mode::from_catalog))
       {
          m_position_mode = position_mode::from_catalog;
-         this->update_ssbo_colors_and_positions(m_abs_mag_threshold);
-         this->build_connection_mesh_from_graph(m_starfield_graph);
+         this->update_star_instances(m_abs_mag_threshold);
+         this->build_displayed_connection_mesh();
+         this->update_selector_rows();
       }
+
+      draw_candidate_search();
+      draw_replay_controls();
    }
    if(selection_changed || view_mode_changed)
    {
@@ -981,7 +1078,7 @@ auto sfn::engine::gui_draw() -> void
       };
       std::visit(center_updater, m_camera_mode);
 
-      indicator_mesh = get_indicator_mesh(m_universe.m_systems[m_list_selection].get_position(m_position_mode), this->get_cs());
+      edit_scene().m_indicator = get_indicator_mesh(m_universe.m_systems[m_list_selection].get_position(m_position_mode), get_camera_cs(m_universe.m_cam_info, m_camera_mode));
    }
 
    {
@@ -999,14 +1096,40 @@ auto sfn::engine::gui_draw() -> void
          {
             if(std::holds_alternative<connections_mode>(m_gui_mode) == false)
                m_gui_mode = gui_mode{ connections_mode{ m_gui_mode.get_jumprange() } };
-            static graph connection_graph = get_graph_from_universe(m_universe, m_gui_mode.get_jumprange());
             bool changed = m_gui_mode.index() != old_gui_index;
             changed |= ImGui::SliderFloat("jump range", &m_gui_mode.get_jumprange(), 0, 30);
-            if(changed || m_connection_trafo_count == 0)
+            const auto display_radio = [&](const char* label, const connection_display display) {
+               if (ImGui::RadioButton(label, m_connection_display == display))
+               {
+                  m_connection_display = display;
+                  changed = true;
+               }
+            };
+            display_radio("All", connection_display::all);
+            ImGui::SameLine();
+            display_radio("Faction borders", connection_display::faction_borders);
+            ImGui::SameLine();
+            display_radio("Chokepoints", connection_display::chokepoints);
+            tooltip("Connections get thicker the more shortest routes go through them");
+            if(changed || m_scene.m_connection_trafos.empty())
             {
-               connection_graph = get_graph_from_universe(m_universe, m_gui_mode.get_jumprange());
-               build_connection_mesh_from_graph(connection_graph);
+               // A new range rebuilds in the background, the mesh follows once the graph is there
+               if (m_starfield_graph.m_jump_range != m_gui_mode.get_jumprange())
+               {
+                  submit_graph_job(route_request{
+                     .m_jump_range = m_gui_mode.get_jumprange(),
+                     .m_position_mode = m_position_mode
+                  });
+               }
+               else
+                  build_displayed_connection_mesh();
             }
+            if (m_graph_job.is_busy() || m_analysis_job.is_busy())
+               ImGui::TextDisabled(fmt::format("{} computing...", (const char*)ICON_FA_HOURGLASS_HALF).c_str());
+            if (m_connection_display == connection_display::faction_borders)
+               ImGui::Text(fmt::format("{} border connections", std::ssize(m_territory.m_border_connections)).c_str());
+            if (m_connection_display == connection_display::chokepoints)
+               ImGui::Text(fmt::format("{} articulation points, {} bridges", std::ssize(m_chokepoints.m_articulation_points), std::ssize(m_chokepoints.m_bridges)).c_str());
             ImGui::EndTabItem();
          }
 
@@ -1036,35 +1159,18 @@ auto sfn::engine::gui_draw() -> void
 
    }
 
-   // ImGui::ShowDemoWindow();
-}
-
-
-auto engine::get_view_matrix(const camera_mode& mode) const -> glm::mat4
-{
-   glm::vec3 up_vector = m_universe.m_cam_info.m_cs.m_up;
-   if(std::holds_alternative<galactic_circle_mode>(mode))
-   {
-      up_vector = glm::vec3{ 0, 0, 1 };
-   }
+   // Follows the selection and the graph, so it's recomputed live while dragging either range slider
+   const bool isochrone_outdated = selection_changed || m_isochrone.m_jump_range != m_starfield_graph.m_jump_range;
+   if (m_star_color_mode == star_color_mode::reachability && isochrone_outdated)
+      this->update_star_instances(m_abs_mag_threshold);
 
-   return glm::lookAt(
-      this->get_camera_pos(),
-      get_camera_target(mode),
-      up_vector
-   );
+   // ImGui::ShowDemoWindow();
 }
 
 
-auto engine::get_camera_target(const camera_mode& mode) const -> glm::vec3
+auto engine::get_screen_pos(const glm::vec3& pos) const -> std::optional<glm::vec2>
 {
-   const auto visitor = [&]<typename T>(const T& alternative) {
-      if constexpr(centery<T>)
-         return m_universe.m_systems[alternative.m_planet].get_position(m_position_mode);
-      else if constexpr(std::same_as<T, wasd_mode> || std::same_as<T, trailer_mode>)
-         return this->get_camera_pos() + m_universe.m_cam_info.m_cs.m_front;
-   };
-   return std::visit(visitor, mode);
+   return sfn::get_screen_pos(m_displayed_frame->m_projection * m_displayed_frame->m_view, m_displayed_frame->m_resolution, pos);
 }
 
 
@@ -1075,14 +1181,21 @@ auto engine::draw_text(
    const glm::vec4& color
 ) const -> void
 {
-   glm::vec4 screen_pos = m_current_mvp.m_projection * m_current_mvp.m_view * glm::vec4{ pos, 1.0f };
-   if (screen_pos[3] < 0)
+   const std::optional<glm::vec2> screen_pos = get_screen_pos(pos);
+   if (screen_pos.has_value() == false)
       return;
-   screen_pos /= screen_pos[3];
+   draw_screen_text(text, *screen_pos, center_offset, color);
+}
 
-   glm::vec2 imgui_draw_pos = 0.5f * (glm::vec2(screen_pos) + 1.0f);
-   imgui_draw_pos[1] = 1.0f - imgui_draw_pos[1];
-   imgui_draw_pos *= glm::vec2{ m_config.res_x, m_config.res_y };
+
+auto engine::draw_screen_text(
+   const std::string& text,
+   const glm::vec2& screen_pos,
+   const glm::vec2& center_offset,
+   const glm::vec4& color
+) const -> void
+{
+   glm::vec2 imgui_draw_pos = screen_pos;
 
    const ImVec2 text_size = ImGui::CalcTextSize(text.c_str());
    imgui_draw_pos.x -= 0.5f * text_size.x;
@@ -1094,85 +1207,379 @@ auto engine::draw_text(
 }
 
 
-auto engine::get_cs() const -> cs
+auto engine::update_star_instances(const float abs_threshold) -> void
 {
-   if(std::holds_alternative<galactic_circle_mode>(m_camera_mode))
+   SFN_PROFILE_ZONE("star colors");
+   constexpr glm::vec3 speculative_color{ 1, 1, 0 };
+
+   // Colored by size, the other modes recolor
+   std::vector<star_prop_element>& stars = edit_scene().m_stars;
+   stars = get_star_instances(m_universe, m_position_mode);
+   const position_arrays& positions = m_universe.m_arrays.get_positions(m_position_mode);
+   const std::vector<uint8_t>& flags = m_universe.m_arrays.m_flags;
+   if (m_star_color_mode == star_color_mode::abs_mag)
    {
-      return cs(glm::vec3{ 0, 1, 0 }, glm::vec3{ 0, 0, 1 });
+      for (int i = 0; i < positions.size(); ++i)
+      {
+         constexpr glm::vec3 bright{ 1.0f };
+         constexpr glm::vec3 faint{ 0.5f };
+         stars[i].color = (m_universe.m_arrays.m_abs_mag[i] < abs_threshold) ? bright : faint;
+         if (flags[i] & system_flag_speculative)
+            stars[i].color = speculative_color;
+      }
    }
-   else
+   else if (m_star_color_mode == star_color_mode::reachability)
    {
-      return m_universe.m_cam_info.m_cs;
+      update_isochrone(m_starfield_graph, m_universe, m_list_selection, m_isochrone_budget, m_position_mode, m_isochrone);
+      for (int i = 0; i < positions.size(); ++i)
+      {
+         constexpr glm::vec3 close_color{ 0.4f, 1.0f, 1.0f };
+         constexpr glm::vec3 far_color{ 1.0f, 0.5f, 0.2f };
+         constexpr glm::vec3 unreached_color{ 0.3f };
+         if (i == m_list_selection)
+            stars[i].color = glm::vec3{ 1.0f };
+         else if (m_isochrone.is_reached(i))
+            stars[i].color = glm::mix(close_color, far_color, m_isochrone.get_budget_fraction(i));
+         else
+            stars[i].color = unreached_color;
+      }
+   }
+   // Territory and chokepoints come from the analysis job and are recolored when it's done. Until then the last ones
+   // stay up, or the stars keep their size colors before the first
+   else if (m_star_color_mode == star_color_mode::factions && std::ssize(m_territory.m_owners) == positions.size())
+   {
+      for (int i = 0; i < positions.size(); ++i)
+      {
+         constexpr std::array<glm::vec3, faction_count> faction_colors{
+            glm::vec3{ 0.4f, 0.6f, 1.0f },
+            glm::vec3{ 1.0f, 0.8f, 0.3f },
+            glm::vec3{ 1.0f, 0.3f, 0.3f }
+         };
+         constexpr glm::vec3 unclaimed_color{ 0.3f };
+         const std::optional<factions>& owner = m_territory.m_owners[i];
+         stars[i].color = owner.has_value() ? faction_colors[static_cast<int>(*owner)] : unclaimed_color;
+         if (m_territory.m_closest_seeds[i] == i)
+            stars[i].color = glm::mix(stars[i].color, glm::vec3{ 1.0f }, 0.5f);
+      }
+   }
+   else if (m_star_color_mode == star_color_mode::chokepoints && std::ssize(m_chokepoints.m_system_betweenness) == positions.size())
+   {
+      for (int i = 0; i < positions.size(); ++i)
+      {
+         constexpr glm::vec3 cold_color{ 0.2f, 0.3f, 1.0f };
+         constexpr glm::vec3 warm_color{ 1.0f, 0.9f, 0.2f };
+         constexpr glm::vec3 hot_color{ 1.0f, 0.1f, 0.1f };
+         const float heat = m_chokepoints.m_max_system_betweenness > 0.0f ? std::sqrt(m_chokepoints.m_system_betweenness[i] / m_chokepoints.m_max_system_betweenness) : 0.0f;
+         stars[i].color = heat < 0.5f
+            ? glm::mix(cold_color, warm_color, 2.0f * heat)
+            : glm::mix(warm_color, hot_color, 2.0f * heat - 1.0f);
+      }
+      for (const int articulation_point : m_chokepoints.m_articulation_points)
+         stars[articulation_point].color = glm::vec3{ 1.0f };
    }
 }
 
 
-auto engine::update_ssbo_colors_and_positions(const float abs_threshold) -> void
+auto engine::draw_profiler_overlay() -> void
 {
-   constexpr glm::vec3 speculative_color{ 1, 1, 0 };
+   static bool paused = false;
+   static std::vector<profile_event> frame_events;
+   static int64_t frame_begin_ns = 0;
+   static int64_t frame_end_ns = 1;
 
+   normal_imgui_window w(glm::ivec2{ 250, 0 }, glm::ivec2{ m_config.res_x - 750, 250 }, "Profiler");
+   ImGui::Checkbox("Pause", &paused);
+   ImGui::SameLine();
+   if (ImGui::Button("Export Chrome trace"))
+      std::ignore = write_chrome_trace("profile_trace.json");
+   tooltip("Writes profile_trace.json, open it in chrome://tracing or ui.perfetto.dev");
 
-   for (int i = 0; i < m_universe.m_systems.size(); ++i)
+   // The last finished frame and everything that ran during it on other threads
+   if (paused == false)
    {
-      m_star_props_ssbo.m_stars[i].position = m_universe.m_systems[i].get_position(m_position_mode);
+      std::vector<profile_event> events = get_profile_events(get_profile_time_ns() - 1'000'000'000);
+      const auto last_frame = std::ranges::find_if(std::rbegin(events), std::rend(events), [](const profile_event& event) {
+         return std::string_view(event.m_zone->m_name) == "draw_frame";
+      });
+      if (last_frame != std::rend(events))
+      {
+         frame_begin_ns = last_frame->m_begin_ns;
+         frame_end_ns = last_frame->m_end_ns;
+         std::erase_if(events, [&](const profile_event& event) {
+            return event.m_end_ns < frame_begin_ns || event.m_begin_ns > frame_end_ns;
+         });
+         frame_events = std::move(events);
+      }
    }
-   
+   ImGui::SameLine();
+   ImGui::Text(fmt::format("frame: {:.2f} ms", (frame_end_ns - frame_begin_ns) / 1e6).c_str());
+
+   // One band per thread, one row per nesting level
+   constexpr float row_height = 16.0f;
+   int max_depth = 0;
+   int max_thread_index = 0;
+   for (const profile_event& event : frame_events)
+   {
+      max_depth = std::max(max_depth, event.m_depth);
+      max_thread_index = std::max(max_thread_index, event.m_thread_index);
+   }
+   const float band_height = (max_depth + 1) * row_height + 4.0f;
+   const ImVec2 origin = ImGui::GetCursorScreenPos();
+   const float width = ImGui::GetContentRegionAvail().x;
+   const double ns_to_px = width / static_cast<double>(std::max<int64_t>(1, frame_end_ns - frame_begin_ns));
+   ImDrawList* draw_list = ImGui::GetWindowDrawList();
+   for (const profile_event& event : frame_events)
+   {
+      const float x0 = origin.x + static_cast<float>((std::max(event.m_begin_ns, frame_begin_ns) - frame_begin_ns) * ns_to_px);
+      const float x1 = origin.x + static_cast<float>((std::min(event.m_end_ns, frame_end_ns) - frame_begin_ns) * ns_to_px);
+      const float y0 = origin.y + event.m_thread_index * band_height + event.m_depth * row_height;
+      const ImVec2 min{ x0, y0 };
+      const ImVec2 max{ std::max(x1, x0 + 1.0f), y0 + row_height - 1.0f };
+      const float hue = static_cast<float>(std::hash<const void*>{}(event.m_zone) % 64) / 64.0f;
+      draw_list->AddRectFilled(min, max, ImColor::HSV(hue, 0.5f, 0.8f));
+      if (max.x - min.x > ImGui::CalcTextSize(event.m_zone->m_name).x + 4.0f)
+         draw_list->AddText(ImVec2(min.x + 2.0f, min.y), IM_COL32(0, 0, 0, 255), event.m_zone->m_name);
+      if (ImGui::IsMouseHoveringRect(min, max))
+         ImGui::SetTooltip("%s: %.1f us\n%s:%d", event.m_zone->m_name, (event.m_end_ns - event.m_begin_ns) / 1e3, event.m_zone->m_file, event.m_zone->m_line);
+   }
+   ImGui::Dummy(ImVec2(width, (max_thread_index + 1) * band_height));
+}
+
+
+auto engine::draw_frame_stats_overlay() -> void
+{
+   const frame_stats stats = m_frame_pacer.get_frame_stats();
+
+   normal_imgui_window w(glm::ivec2{ m_config.res_x - 500, 0 }, glm::ivec2{ 500, 250 }, "Frame stats");
+   if (ImGui::BeginTable("##frame_stats", 5))
+   {
+      const auto row = [](const char* label, const duration_percentiles& p) {
+         ImGui::TableNextColumn();
+         ImGui::Text(label);
+         for (const int64_t us : { p.m_p50, p.m_p95, p.m_p99, p.m_max })
+         {
+            ImGui::TableNextColumn();
+            ImGui::Text(fmt::format("{:.2f}", us / 1000.0).c_str());
+         }
+      };
+      for (const char* header : { "ms", "p50", "p95", "p99", "max" })
+         ImGui::TableSetupColumn(header);
+      ImGui::TableHeadersRow();
+      row("frame", stats.m_frame);
+      row("cpu", stats.m_cpu);
+      row("swap", stats.m_swap);
+      ImGui::EndTable();
+   }
+   tooltip("cpu is the work until the buffer swap, swap includes the vsync wait");
+
+   static float budget_ms = 1000.0f / 60.0f;
+   if (ImGui::SliderFloat("budget ms", &budget_ms, 4.0f, 50.0f))
+      m_frame_pacer.set_budget_us(static_cast<int64_t>(budget_ms * 1000.0f));
+   ImGui::Text(fmt::format(
+      "over budget: {} of last {}, {} of {} total",
+      stats.m_over_budget_in_window, stats.m_window_size, stats.m_over_budget_total, stats.m_frame_count
+   ).c_str());
+
+   std::vector<float> frame_ms;
+   for (const frame_sample& sample : m_frame_pacer.get_window())
+      frame_ms.push_back(sample.m_frame_us / 1000.0f);
+   ImGui::PlotLines("##frame_times", frame_ms.data(), static_cast<int>(std::ssize(frame_ms)), 0, nullptr, 0.0f, 2.0f * budget_ms, ImVec2(ImGui::GetContentRegionAvail().x, 50.0f));
+
+   if (ImGui::Button("Dump CSV"))
+      std::ignore = m_frame_pacer.write_csv("frame_times.csv");
+   tooltip("Writes the last frames to frame_times.csv");
+}
+
+
+auto engine::start_replay(const camera_path& path) -> void
+{
+   m_replay = replay_state{
+      .m_previous_camera_mode = m_camera_mode,
+      .m_selection = m_list_selection
+   };
+   m_replay->m_report.m_frames.reserve(path.get_frame_count());
+   m_camera_mode = replay_mode{ .m_path = std::make_shared<const camera_path>(path) };
+}
+
 
-   if (m_star_color_mode == star_color_mode::big_small)
+auto engine::update_replay() -> void
+{
+   const bool was_replay_frame = m_replay_frame != nullptr; // not the case in the frame the replay was started
+   m_replay_frame = nullptr;
+
+   // Keyframe every 10 frames, the replay interpolates between them
+   if (m_recorded_path.has_value())
    {
-      for (int i = 0; i < m_universe.m_systems.size(); ++i)
+      if (m_recorded_frame_count % 10 == 0)
       {
-         constexpr glm::vec3 red{ 1.0f, 0.5f, 0.5f };
-         constexpr glm::vec3 green{ 0.5f, 1.0f, 0.5f };
-         m_star_props_ssbo.m_stars[i].color = (m_universe.m_systems[i].m_size == system_size::small) ? red : green;
-         if (m_universe.m_systems[i].m_speculative)
-            m_star_props_ssbo.m_stars[i].color = speculative_color;
+         m_recorded_path->m_keyframes.push_back(camera_keyframe{
+            .m_frame = m_recorded_frame_count,
+            .m_pose = camera_pose{
+               .m_pos = get_camera_pos(m_universe, m_position_mode, m_camera_mode),
+               .m_target = get_camera_target(m_universe, m_position_mode, m_camera_mode)
+            }
+         });
       }
+      ++m_recorded_frame_count;
+   }
+
+   if (m_replay.has_value() == false || was_replay_frame == false)
+      return;
+
+   // Switching the camera in the GUI cancels the replay
+   if (std::holds_alternative<replay_mode>(m_camera_mode) == false)
+   {
+      m_replay.reset();
+      return;
+   }
+   replay_mode& mode = std::get<replay_mode>(m_camera_mode);
+   ++mode.m_frame;
+   if (mode.m_frame < mode.m_path->get_frame_count())
+      return;
+   m_camera_mode = m_replay->m_previous_camera_mode;
+   m_last_replay = std::move(m_replay->m_report);
+   m_replay.reset();
+   fmt::print("{}", get_replay_report_text(*m_last_replay));
+   std::ignore = write_replay_csv(*m_last_replay, "replay.csv");
+}
+
+
+auto engine::draw_replay_controls() -> void
+{
+   if (ImGui::CollapsingHeader("Camera replay") == false)
+      return;
+
+   if (m_replay.has_value())
+   {
+      const replay_mode& mode = std::get<replay_mode>(m_camera_mode);
+      ImGui::Text(fmt::format("Replaying frame {} of {}", mode.m_frame + 1, mode.m_path->get_frame_count()).c_str());
+      return;
+   }
+
+   if (ImGui::Button("Replay trailer"))
+      start_replay(get_trailer_path(m_universe.m_cam_info));
+   tooltip("Flies the reveal movement with fixed labels and selection and times the CPU side of every frame");
+   ImGui::SameLine();
+   if (ImGui::Button("Replay camera_path.txt"))
+   {
+      if (const std::optional<camera_path> path = read_camera_path("camera_path.txt"); path.has_value())
+         start_replay(*path);
    }
-   else if (m_star_color_mode == star_color_mode::abs_mag)
+   ImGui::SameLine();
+   if (m_recorded_path.has_value() == false)
    {
-      for (int i = 0; i < std::ssize(m_universe.m_systems); ++i)
+      if (ImGui::Button("Record"))
       {
-         constexpr glm::vec3 bright{ 1.0f };
-         constexpr glm::vec3 faint{ 0.5f };
-         m_star_props_ssbo.m_stars[i].color = (m_universe.m_systems[i].m_abs_mag < abs_threshold) ? bright : faint;
-         if (m_universe.m_systems[i].m_speculative)
-            m_star_props_ssbo.m_stars[i].color = speculative_color;
+         m_recorded_path.emplace();
+         m_recorded_frame_count = 0;
       }
+      tooltip("Records the camera until stopped, saved to camera_path.txt");
+   }
+   else if (ImGui::Button("Stop recording"))
+   {
+      std::ignore = write_camera_path(*m_recorded_path, "camera_path.txt");
+      m_recorded_path.reset();
+   }
+
+   if (m_last_replay.has_value())
+   {
+      ImGui::TextUnformatted(get_replay_report_text(*m_last_replay).c_str());
+      tooltip("Per frame timings are in replay.csv");
    }
 }
 
 
-auto engine::update_ssbo_bb() -> void
+auto engine::draw_candidate_search() -> void
 {
-   const std::vector<glm::vec3> x = get_bb_mesh(m_universe.m_map_bb, m_universe.m_trafo);
-   for (int i = 0; i < x.size()/2; ++i)
+   if (ImGui::CollapsingHeader("Speculative candidates") == false)
+      return;
+
+   enum class region_choice { unexplored, map, around_selection };
+   static region_choice region = region_choice::unexplored;
+   static float radius = 30.0f;
+   static catalog_query query{ .m_min_abs_mag = -5.0f, .m_max_abs_mag = 10.0f, .m_max_distance = 100.0f };
+   static int64_t query_us = 0;
+   static bool needs_query = true;
+
+   needs_query |= ImGui::Checkbox("Show in map", &m_show_candidates);
+   const auto region_radio = [&](const char* label, const region_choice choice) {
+      if (ImGui::RadioButton(label, region == choice))
+      {
+         region = choice;
+         needs_query = true;
+      }
+   };
+   region_radio("Unexplored box", region_choice::unexplored);
+   ImGui::SameLine();
+   region_radio("Map box", region_choice::map);
+   ImGui::SameLine();
+   region_radio("Around selected", region_choice::around_selection);
+   if (region == region_choice::around_selection)
+      needs_query |= ImGui::SliderFloat("radius", &radius, 1.0f, 100.0f);
+   needs_query |= ImGui::DragFloatRange2("abs mag", &query.m_min_abs_mag, &query.m_max_abs_mag, 0.1f, -10.0f, 20.0f);
+   tooltip("Absolute magnitude, lower is brighter");
+   needs_query |= ImGui::DragFloatRange2("distance", &query.m_min_distance, &query.m_max_distance, 0.5f, 0.0f, 500.0f);
+   tooltip("Distance band around Sol, in LY");
+   needs_query |= ImGui::SliderFloat("brightness weight", &query.m_weights.m_brightness, 0.0f, 2.0f);
+   needs_query |= ImGui::SliderFloat("closeness weight", &query.m_weights.m_closeness, 0.0f, 0.5f);
+   needs_query |= ImGui::SliderFloat("centrality weight", &query.m_weights.m_centrality, 0.0f, 0.5f);
+   needs_query |= ImGui::SliderInt("max results", &query.m_max_results, 1, 200);
+
+   // The selection moves the sphere
+   static int queried_selection = m_list_selection;
+   needs_query |= region == region_choice::around_selection && queried_selection != m_list_selection;
+
+   if (needs_query)
    {
-      const glm::vec3 p0 = x[2 * i];
-      const glm::vec3 p1 = x[2 * i + 1];
-      m_star_props_ssbo.bb_elements[i].trafo = get_obj_trafo_between_points(p0, p1, 0.1f);
+      if (region == region_choice::unexplored)
+         query.m_region = transformed_bb{ .m_bb = m_universe.m_left_bb, .m_trafo = m_universe.m_trafo };
+      else if (region == region_choice::map)
+         query.m_region = transformed_bb{ .m_bb = m_universe.m_map_bb, .m_trafo = m_universe.m_trafo };
+      else
+         query.m_region = sphere{ .m_center = m_universe.m_systems[m_list_selection].get_position(m_position_mode), .m_radius = radius };
+      query.m_band_center = m_universe.get_position_by_name("SOL", m_position_mode);
+
+      const auto t0 = std::chrono::high_resolution_clock::now();
+      m_candidates = m_universe.m_catalog.query(query);
+      const auto t1 = std::chrono::high_resolution_clock::now();
+      query_us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+      queried_selection = m_list_selection;
+      needs_query = false;
+   }
+
+   ImGui::TextDisabled(fmt::format("{} matches in {} us", m_candidates.m_match_count, query_us).c_str());
+   for (const catalog_candidate& candidate : m_candidates.m_candidates)
+   {
+      ImGui::Text(fmt::format(
+         "{}: abs mag {:.1f}, {:.1f} LY",
+         m_universe.m_catalog.m_names[candidate.m_star_index].get(), m_universe.m_catalog.m_abs_mag[candidate.m_star_index], candidate.m_distance
+      ).c_str());
    }
 }
 
 
-auto engine::draw_system_labels() const -> void
+auto engine::draw_candidate_overlay() const -> void
 {
-   const glm::vec3 cam_pos = this->get_camera_pos();
-   for (const system& system : m_universe.m_systems)
+   constexpr int labeled_count = 10;
+   const ImColor marker_color(1.0f, 0.5f, 1.0f, 0.8f);
+   for (int i = 0; i < std::ssize(m_candidates.m_candidates); ++i)
    {
-      if (system.get_useful_name().has_value() == false)
+      const glm::vec3 position = m_universe.m_catalog.get_position(m_candidates.m_candidates[i].m_star_index);
+      const std::optional<glm::vec2> screen_pos = get_screen_pos(position);
+      if (screen_pos.has_value() == false)
          continue;
+      ImGui::GetBackgroundDrawList()->AddCircle(ImVec2((*screen_pos)[0], (*screen_pos)[1]), 4.0f, marker_color);
 
-      const float distance_from_cam = glm::distance(cam_pos, system.get_position(m_position_mode));
-      const float pointsize = 500 / distance_from_cam;
-      const float planet_radius = 0.5f * pointsize;
-      const glm::vec2 offset{0, planet_radius + 8.0f };
-      constexpr float label_opacity = 0.8f;
-      constexpr glm::vec4 normal_color{ 1, 1, 1, label_opacity };
-      constexpr glm::vec4 speculation_color{ 1, 0.6, 0.95, label_opacity };
-      glm::vec4 color = system.get_starfield_name().has_value() ? normal_color : speculation_color;
-      if (system.m_speculative)
-         color = glm::vec4{1, 1, 0, 1};
-      this->draw_text(system.get_useful_name().value(), system.get_position(m_position_mode), offset, color);
+      // Best ones first, only those get names
+      if (i < labeled_count)
+         this->draw_text(m_universe.m_catalog.m_names[m_candidates.m_candidates[i].m_star_index].get(), position, glm::vec2{ 0, 12 }, glm::vec4{ 1.0f, 0.5f, 1.0f, 0.8f });
    }
 }
+
+
+auto engine::draw_frame_labels() const -> void
+{
+   SFN_PROFILE_ZONE("frame labels");
+   for (const frame_label& label : m_displayed_frame->m_labels)
+      this->draw_screen_text(label.m_text, label.m_screen_pos, label.m_center_offset, label.m_color);
+}
@@ -2,7 +2,17 @@
 
 #include "setup.h"
 #include "vertex_data.h"
+#include "async_job.h"
 #include "buffer.h"
+#include "camera_replay.h"
+#include "chokepoints.h"
+#include "frame_pipeline.h"
+#include "frame_scheduler.h"
+#include "gl_backend.h"
+#include "isochrone.h"
+#include "render_backend.h"
+#include "scene.h"
+#include "territory.h"
 #include "timing_provider.h"
 #include "universe.h"
 
@@ -10,63 +20,13 @@
 namespace sfn
 {
 
-   struct alignas(256) ubo_type {};
-
-   struct mvp_type : ubo_type
-   {
-      alignas(sizeof(glm::vec4)) glm::vec3 m_cam_pos;
-      alignas(sizeof(glm::vec4)) glm::vec3 m_selected_system_pos;
-      alignas(sizeof(glm::vec4)) glm::mat4 m_view{ 1.0f };
-      alignas(sizeof(glm::vec4)) glm::mat4 m_projection{ 1.0f };
-      int selected_index;
-   };
-
-   struct alignas(4 * sizeof(float)) star_prop_element{
-      alignas(sizeof(glm::vec4)) glm::vec3 position;
-      alignas(sizeof(glm::vec4)) glm::vec3 color;
-   };
-   struct alignas(4 * sizeof(float)) bb_element {
-      alignas(sizeof(glm::vec4)) glm::mat4 trafo;
-   };
-
-   struct star_props_ssbo : ubo_type
-   {
-      bb_element bb_elements[12];
-      alignas(sizeof(glm::vec4)) glm::mat4 connection_trafos[2048];
-      star_prop_element m_stars[256];
-      
-      [[nodiscard]] auto get_byte_count() const -> int
-      {
-         return sizeof(star_props_ssbo);
-      }
-   };
-
-   struct wasd_mode
-   {
-      glm::vec3 m_camera_pos{};
-   };
-   struct circle_mode
+   // Everything the replay holds fixed or restores afterwards
+   struct replay_state
    {
-      int m_planet;
-      float distance;
-      float horiz_angle_offset;
-      float vert_angle_offset;
+      camera_mode m_previous_camera_mode;
+      int m_selection;
+      replay_report m_report;
    };
-   struct galactic_circle_mode
-   {
-      int m_planet;
-      float distance;
-      float horiz_angle_offset;
-      float vert_angle_offset;
-   };
-   struct trailer_mode{
-      float m_progress = 0.0;
-   };
-
-   using camera_mode = std::variant<wasd_mode, circle_mode, galactic_circle_mode, trailer_mode>;
-
-   template<typename T>
-   concept centery = std::same_as<T, circle_mode> || std::same_as<T, galactic_circle_mode>;
 
    // struct connection_jumprange{ float value = 0.0f; };
    // struct jump_jumprange{ float value = 0.0f; };
@@ -93,14 +53,67 @@ namespace sfn
          return std::visit(visitor, *this);
       }
    };
-   enum class star_color_mode{big_small, abs_mag};
+   enum class route_mode { shortest, alternatives, pareto };
+
+   // Copied from the GUI when a graph job is submitted
+   struct route_request
+   {
+      int m_source_index = 0;
+      int m_destination_index = 0;
+      std::optional<float> m_jump_range; // the minimum range if empty
+      bool m_with_min_jump_range = false;
+      std::optional<route_mode> m_route_mode; // only the graph without one
+      int m_alternative_count = 0;
+      position_mode m_position_mode = position_mode::reconstructed;
+   };
+
+   struct route_result
+   {
+      route_request m_request;
+      graph m_graph;
+      std::optional<float> m_min_jump_range;
+      std::vector<std::pair<std::string, jump_path>> m_route_choices; // label and route
+      std::optional<jump_path> m_path;
+   };
+
+   // Territory and chokepoints of the displayed graph, computed in the background like the routes
+   struct analysis_request
+   {
+      float m_jump_range = 0.0f;
+      position_mode m_position_mode = position_mode::reconstructed;
+      bool m_with_territory = false;
+      bool m_with_chokepoints = false;
+
+      friend auto operator==(const analysis_request&, const analysis_request&) -> bool = default;
+   };
+
+   struct analysis_result
+   {
+      std::optional<faction_territory> m_territory;
+      std::optional<chokepoint_analysis> m_chokepoints;
+   };
+
+   enum class star_color_mode{big_small, abs_mag, reachability, factions, chokepoints};
+   enum class connection_display{all, faction_borders, chokepoints};
+
+   // Everything the system selector needs per row, formatted once
+   struct selector_row
+   {
+      std::string m_filter_str;
+      std::string m_index_str;
+      std::string m_sf_label;
+      std::string m_real_label;
+      std::string m_tooltip;
+      bool m_has_sf_name = false;
+      bool m_speculative = false;
+   };
 
-   struct ortho_params
+   struct system_selector
    {
-      float width = 50.0f;
+      std::vector<selector_row> m_rows;
+      std::vector<int> m_filtered_indices;
+      bool m_filter_dirty = true;
    };
-   struct perspective_params{};
-   using projection_params = std::variant<perspective_params, ortho_params>;
 
    struct mouse_mover {
       glm::vec2 m_pos{};
@@ -115,48 +128,59 @@ namespace sfn
    public:
       config m_config;
       timing_provider m_frame_pacer{};
+      frame_scheduler m_frame_scheduler;
       std::unique_ptr<graphics_context> m_graphics_context;
 
       universe m_universe;
       int m_list_selection = m_universe.get_index_by_name("SOL");
       int m_source_index = m_universe.get_index_by_name("SOL");
       int m_destination_index = m_universe.get_index_by_name("PORRIMA");
+      std::vector<int> m_waypoints;
       gui_mode m_gui_mode = connections_mode{};
       star_color_mode m_star_color_mode = star_color_mode::big_small;
       float m_dropline_range = 20.0f;
       bool m_show_star_labels = true;
       projection_params m_projection_params;
       bool m_show_bb = true;
-      int m_connection_trafo_count = 0;
       std::optional<mouse_mover> m_mouse_mover;
       float m_abs_mag_threshold = 0.0f;
+      isochrone_budget m_isochrone_budget;
+      isochrone m_isochrone;
+      faction_territory m_territory;
+      chokepoint_analysis m_chokepoints;
+      connection_display m_connection_display = connection_display::all;
+      bool m_show_candidates = false;
+      bool m_show_profiler = false;
+      bool m_show_frame_stats = false;
+      catalog_query_result m_candidates;
+      std::optional<replay_state> m_replay;
+      replay_frame* m_replay_frame = nullptr; // of the current frame while replaying
+      std::optional<replay_report> m_last_replay;
+      std::optional<camera_path> m_recorded_path;
+      int m_recorded_frame_count = 0;
       graph m_starfield_graph = get_graph_from_universe(m_universe, 20.0f);
+      async_job<route_result> m_graph_job;
+      std::optional<route_result> m_route_result; // for draw_jump_calculations() to pick up
+      std::optional<jump_path> m_displayed_path;
+      std::vector<std::string> m_path_strings;
+      std::vector<std::pair<std::string, jump_path>> m_route_choices; // label and route
+      int m_route_selection = 0;
+      float m_jump_slider_min = 0.0f;
+      float m_jump_slider_max = 100.0f;
+      bool m_min_range_outdated = true; // until a graph job brings the new one
+      async_job<analysis_result> m_analysis_job;
+      std::optional<analysis_request> m_submitted_analysis; // until its result is in
       position_mode m_position_mode = position_mode::reconstructed;
+      system_selector m_selector;
 
       camera_mode m_camera_mode = wasd_mode{ m_universe.m_cam_info.m_cam_pos0 };
-      buffers m_buffers2;
-      id m_mvp_ubo_id{ no_init{} };
-      id m_main_fb{ no_init{} };
-      id m_star_vbo_id{ no_init{} };
-      id m_jump_lines_vbo_id{ no_init{} };
-      id m_indicator_vbo_id{ no_init{} };
-      id m_cylinder_vbo_id{ no_init{} };
-      id m_star_ssbo_id{ no_init{} };
-      binding_point_man m_binding_point_man;
-      mvp_type m_current_mvp{};
-      star_props_ssbo m_star_props_ssbo;
-      shader_program m_shader_stars;
-      shader_program m_shader_lines;
-      shader_program m_shader_indicator;
-      shader_program m_shader_bb;
-      shader_program m_shader_connection;
-      texture_manager m_textures{};
-      framebuffer_manager m_framebuffers; // needs to be after texture manager
-      std::optional<vao> m_vao_stars;
-      std::optional<vao> m_vao_jump_lines;
-      std::optional<vao> m_vao_connection_lines;
-      std::optional<vao> m_vao_indicator;
-      std::optional<vao> m_vao_bb;
+      scene m_scene; // edited through edit_scene()
+      std::shared_ptr<const scene> m_scene_snapshot; // what the update thread reads
+      bool m_scene_dirty = true;
+      frame_pipeline m_frame_pipeline{ m_universe };
+      frame_description m_frame; // replays build in place, so their timings stay exact
+      const frame_description* m_displayed_frame = &m_frame;
+      gl_backend m_gl_backend;
 
       explicit engine(const config& config, std::unique_ptr<graphics_context>&& gc, universe&& universe);
       [[nodiscard]] auto get_window() const->GLFWwindow*;
@@ -164,6 +188,9 @@ namespace sfn
       static auto static_resize_callback(GLFWwindow* window, int new_width, int new_height) -> void;
       static auto static_scroll_callback(GLFWwindow* window, double xoffset, double yoffset) -> void;
       static auto static_mouse_button_callback(GLFWwindow* window, int button, int action, int mods) -> void;
+      static auto static_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) -> void;
+      static auto static_char_callback(GLFWwindow* window, unsigned int codepoint) -> void;
+      static auto static_cursor_pos_callback(GLFWwindow* window, double x, double y) -> void;
 
 
       
@@ -180,23 +207,38 @@ namespace sfn
       auto mouse_button_callback(GLFWwindow* window, int button, int action, int mods) -> void;
 
       auto draw_frame() -> void;
+      auto invalidate(const redraw_reason reason) -> void;
+      [[nodiscard]] auto needs_continuous_frames() const -> bool;
+      [[nodiscard]] auto get_animation_fps() const -> double;
       auto gui_draw() -> void;
       auto draw_list() -> bool;
+      auto update_selector_rows() -> void;
       auto draw_jump_calculations(const bool switched_into_tab) -> void;
-      auto bind_ubo(const std::string& name, const buffer& buffer_ref, const id segment_id, const shader_program& shader) const -> void;
-      auto bind_ssbo(const std::string& name, const buffer& buffer_ref, const id segment_id, const shader_program& shader) const -> void;
-      auto gpu_upload() const -> void;
-      auto update_mvp_member() -> void;
-      auto get_camera_pos() const -> glm::vec3;
-      [[nodiscard]] auto get_view_matrix(const camera_mode& mode) const -> glm::mat4;
-      [[nodiscard]] auto get_camera_target(const camera_mode& mode) const -> glm::vec3;
-      auto draw_system_labels() const -> void;
-      auto build_connection_mesh_from_graph(const graph& connection_graph) -> void;
+      auto set_displayed_path(const jump_path& path) -> void;
+      [[nodiscard]] auto get_camera_input(const float frame_duration) -> camera_input;
+      [[nodiscard]] auto get_frame_settings(const float steady_time) const -> frame_settings;
+      auto draw_frame_labels() const -> void;
+      auto draw_candidate_search() -> void;
+      auto draw_candidate_overlay() const -> void;
+      auto draw_profiler_overlay() -> void;
+      auto draw_frame_stats_overlay() -> void;
+      auto draw_replay_controls() -> void;
+      auto start_replay(const camera_path& path) -> void;
+      auto update_replay() -> void;
+      auto build_displayed_connection_mesh() -> void;
+      auto submit_graph_job(const route_request& request) -> void;
+      auto update_graph_job() -> void;
+      [[nodiscard]] auto edit_scene() -> scene&;
+      [[nodiscard]] auto get_scene_snapshot() -> std::shared_ptr<const scene>;
+      auto build_border_connection_mesh() -> void;
+      auto build_chokepoint_connection_mesh() -> void;
+      [[nodiscard]] auto get_analysis_request() const -> std::optional<analysis_request>;
+      auto update_analysis_job() -> void;
       auto build_neighbor_connection_mesh(const universe& universe, const int center_system) const -> std::vector<line_vertex_data>;
+      [[nodiscard]] auto get_screen_pos(const glm::vec3& pos) const -> std::optional<glm::vec2>;
       auto draw_text(const std::string& text, const glm::vec3& pos, const glm::vec2& center_offset, const glm::vec4& color) const -> void;
-      [[nodiscard]] auto get_cs() const -> cs;
-      auto update_ssbo_colors_and_positions(const float abs_threshold) -> void;
-      auto update_ssbo_bb() -> void;
+      auto draw_screen_text(const std::string& text, const glm::vec2& screen_pos, const glm::vec2& center_offset, const glm::vec4& color) const -> void;
+      auto update_star_instances(const float abs_threshold) -> void;
    };
 }
 
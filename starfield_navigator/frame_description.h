@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "mesh_lod.h"
+#include "vertex_data.h"
+
+#pragma warning(push, 0)
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#pragma warning(pop)
+
+
+namespace sfn
+{
+   struct alignas(4 * sizeof(float)) star_prop_element{
+      alignas(sizeof(glm::vec4)) glm::vec3 position;
+      alignas(sizeof(glm::vec4)) glm::vec3 color;
+   };
+
+   struct frame_label
+   {
+      std::string m_text;
+      glm::vec2 m_screen_pos;
+      glm::vec2 m_center_offset; // y goes up
+      glm::vec4 m_color;
+   };
+
+   // Everything a backend needs to draw a frame, as plain data. Built by build_frame() without GL or ImGui
+   struct frame_description
+   {
+      glm::ivec2 m_resolution{};
+      float m_steady_time = 0.0f;
+      glm::mat4 m_view{ 1.0f };
+      glm::mat4 m_projection{ 1.0f };
+      glm::vec3 m_cam_pos{};
+      glm::vec3 m_selected_system_pos{};
+      int m_selected_index = 0;                   // into m_stars, -1 if culled
+
+      std::vector<star_prop_element> m_stars;     // visible ones, sorted by LOD level
+      std::array<int, lod_count + 2> m_star_lod_offsets{}; // level l is [l, l+1), the last level are impostors
+      std::vector<glm::mat4> m_bb_trafos;         // empty if hidden
+      std::vector<glm::mat4> m_connection_trafos;
+      bool m_connections_write_depth = true;      // not while the route is shown through them
+      std::vector<line_vertex_data> m_jump_lines;
+      std::vector<position_vertex_data> m_indicator;
+      std::vector<frame_label> m_labels;          // in screen pixels
+   };
+}
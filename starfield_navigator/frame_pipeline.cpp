@@ -0,0 +1,65 @@
+#include "frame_pipeline.h"
+
+#include "profiler.h"
+
+
+sfn::frame_pipeline::frame_pipeline(const universe& univ)
+   : m_universe(univ)
+   , m_thread([this]() { update_loop(); })
+{
+
+}
+
+
+sfn::frame_pipeline::~frame_pipeline()
+{
+   m_stopping.store(true, std::memory_order_release);
+   m_request_count.fetch_add(1, std::memory_order_release);
+   m_request_count.notify_one();
+   m_thread.join();
+}
+
+
+auto sfn::frame_pipeline::request(
+   const frame_settings& settings,
+   std::shared_ptr<const scene> scene_snapshot
+) -> void
+{
+   frame_request& request = m_requests.get_back();
+   request.m_settings = settings;
+   request.m_scene = std::move(scene_snapshot);
+   m_requests.publish();
+   m_request_count.fetch_add(1, std::memory_order_release);
+   m_request_count.notify_one();
+}
+
+
+auto sfn::frame_pipeline::acquire() -> const frame_description&
+{
+   m_built_count.wait(0, std::memory_order_acquire);
+   m_frames.acquire();
+   return m_frames.get_front();
+}
+
+
+auto sfn::frame_pipeline::update_loop() -> void
+{
+   uint32_t seen_count = 0;
+   while (true)
+   {
+      m_request_count.wait(seen_count, std::memory_order_acquire);
+      seen_count = m_request_count.load(std::memory_order_acquire);
+      if (m_stopping.load(std::memory_order_acquire))
+         return;
+
+      // Requests that came in while the last frame was built are skipped, only the newest one counts
+      if (m_requests.acquire() == false)
+         continue;
+      SFN_PROFILE_ZONE("update frame");
+      const frame_request& request = m_requests.get_front();
+      build_frame(m_universe, *request.m_scene, request.m_settings, nullptr, m_frames.get_back());
+      m_frames.publish();
+      m_built_count.fetch_add(1, std::memory_order_release);
+      m_built_count.notify_one();
+   }
+}
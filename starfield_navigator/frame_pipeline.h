@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "frame_description.h"
+#include "scene.h"
+#include "universe.h"
+
+
+namespace sfn
+{
+   // Lock-free handoff between one writer and one reader thread. The writer fills its back slot and publishes it by
+   // swapping it with the middle one, the reader swaps its front slot with the middle one when that's fresh. Neither
+   // ever waits for the other, the reader just sees the newest published state
+   template<typename T>
+   struct triple_buffer
+   {
+      [[nodiscard]] auto get_back() -> T&;
+      auto publish() -> void;
+
+      // Takes the newest published slot. False if nothing was published since the last call
+      auto acquire() -> bool;
+      [[nodiscard]] auto get_front() const -> const T&;
+
+   private:
+      static constexpr inline uint8_t index_mask = 0b011;
+      static constexpr inline uint8_t fresh_bit = 0b100;
+
+      std::array<T, 3> m_slots{};
+      uint8_t m_back = 0;  // writer only
+      uint8_t m_front = 1; // reader only
+      std::atomic<uint8_t> m_middle = 2;
+   };
+
+   struct frame_request
+   {
+      frame_settings m_settings;
+      std::shared_ptr<const scene> m_scene; // never changed once shared
+   };
+
+   // Builds frames on an update thread while the caller draws the previous one. Frames arrive one request late
+   struct frame_pipeline
+   {
+      explicit frame_pipeline(const universe& univ);
+      ~frame_pipeline();
+      frame_pipeline(const frame_pipeline&) = delete;
+      frame_pipeline& operator=(const frame_pipeline&) = delete;
+
+      auto request(const frame_settings& settings, std::shared_ptr<const scene> scene_snapshot) -> void;
+
+      // Newest finished frame, valid until the next call. Only waits for the very first one
+      [[nodiscard]] auto acquire() -> const frame_description&;
+
+   private:
+      const universe& m_universe;
+      triple_buffer<frame_request> m_requests;
+      triple_buffer<frame_description> m_frames;
+      std::atomic<uint32_t> m_request_count = 0;
+      std::atomic<uint32_t> m_built_count = 0;
+      std::atomic<bool> m_stopping = false;
+      std::thread m_thread; // last, it uses everything above
+
+      auto update_loop() -> void;
+   };
+}
+
+
+template<typename T>
+auto sfn::triple_buffer<T>::get_back() -> T&
+{
+   return m_slots[m_back];
+}
+
+
+template<typename T>
+auto sfn::triple_buffer<T>::publish() -> void
+{
+   const uint8_t previous = m_middle.exchange(static_cast<uint8_t>(m_back | fresh_bit), std::memory_order_acq_rel);
+   m_back = previous & index_mask;
+}
+
+
+template<typename T>
+auto sfn::triple_buffer<T>::acquire() -> bool
+{
+   if ((m_middle.load(std::memory_order_relaxed) & fresh_bit) == 0)
+      return false;
+   const uint8_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+   m_front = previous & index_mask;
+   return true;
+}
+
+
+template<typename T>
+auto sfn::triple_buffer<T>::get_front() const -> const T&
+{
+   return m_slots[m_front];
+}
@@ -0,0 +1,39 @@
+#include "frame_scheduler.h"
+
+#include <algorithm>
+
+
+auto sfn::frame_scheduler::invalidate(
+   const redraw_reason reason,
+   const double now
+) -> void
+{
+   m_dirty_reasons |= reason;
+   m_last_invalidation_time = now;
+}
+
+
+auto sfn::frame_scheduler::decide(
+   const double now,
+   const double animation_fps
+) const -> frame_decision
+{
+   if (m_enabled == false || m_dirty_reasons != 0)
+      return frame_decision{ .m_draw = true };
+   if (now - m_last_invalidation_time < m_config.m_linger_seconds)
+      return frame_decision{ .m_draw = true };
+
+   if (animation_fps <= 0.0)
+      return frame_decision{ .m_draw = false, .m_wait_seconds = m_config.m_max_wait_seconds };
+   const double next_animation_time = m_last_draw_time + 1.0 / animation_fps;
+   if (now >= next_animation_time)
+      return frame_decision{ .m_draw = true };
+   return frame_decision{ .m_draw = false, .m_wait_seconds = std::min(next_animation_time - now, m_config.m_max_wait_seconds) };
+}
+
+
+auto sfn::frame_scheduler::mark_drawn(const double now) -> void
+{
+   m_dirty_reasons = 0;
+   m_last_draw_time = now;
+}
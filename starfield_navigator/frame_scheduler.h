@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+
+namespace sfn
+{
+   enum redraw_reason : uint8_t
+   {
+      redraw_input = 1 << 0,      // keys, mouse, scrolling, window events
+      redraw_camera = 1 << 1,     // the camera moves on its own or is being dragged
+      redraw_data = 1 << 2        // results arrived, buffers changed
+   };
+
+   struct frame_scheduler_config
+   {
+      double m_linger_seconds = 0.5; // full rate after the last invalidation, so ImGui hover and the like settle
+      double m_max_wait_seconds = 1.0;
+   };
+
+   struct frame_decision
+   {
+      bool m_draw = false;
+      double m_wait_seconds = 0.0; // how long to sleep in glfwWaitEventsTimeout() if not drawing
+   };
+
+   // Decides when the main loop draws. Invalidations draw at full rate, otherwise animations are advanced at the rate
+   // they need (0 if there are none) and the loop sleeps in between. Times are in seconds from any steady clock, so
+   // this runs without a window
+   struct frame_scheduler
+   {
+      frame_scheduler_config m_config;
+      uint8_t m_dirty_reasons = 0; // since the last draw
+      double m_last_invalidation_time = -std::numeric_limits<double>::infinity();
+      double m_last_draw_time = -std::numeric_limits<double>::infinity();
+      bool m_enabled = true;
+
+      auto invalidate(const redraw_reason reason, const double now) -> void;
+      [[nodiscard]] auto decide(const double now, const double animation_fps) const -> frame_decision;
+      auto mark_drawn(const double now) -> void;
+   };
+}
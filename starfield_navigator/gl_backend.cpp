@@ -0,0 +1,235 @@
+#include "gl_backend.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "mesh_lod.h"
+#include "profiler.h"
+#include "render_backend.h"
+
+
+static_assert(sfn::render_backend<sfn::gl_backend>);
+
+
+namespace
+{
+   using namespace sfn;
+
+   const lod_meshes sphere_lods = get_sphere_lods();
+   const std::vector<position_vertex_data> cylinder_mesh = get_cylinder(16);
+
+   constexpr int max_jump_line_vertices = 100 * 100;
+   constexpr int max_indicator_vertices = 128;
+   constexpr int max_bb_instances = std::extent_v<decltype(star_props_ssbo::bb_elements)>;
+   constexpr int max_connection_instances = std::extent_v<decltype(star_props_ssbo::connection_trafos)>;
+   constexpr int max_star_instances = std::extent_v<decltype(star_props_ssbo::m_stars)>;
+
+
+   // What fits into the buffer, the rest is dropped
+   template<typename T>
+   [[nodiscard]] auto get_capped(const std::vector<T>& vec, const int capacity) -> std::span<const T>
+   {
+      return std::span{ vec }.first(std::min<size_t>(vec.size(), capacity));
+   }
+} // namespace {}
+
+
+sfn::gl_backend::gl_backend()
+   : m_buffers(128)
+   , m_shader_stars("star_shader")
+   , m_shader_star_impostors("star_impostor_shader")
+   , m_shader_lines("line_shader")
+   , m_shader_indicator("indicator_shader")
+   , m_shader_bb("bb_shader")
+   , m_shader_connection("connection_shader")
+   , m_framebuffers(m_textures)
+{
+   std::vector<segment_type> buffer_layout;
+   buffer_layout.emplace_back(ubo_segment(sizeof(mvp_type), "ubo_mvp"));
+
+   buffer_layout.emplace_back(get_soa_vbo_segment(sphere_lods.m_vertices));
+   buffer_layout.emplace_back(get_soa_vbo_segment<line_vertex_data>(max_jump_line_vertices));
+   buffer_layout.emplace_back(get_soa_vbo_segment<position_vertex_data>(max_indicator_vertices));
+   buffer_layout.emplace_back(ssbo_segment(sizeof(star_props_ssbo), "star_ssbo"));
+   buffer_layout.emplace_back(get_soa_vbo_segment(cylinder_mesh));
+   const std::vector<id> segment_ids = m_buffers.create_buffer(std::move(buffer_layout), usage_pattern::dynamic_draw);
+   m_mvp_ubo_id = segment_ids[0];
+   m_star_vbo_id = segment_ids[1];
+   m_jump_lines_vbo_id = segment_ids[2];
+   m_indicator_vbo_id = segment_ids[3];
+   m_star_ssbo_id = segment_ids[4];
+   m_cylinder_vbo_id = segment_ids[5];
+
+   // The meshes never change, everything else goes up every frame in upload()
+   m_buffers.upload_vbo(m_star_vbo_id, as_bytes(sphere_lods.m_vertices));
+   m_buffers.upload_vbo(m_cylinder_vbo_id, as_bytes(cylinder_mesh));
+
+   m_binding_point_man.add(m_mvp_ubo_id);
+   m_binding_point_man.add(m_star_ssbo_id);
+   m_main_fb = m_framebuffers.get_efault_fb();
+
+   const buffer& buffer_ref = m_buffers.get_single_buffer_ref();
+   bind_ubo("ubo_mvp", buffer_ref, m_mvp_ubo_id, m_shader_stars);
+   bind_ubo("ubo_mvp", buffer_ref, m_mvp_ubo_id, m_shader_star_impostors);
+   bind_ubo("ubo_mvp", buffer_ref, m_mvp_ubo_id, m_shader_lines);
+   bind_ubo("ubo_mvp", buffer_ref, m_mvp_ubo_id, m_shader_connection);
+   bind_ssbo("star_ssbo", buffer_ref, m_star_ssbo_id, m_shader_stars);
+   bind_ssbo("star_ssbo", buffer_ref, m_star_ssbo_id, m_shader_star_impostors);
+   bind_ssbo("star_ssbo", buffer_ref, m_star_ssbo_id, m_shader_connection);
+   bind_ssbo("star_ssbo", buffer_ref, m_star_ssbo_id, m_shader_bb);
+
+   m_vao_stars.emplace(m_buffers, m_star_vbo_id, m_shader_stars);
+   m_vao_jump_lines.emplace(m_buffers, m_jump_lines_vbo_id, m_shader_lines);
+   m_vao_connection_lines.emplace(m_buffers, m_cylinder_vbo_id, m_shader_connection);
+   m_vao_indicator.emplace(m_buffers, m_indicator_vbo_id, m_shader_indicator);
+   m_vao_bb.emplace(m_buffers, m_cylinder_vbo_id, m_shader_bb);
+   m_vao_impostors.emplace();
+}
+
+
+auto sfn::gl_backend::upload(const frame_description& frame) const -> void
+{
+   SFN_PROFILE_ZONE("gpu upload");
+   mvp_type mvp{};
+   mvp.m_cam_pos = frame.m_cam_pos;
+   mvp.m_selected_system_pos = frame.m_selected_system_pos;
+   mvp.m_view = frame.m_view;
+   mvp.m_projection = frame.m_projection;
+   mvp.selected_index = frame.m_selected_index;
+   m_buffers.upload_ubo(m_mvp_ubo_id, as_bytes(mvp));
+   m_buffers.upload_vbo(m_jump_lines_vbo_id, std::as_bytes(get_capped(frame.m_jump_lines, max_jump_line_vertices)));
+   m_buffers.upload_vbo(m_indicator_vbo_id, std::as_bytes(get_capped(frame.m_indicator, max_indicator_vertices)));
+
+   // Only the used parts of the SSBO
+   m_buffers.upload_ssbo(m_star_ssbo_id, std::as_bytes(get_capped(frame.m_bb_trafos, max_bb_instances)), offsetof(star_props_ssbo, bb_elements));
+   m_buffers.upload_ssbo(m_star_ssbo_id, std::as_bytes(get_capped(frame.m_connection_trafos, max_connection_instances)), offsetof(star_props_ssbo, connection_trafos));
+   m_buffers.upload_ssbo(m_star_ssbo_id, std::as_bytes(get_capped(frame.m_stars, max_star_instances)), offsetof(star_props_ssbo, m_stars));
+}
+
+
+auto sfn::gl_backend::draw(const frame_description& frame) -> void
+{
+   SFN_PROFILE_ZONE("gl draw");
+   m_framebuffers.bind_fb(m_main_fb, fb_target::full);
+   m_framebuffers.clear_depth(m_main_fb);
+   constexpr glm::vec3 bg_color{};
+   m_framebuffers.clear_color(m_main_fb, bg_color, 0);
+
+   const auto bb_count = static_cast<GLsizei>(std::ssize(get_capped(frame.m_bb_trafos, max_bb_instances)));
+   const auto connection_count = static_cast<GLsizei>(std::ssize(get_capped(frame.m_connection_trafos, max_connection_instances)));
+   const auto jump_line_count = static_cast<GLsizei>(std::ssize(get_capped(frame.m_jump_lines, max_jump_line_vertices)));
+   const auto indicator_count = static_cast<GLsizei>(std::ssize(get_capped(frame.m_indicator, max_indicator_vertices)));
+
+   glEnable(GL_DEPTH_CLAMP);
+   if (bb_count > 0)
+   {
+      m_vao_bb->bind();
+      m_shader_bb.use();
+      m_shader_bb.set_uniform("time", frame.m_steady_time);
+      glDisable(GL_DEPTH_TEST);
+      glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<GLsizei>(cylinder_mesh.size()), bb_count);
+      glEnable(GL_DEPTH_TEST);
+   }
+
+   m_vao_connection_lines->bind();
+   m_shader_connection.use();
+   glDepthMask(frame.m_connections_write_depth);
+   glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<GLsizei>(cylinder_mesh.size()), connection_count);
+   glDepthMask(true);
+
+   if (jump_line_count > 0)
+   {
+      m_vao_jump_lines->bind();
+      m_shader_lines.use();
+      m_shader_lines.set_uniform("time", frame.m_steady_time);
+      glDrawArrays(GL_LINES, 0, jump_line_count);
+   }
+
+   if (indicator_count > 0)
+   {
+      m_vao_indicator->bind();
+      m_shader_indicator.use();
+      glDisable(GL_DEPTH_TEST);
+      glDrawArrays(GL_LINES, 0, indicator_count);
+      glEnable(GL_DEPTH_TEST);
+   }
+
+   // One instanced draw per mesh level, the instances of a level are consecutive in the SSBO
+   const auto get_level_range = [&](const int level) {
+      const int begin = std::min(frame.m_star_lod_offsets[level], max_star_instances);
+      const int end = std::min(frame.m_star_lod_offsets[level + 1], max_star_instances);
+      return std::pair{ begin, end - begin };
+   };
+   m_vao_stars->bind();
+   m_shader_stars.use();
+   m_shader_stars.set_uniform("time", frame.m_steady_time);
+   glEnable(GL_DEPTH_TEST);
+   glDepthMask(true);
+   for (int level = 0; level < lod_count; ++level)
+   {
+      const auto [offset, count] = get_level_range(level);
+      if (count == 0)
+         continue;
+      m_shader_stars.set_uniform("instance_offset", offset);
+      glDrawArraysInstanced(GL_TRIANGLES, sphere_lods.m_first[level], sphere_lods.m_count[level], count);
+   }
+
+   // The rest are only a few pixels big, points do
+   const auto [impostor_offset, impostor_count] = get_level_range(impostor_level);
+   if (impostor_count > 0)
+   {
+      m_vao_impostors->bind();
+      m_shader_star_impostors.use();
+      m_shader_star_impostors.set_uniform("time", frame.m_steady_time);
+      m_shader_star_impostors.set_uniform("instance_offset", impostor_offset);
+      m_shader_star_impostors.set_uniform("pixels_per_unit", 0.5f * frame.m_projection[1][1] * frame.m_resolution.y);
+      glEnable(GL_PROGRAM_POINT_SIZE);
+      glDrawArrays(GL_POINTS, 0, impostor_count);
+      glDisable(GL_PROGRAM_POINT_SIZE);
+   }
+}
+
+
+auto sfn::gl_backend::set_viewport(const int width, const int height) const -> void
+{
+   glViewport(0, 0, width, height);
+}
+
+
+auto sfn::gl_backend::bind_ubo(
+   const std::string& name,
+   const buffer& buffer_ref,
+   const id segment_id,
+   const shader_program& shader
+) const -> void
+{
+   const GLuint block_index = glGetUniformBlockIndex(shader.m_opengl_id, name.c_str());
+   const int binding_point = m_binding_point_man.get_point(segment_id);
+   glUniformBlockBinding(shader.m_opengl_id, block_index, binding_point);
+   glBindBufferBase(GL_UNIFORM_BUFFER, binding_point, buffer_ref.m_buffer_opengl_id);
+
+   const auto segment_size = buffer_ref.get_segment_size(segment_id);
+   const auto offset_in_buffer = buffer_ref.get_segment_offset(segment_id);
+   glBindBufferRange(GL_UNIFORM_BUFFER, binding_point, buffer_ref.m_buffer_opengl_id, offset_in_buffer, segment_size);
+}
+
+
+auto sfn::gl_backend::bind_ssbo(
+   const std::string& name,
+   const buffer& buffer_ref,
+   const id segment_id,
+   const shader_program& shader
+) const -> void
+{
+   const GLuint block_index = glGetProgramResourceIndex(shader.m_opengl_id, GL_SHADER_STORAGE_BLOCK, name.c_str());
+
+   const int binding_point = m_binding_point_man.get_point(segment_id);
+   glShaderStorageBlockBinding(shader.m_opengl_id, block_index, binding_point);
+   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding_point, buffer_ref.m_buffer_opengl_id);
+
+   const auto segment_size = buffer_ref.get_segment_size(segment_id);
+   const auto offset_in_buffer = buffer_ref.get_segment_offset(segment_id);
+   glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding_point, buffer_ref.m_buffer_opengl_id, offset_in_buffer, segment_size);
+}
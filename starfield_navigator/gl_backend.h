@@ -0,0 +1,84 @@
+#pragma once
+
+#include <optional>
+
+#include "buffer.h"
+#include "frame_description.h"
+#include "framebuffers.h"
+#include "vertex_data.h"
+
+
+namespace sfn
+{
+
+   struct alignas(256) ubo_type {};
+
+   struct mvp_type : ubo_type
+   {
+      alignas(sizeof(glm::vec4)) glm::vec3 m_cam_pos;
+      alignas(sizeof(glm::vec4)) glm::vec3 m_selected_system_pos;
+      alignas(sizeof(glm::vec4)) glm::mat4 m_view{ 1.0f };
+      alignas(sizeof(glm::vec4)) glm::mat4 m_projection{ 1.0f };
+      int selected_index;
+   };
+
+   struct alignas(4 * sizeof(float)) bb_element {
+      alignas(sizeof(glm::vec4)) glm::mat4 trafo;
+   };
+
+   // Layout of the star SSBO, the frame's instance arrays go into it in parts
+   struct star_props_ssbo : ubo_type
+   {
+      bb_element bb_elements[12];
+      alignas(sizeof(glm::vec4)) glm::mat4 connection_trafos[2048];
+      star_prop_element m_stars[256];
+
+      [[nodiscard]] auto get_byte_count() const -> int
+      {
+         return sizeof(star_props_ssbo);
+      }
+   };
+
+   // Draws frame descriptions with OpenGL, needs a current context
+   struct gl_backend
+   {
+      buffers m_buffers;
+      id m_mvp_ubo_id{ no_init{} };
+      id m_main_fb{ no_init{} };
+      id m_star_vbo_id{ no_init{} };
+      id m_jump_lines_vbo_id{ no_init{} };
+      id m_indicator_vbo_id{ no_init{} };
+      id m_cylinder_vbo_id{ no_init{} };
+      id m_star_ssbo_id{ no_init{} };
+      binding_point_man m_binding_point_man;
+      shader_program m_shader_stars;
+      shader_program m_shader_star_impostors; // for the stars too small for a mesh
+      shader_program m_shader_lines;
+      shader_program m_shader_indicator;
+      shader_program m_shader_bb;
+      shader_program m_shader_connection;
+      texture_manager m_textures{};
+      framebuffer_manager m_framebuffers; // needs to be after texture manager
+      std::optional<vao> m_vao_stars;
+      std::optional<vao> m_vao_jump_lines;
+      std::optional<vao> m_vao_connection_lines;
+      std::optional<vao> m_vao_indicator;
+      std::optional<vao> m_vao_bb;
+      std::optional<vao> m_vao_impostors; // no attributes, the star positions come from the SSBO
+
+      explicit gl_backend();
+
+      auto upload(const frame_description& frame) const -> void;
+      auto draw(const frame_description& frame) -> void;
+      auto set_viewport(const int width, const int height) const -> void;
+
+      gl_backend(const gl_backend&) = delete;
+      gl_backend& operator=(const gl_backend&) = delete;
+      gl_backend(gl_backend&&) = delete;
+      gl_backend& operator=(gl_backend&&) = delete;
+
+   private:
+      auto bind_ubo(const std::string& name, const buffer& buffer_ref, const id segment_id, const shader_program& shader) const -> void;
+      auto bind_ssbo(const std::string& name, const buffer& buffer_ref, const id segment_id, const shader_program& shader) const -> void;
+   };
+}
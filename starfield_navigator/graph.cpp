@@ -3,9 +3,31 @@
 #include "tools.h"
 
 #include <algorithm>
-#include <execution>
 
 
+sfn::node::node(const int index, const allocator_type& alloc)
+   : m_index(index)
+   , m_neighbor_nodes(alloc)
+{
+
+}
+
+
+sfn::node::node(const node& other, const allocator_type& alloc)
+   : m_index(other.m_index)
+   , m_neighbor_nodes(other.m_neighbor_nodes, alloc)
+{
+
+}
+
+
+sfn::node::node(node&& other, const allocator_type& alloc)
+   : m_index(other.m_index)
+   , m_neighbor_nodes(std::move(other.m_neighbor_nodes), alloc)
+{
+
+}
+
 
 auto sfn::connection::contains_node_index(const int node_index) const -> bool
 {
@@ -28,9 +50,13 @@ auto sfn::operator==(const shortest_path& a, const shortest_path& b) -> bool
 }
 
 
-sfn::shortest_path_tree::shortest_path_tree(const int source_node_index, const int node_count)
+sfn::shortest_path_tree::shortest_path_tree(
+   const int source_node_index,
+   const int node_count,
+   std::pmr::memory_resource* resource
+)
    : m_source_node_index(source_node_index)
-   , m_entries(node_count)
+   , m_entries(node_count, resource)
 {
    m_entries[source_node_index].m_shortest_distance = 0;
 }
@@ -58,15 +84,10 @@ auto sfn::jump_path::contains_connection(const connection& con) const -> bool
 }
 
 
-auto sfn::graph::are_neighbors(const int node_index_0, const int node_index_1) const -> bool
+sfn::graph::graph(std::pmr::memory_resource* resource)
+   : m_nodes(resource)
+   , m_connections(resource)
+   , m_sorted_connections(resource)
 {
-   if (node_index_0 == node_index_1)
-      return false;
 
-   const auto pred = [&](const int node_index)
-   {
-      return node_index == node_index_1;
-   };
-   return std::ranges::any_of(m_nodes[node_index_0].m_neighbor_nodes, pred);
 }
-
@@ -1,18 +1,31 @@
 #pragma once
 
+#include <memory_resource>
 #include <string>
 #include <vector>
 #include <optional>
+#include <queue>
 #include <unordered_map>
 
+#include "profiler.h"
 #include "tools.h"
 
 
 namespace sfn {
 
+   // Graphs, trees and paths take a memory resource so queries can run out of an arena (see arena.h)
    struct node{
+      using allocator_type = std::pmr::polymorphic_allocator<>;
+
       int m_index;
-      std::vector<int> m_neighbor_nodes;
+      std::pmr::vector<int> m_neighbor_nodes;
+
+      explicit node(const int index, const allocator_type& alloc = {});
+      node(const node& other, const allocator_type& alloc = {});
+      node(node&& other) noexcept = default;
+      node(node&& other, const allocator_type& alloc);
+      node& operator=(const node&) = default;
+      node& operator=(node&&) = default;
    };
 
    struct connection{
@@ -34,14 +47,14 @@ namespace sfn {
 
    struct shortest_path_tree{
       int m_source_node_index;
-      std::vector<shortest_path> m_entries;
+      std::pmr::vector<shortest_path> m_entries;
 
-      explicit shortest_path_tree(const int source_node_index, const int node_count);
+      explicit shortest_path_tree(const int source_node_index, const int node_count, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
       [[nodiscard]] auto get_distance_from_source(const int node_index) const -> float;
    };
 
    struct jump_path{
-      std::vector<int> m_stops;
+      std::pmr::vector<int> m_stops;
 
       [[nodiscard]] auto contains_connection(const connection& con) const -> bool;
    };
@@ -49,20 +62,18 @@ namespace sfn {
    struct graph
    {
       float m_jump_range = 0.0f;
-      std::vector<node> m_nodes;
-      std::unordered_map<id, connection, id_hash_callable> m_connections;
-      std::vector<id> m_sorted_connections;
+      std::pmr::vector<node> m_nodes;
+      std::pmr::unordered_map<id, connection, id_hash_callable> m_connections;
+      std::pmr::vector<id> m_sorted_connections;
 
-      explicit graph() = default;
+      explicit graph(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
+      // Result and scratch memory both come from the resource
       template<typename T>
-      [[nodiscard]] auto get_dijkstra(const int source_node_index, const T& weight_getter) const -> shortest_path_tree;
+      [[nodiscard]] auto get_dijkstra(const int source_node_index, const T& weight_getter, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const -> shortest_path_tree;
 
       template<typename T>
-      [[nodiscard]] auto get_jump_path(const int start_index, const int destination_index, const T& weight_getter) const -> std::optional<jump_path>;
-
-   private:
-      [[nodiscard]] auto are_neighbors(const int node_index_0, const int node_index_1) const -> bool;
+      [[nodiscard]] auto get_jump_path(const int start_index, const int destination_index, const T& weight_getter, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const -> std::optional<jump_path>;
    };
 }
 
@@ -70,56 +81,34 @@ namespace sfn {
 template<typename T>
 [[nodiscard]] auto sfn::graph::get_dijkstra(
    const int source_node_index,
-   const T& weight_getter
+   const T& weight_getter,
+   std::pmr::memory_resource* resource
 ) const -> shortest_path_tree
 {
-   shortest_path_tree tree(source_node_index, static_cast<int>(std::ssize(m_nodes)));
-
-   std::vector<int> visited;
-   visited.reserve(std::ssize(m_nodes));
-   std::vector<int> unvisited;
-   unvisited.reserve(std::ssize(m_nodes));
-   for (int i = 0; i < std::ssize(m_nodes); ++i)
-      unvisited.push_back(i);
-
-   int current_vertex = source_node_index;
-
-   while (unvisited.empty() == false)
+   SFN_PROFILE_ZONE("dijkstra");
+   shortest_path_tree tree(source_node_index, static_cast<int>(std::ssize(m_nodes)), resource);
+
+   // Binary heap with lazy deletion, stale entries are skipped when popped
+   using entry = std::pair<float, int>;
+   std::priority_queue<entry, std::pmr::vector<entry>, std::greater<>> queue{ std::greater<>{}, std::pmr::vector<entry>(resource) };
+   queue.emplace(0.0f, source_node_index);
+   while (queue.empty() == false)
    {
-      std::vector<int> current_vertex_neighbors;
-      current_vertex_neighbors.reserve(10);
-      for (int i = 0; i < std::ssize(m_nodes); ++i)
-      {
-         if (this->are_neighbors(current_vertex, i) == false)
-            continue;
-         if (std::ranges::find(visited, i) != visited.cend())
-            continue;
-         current_vertex_neighbors.push_back(i);
-      }
+      const auto [distance, current_vertex] = queue.top();
+      queue.pop();
+      if (distance > tree.get_distance_from_source(current_vertex))
+         continue;
 
-      for (const int neighbor : current_vertex_neighbors)
+      for (const int neighbor : m_nodes[current_vertex].m_neighbor_nodes)
       {
-         const float weight = tree.get_distance_from_source(current_vertex) + weight_getter(current_vertex, neighbor);
+         const float weight = distance + weight_getter(current_vertex, neighbor);
          if (weight < tree.m_entries[neighbor].m_shortest_distance)
          {
             tree.m_entries[neighbor].m_shortest_distance = weight;
             tree.m_entries[neighbor].m_previous_vertex_index = current_vertex;
+            queue.emplace(weight, neighbor);
          }
       }
-
-      visited.push_back(current_vertex);
-      std::erase(unvisited, current_vertex);
-
-      if (unvisited.empty())
-         break;
-
-      // sort unvisited
-      const auto pred = [&](const int a, const int b) {
-         return tree.get_distance_from_source(a) < tree.get_distance_from_source(b);
-      };
-      std::ranges::sort(unvisited, pred);
-
-      current_vertex = unvisited.front();
    }
 
    return tree;
@@ -130,12 +119,13 @@ template<typename T>
 [[nodiscard]] auto sfn::graph::get_jump_path(
    const int start_index,
    const int destination_index,
-   const T& weight_getter
+   const T& weight_getter,
+   std::pmr::memory_resource* resource
 ) const -> std::optional<jump_path>
 {
-   const shortest_path_tree tree = this->get_dijkstra(start_index, weight_getter);
+   const shortest_path_tree tree = this->get_dijkstra(start_index, weight_getter, resource);
 
-   jump_path result;
+   jump_path result{ .m_stops = std::pmr::vector<int>(resource) };
    result.m_stops.reserve(10);
    std::optional<int> position = destination_index;
 
@@ -0,0 +1,387 @@
+#include "headless.h"
+
+#include "benchmark.h"
+#include "camera_replay.h"
+#include "chokepoints.h"
+#include "graph.h"
+#include "itinerary.h"
+#include "k_shortest_paths.h"
+#include "route_cache.h"
+#include "universe.h"
+#include "universe_creation.h"
+
+#include <numeric>
+
+#pragma warning(push, 0)
+#include <fmt/format.h>
+#pragma warning(pop)
+
+
+namespace
+{
+   using namespace sfn;
+
+
+   [[nodiscard]] auto get_aligned_universe() -> universe
+   {
+      universe_creator creator;
+      creator_result result = 0.0f;
+      while (std::holds_alternative<float>(result))
+         result = creator.get();
+      return std::get<universe>(std::move(result));
+   }
+
+
+   auto print_usage() -> void
+   {
+      fmt::print(
+         "usage:\n"
+         "  --find <name>                      prefix/fuzzy search over system names\n"
+         "  --route <from> <to> [range]        jump route, minimum jump range by default\n"
+         "  --routes <from> <to> <k> [range]   k shortest loopless routes\n"
+         "  --itinerary <range> <systems...>   visit all systems, starting at the first\n"
+         "  --chokepoints <range> [systems]    betweenness, articulation points and bridges,\n"
+         "                                     on a synthetic universe if systems is given\n"
+         "  --replay [systems] [--path <file>] [--csv <file>]\n"
+         "                                     CPU side of the frames along a camera path, the\n"
+         "                                     trailer movement by default\n"
+         "  --benchmark layout [systems]       all-pairs distances, AoS vs SoA\n"
+         "  --benchmark kernels [systems]      SIMD distance kernels, checked against glm\n"
+         "  --benchmark threads [systems]      thread pool scaling\n"
+         "  --benchmark arena [systems]        min jump queries, heap allocations after warmup\n"
+         "  --benchmark dijkstra [systems]     shortest path trees, checked against a reference\n"
+         "  --benchmark catalog [stars]        catalog region and attribute queries\n"
+         "  --benchmark scheduler              frame scheduler decisions on simulated timelines\n"
+         "  --benchmark lod [stars]            star LOD levels and bucketing, checked against glm\n"
+         "  --benchmark suite [systems] [--filter <text>] [--json <path>]\n"
+         "                                     graph, routing, alignment and loading hot paths\n"
+      );
+   }
+
+
+   [[nodiscard]] auto run_find(const universe& univ, const std::string& query) -> int
+   {
+      const auto t0 = std::chrono::high_resolution_clock::now();
+      const std::vector<name_match> matches = univ.m_name_index.search(query, 10);
+      const auto t1 = std::chrono::high_resolution_clock::now();
+
+      for (const name_match& match : matches)
+      {
+         const sfn::system& sys = univ.m_systems[match.m_system_index];
+         fmt::print("{:>4}: {} (distance {})\n", match.m_system_index, sys.get_name(), match.m_distance);
+      }
+      const auto us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+      fmt::print("{} matches in {} us\n", matches.size(), us);
+      return matches.empty() ? 1 : 0;
+   }
+
+
+   [[nodiscard]] auto find_system(const universe& univ, const std::string& name) -> std::optional<int>
+   {
+      const std::vector<name_match> matches = univ.m_name_index.search(name, 1);
+      if (matches.empty())
+      {
+         fmt::print("system \"{}\" not found\n", name);
+         return std::nullopt;
+      }
+      return matches.front().m_system_index;
+   }
+
+
+   auto print_path(const universe& univ, const jump_path& path, const position_mode mode) -> void
+   {
+      for (int i = 0; i < std::ssize(path.m_stops) - 1; ++i)
+      {
+         const int this_stop = path.m_stops[i];
+         const int next_stop = path.m_stops[i + 1];
+         fmt::print(
+            "Jump {}: {} to {}. Distance: {:.1f} LY\n",
+            i + 1, univ.m_systems[this_stop].get_name(), univ.m_systems[next_stop].get_name(), univ.get_distance(this_stop, next_stop, mode)
+         );
+      }
+   }
+
+
+   [[nodiscard]] auto run_route(
+      const universe& univ,
+      const std::string& from,
+      const std::string& to,
+      const std::optional<float>& jump_range
+   ) -> int
+   {
+      const std::optional<int> source_index = find_system(univ, from);
+      const std::optional<int> destination_index = find_system(univ, to);
+      if (source_index.has_value() == false || destination_index.has_value() == false)
+         return 1;
+
+      constexpr position_mode mode = position_mode::reconstructed;
+      route_cache& cache = get_route_cache();
+      const float min_jump_range = cache.get_min_jump_dist(univ, *source_index, *destination_index, mode);
+      const float range = jump_range.value_or(min_jump_range + 0.001f);
+      fmt::print(
+         "{} to {}: minimum jump range {:.2f} LY, using {:.2f} LY\n",
+         univ.m_systems[*source_index].get_name(), univ.m_systems[*destination_index].get_name(), min_jump_range, range
+      );
+
+      const std::optional<jump_path> path = cache.get_route(univ, *source_index, *destination_index, range, mode);
+      if (path.has_value() == false)
+      {
+         fmt::print("Jump range not large enough\n");
+         return 1;
+      }
+      print_path(univ, *path, mode);
+
+      const cache_stats min_jump_stats = cache.get_min_jump_stats();
+      const cache_stats route_stats = cache.get_route_stats();
+      fmt::print(
+         "cache hits: min jump {}/{}, route {}/{}\n",
+         min_jump_stats.m_hits, min_jump_stats.m_hits + min_jump_stats.m_misses,
+         route_stats.m_hits, route_stats.m_hits + route_stats.m_misses
+      );
+      return 0;
+   }
+
+
+
+   [[nodiscard]] auto run_alternatives(
+      const universe& univ,
+      const std::string& from,
+      const std::string& to,
+      const int k,
+      const std::optional<float>& jump_range
+   ) -> int
+   {
+      const std::optional<int> source_index = find_system(univ, from);
+      const std::optional<int> destination_index = find_system(univ, to);
+      if (source_index.has_value() == false || destination_index.has_value() == false)
+         return 1;
+
+      constexpr position_mode mode = position_mode::reconstructed;
+      const float range = jump_range.value_or(get_route_cache().get_min_jump_dist(univ, *source_index, *destination_index, mode) + 0.001f);
+      const graph jump_graph = get_graph_from_universe(univ, range);
+      const auto t0 = std::chrono::high_resolution_clock::now();
+      const std::vector<ranked_route> routes = get_k_shortest_paths(jump_graph, univ, *source_index, *destination_index, k, mode);
+      const auto t1 = std::chrono::high_resolution_clock::now();
+      for (int i = 0; i < std::ssize(routes); ++i)
+      {
+         fmt::print("Route {}: {:.1f} LY\n", i + 1, routes[i].m_total_distance);
+         print_path(univ, routes[i].m_path, mode);
+      }
+      const auto us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+      fmt::print("{} routes with {:.2f} LY range in {} us\n", routes.size(), range, us);
+      return routes.empty() ? 1 : 0;
+   }
+
+
+
+   [[nodiscard]] auto run_itinerary(
+      const universe& univ,
+      const float jump_range,
+      const std::vector<std::string>& names
+   ) -> int
+   {
+      std::vector<int> waypoints;
+      for (const std::string& name : names)
+      {
+         const std::optional<int> index = find_system(univ, name);
+         if (index.has_value() == false)
+            return 1;
+         waypoints.push_back(*index);
+      }
+
+      constexpr position_mode mode = position_mode::reconstructed;
+      const graph jump_graph = get_graph_from_universe(univ, jump_range);
+      const auto t0 = std::chrono::high_resolution_clock::now();
+      const std::optional<itinerary> plan = get_itinerary(jump_graph, univ, waypoints, mode);
+      const auto t1 = std::chrono::high_resolution_clock::now();
+      if (plan.has_value() == false)
+      {
+         fmt::print("Jump range not large enough\n");
+         return 1;
+      }
+      for (int i = 0; i < std::ssize(plan->m_waypoint_order); ++i)
+         fmt::print("Stop {}: {}\n", i + 1, univ.m_systems[plan->m_waypoint_order[i]].get_name());
+      print_path(univ, plan->m_path, mode);
+      const auto us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+      fmt::print("{:.1f} LY over {} jumps, planned in {} us\n", plan->m_total_distance, std::ssize(plan->m_path.m_stops) - 1, us);
+      return 0;
+   }
+
+
+
+   [[nodiscard]] auto run_chokepoints(const universe& univ, const float jump_range) -> int
+   {
+      constexpr position_mode mode = position_mode::reconstructed;
+      const graph jump_graph = get_graph_from_universe(univ, jump_range);
+      const auto t0 = std::chrono::high_resolution_clock::now();
+      const chokepoint_analysis analysis = get_chokepoint_analysis(jump_graph, univ, mode);
+      const auto t1 = std::chrono::high_resolution_clock::now();
+
+      std::vector<int> ranking(std::ssize(univ.m_systems));
+      std::iota(std::begin(ranking), std::end(ranking), 0);
+      const auto more_central = [&](const int a, const int b) {
+         return analysis.m_system_betweenness[a] > analysis.m_system_betweenness[b];
+      };
+      const int shown_count = std::min(10, static_cast<int>(std::ssize(ranking)));
+      std::ranges::partial_sort(ranking, std::begin(ranking) + shown_count, more_central);
+      for (int i = 0; i < shown_count; ++i)
+         fmt::print("{:>2}: {} ({:.0f} routes)\n", i + 1, univ.m_systems[ranking[i]].get_name(), analysis.m_system_betweenness[ranking[i]]);
+
+      const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+      fmt::print(
+         "{} systems, {} connections: {} articulation points, {} bridges in {} ms\n",
+         std::ssize(jump_graph.m_nodes), std::ssize(jump_graph.m_sorted_connections), std::ssize(analysis.m_articulation_points), std::ssize(analysis.m_bridges), ms
+      );
+      return 0;
+   }
+
+
+
+
+   [[nodiscard]] auto run_replay(
+      const std::optional<int>& system_count,
+      const std::optional<std::string>& path_filename,
+      const std::optional<std::string>& csv_filename
+   ) -> int
+   {
+      universe univ;
+      if (system_count.has_value())
+      {
+         // Same density as the neighborhood of Sol, the trailer flies through along x
+         const float extent = 200.0f * std::cbrt(*system_count / 2000.0f);
+         univ = get_synthetic_universe(*system_count, extent, 1);
+         univ.m_cam_info = cam_info{
+            .m_cs = cs(glm::vec3{ 1, 0, 0 }, glm::vec3{ 0, 0, 1 }),
+            .m_cam_pos0 = glm::vec3{ -0.6f * extent, 0, 0 },
+            .m_cam_pos1 = glm::vec3{ 0.6f * extent, 0, 0 }
+         };
+      }
+      else
+      {
+         univ = get_aligned_universe();
+      }
+
+      camera_path path = get_trailer_path(univ.m_cam_info);
+      if (path_filename.has_value())
+      {
+         const std::optional<camera_path> read_path = read_camera_path(*path_filename);
+         if (read_path.has_value() == false)
+         {
+            fmt::print("couldn't read camera path from {}\n", *path_filename);
+            return 1;
+         }
+         path = *read_path;
+      }
+
+      const replay_report report = run_headless_replay(univ, path, glm::ivec2{ 1280, 720 });
+      fmt::print("{}", get_replay_report_text(report));
+      if (csv_filename.has_value() && write_replay_csv(report, *csv_filename) == false)
+      {
+         fmt::print("couldn't write {}\n", *csv_filename);
+         return 1;
+      }
+      return 0;
+   }
+
+} // namespace {}
+
+
+auto sfn::run_headless(const std::vector<std::string>& args) -> std::optional<int>
+{
+   if (args.empty() || args[0].starts_with("--") == false)
+      return std::nullopt;
+
+   const std::string& command = args[0];
+   if (command == "--find" && args.size() == 2)
+   {
+      const universe univ = get_aligned_universe();
+      return run_find(univ, args[1]);
+   }
+   if (command == "--route" && (args.size() == 3 || args.size() == 4))
+   {
+      const universe univ = get_aligned_universe();
+      const std::optional<float> jump_range = args.size() == 4 ? std::optional<float>(std::stof(args[3])) : std::nullopt;
+      return run_route(univ, args[1], args[2], jump_range);
+   }
+   if (command == "--routes" && (args.size() == 4 || args.size() == 5))
+   {
+      const universe univ = get_aligned_universe();
+      const std::optional<float> jump_range = args.size() == 5 ? std::optional<float>(std::stof(args[4])) : std::nullopt;
+      return run_alternatives(univ, args[1], args[2], std::stoi(args[3]), jump_range);
+   }
+   if (command == "--itinerary" && args.size() >= 4)
+   {
+      const universe univ = get_aligned_universe();
+      return run_itinerary(univ, std::stof(args[1]), std::vector<std::string>(std::next(std::begin(args), 2), std::end(args)));
+   }
+   if (command == "--chokepoints" && (args.size() == 2 || args.size() == 3))
+   {
+      if (args.size() == 3)
+      {
+         // Same density as the neighborhood of Sol
+         const int system_count = std::stoi(args[2]);
+         const float extent = 200.0f * std::cbrt(system_count / 2000.0f);
+         return run_chokepoints(get_synthetic_universe(system_count, extent, 1), std::stof(args[1]));
+      }
+      return run_chokepoints(get_aligned_universe(), std::stof(args[1]));
+   }
+   if (command == "--replay")
+   {
+      std::optional<int> system_count;
+      std::optional<std::string> path_filename;
+      std::optional<std::string> csv_filename;
+      for (int i = 1; i < std::ssize(args); ++i)
+      {
+         if (args[i] == "--path" && i + 1 < std::ssize(args))
+            path_filename = args[++i];
+         else if (args[i] == "--csv" && i + 1 < std::ssize(args))
+            csv_filename = args[++i];
+         else
+            system_count = std::stoi(args[i]);
+      }
+      return run_replay(system_count, path_filename, csv_filename);
+   }
+   if (command == "--benchmark" && args.size() >= 2)
+   {
+      const int system_count = args.size() >= 3 ? std::stoi(args[2]) : 2000;
+      if (args[1] == "layout")
+      {
+         run_layout_benchmark(system_count);
+         return 0;
+      }
+      if (args[1] == "kernels")
+         return run_kernel_benchmark(system_count) ? 0 : 1;
+      if (args[1] == "threads")
+      {
+         run_scaling_benchmark(args.size() >= 3 ? system_count : 40);
+         return 0;
+      }
+      if (args[1] == "arena")
+         return run_arena_benchmark(args.size() >= 3 ? system_count : 60) ? 0 : 1;
+      if (args[1] == "dijkstra")
+         return run_dijkstra_benchmark(system_count) ? 0 : 1;
+      if (args[1] == "catalog")
+         return run_catalog_benchmark(args.size() >= 3 ? system_count : 100000) ? 0 : 1;
+      if (args[1] == "scheduler")
+         return run_scheduler_benchmark() ? 0 : 1;
+      if (args[1] == "lod")
+         return run_lod_benchmark(args.size() >= 3 ? system_count : 100000) ? 0 : 1;
+      if (args[1] == "suite")
+      {
+         suite_options options;
+         for (int i = 2; i < std::ssize(args); ++i)
+         {
+            if (args[i] == "--json" && i + 1 < std::ssize(args))
+               options.m_json_path = args[++i];
+            else if (args[i] == "--filter" && i + 1 < std::ssize(args))
+               options.m_filter = args[++i];
+            else
+               options.m_system_count = std::stoi(args[i]);
+         }
+         return run_benchmark_suite(options) ? 0 : 1;
+      }
+   }
+
+   print_usage();
+   return 1;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+
+namespace sfn
+{
+   // Console queries that run without a window or GL context. Returns the exit code, or std::nullopt if the arguments
+   // don't ask for a headless run
+   [[nodiscard]] auto run_headless(const std::vector<std::string>& args) -> std::optional<int>;
+}
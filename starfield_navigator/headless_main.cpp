@@ -0,0 +1,13 @@
+#include "headless.h"
+
+
+// Entry point of the console-only build, main.cpp is the Windows app
+int main(int argc, char* argv[])
+{
+   const std::vector<std::string> args(argv + 1, argv + argc);
+   if (const std::optional<int> exit_code = sfn::run_headless(args); exit_code.has_value())
+      return *exit_code;
+
+   // Not a headless command, which prints the usage
+   return sfn::run_headless({ "--help" }).value_or(1);
+}
@@ -0,0 +1,99 @@
+#include "isochrone.h"
+
+#include <algorithm>
+
+
+namespace
+{
+   using namespace sfn;
+
+   // Min-heap order, lexicographic over (primary, secondary)
+   [[nodiscard]] auto is_later(const isochrone::heap_entry& a, const isochrone::heap_entry& b) -> bool
+   {
+      if (a.m_primary != b.m_primary)
+         return a.m_primary > b.m_primary;
+      return a.m_secondary > b.m_secondary;
+   }
+
+} // namespace {}
+
+
+auto sfn::isochrone::is_reached(const int system_index) const -> bool
+{
+   return m_jump_counts[system_index] != unreached;
+}
+
+
+auto sfn::isochrone::get_budget_fraction(const int system_index) const -> float
+{
+   if (m_budget.m_metric == isochrone_metric::jumps)
+      return m_budget.m_max_jumps > 0 ? static_cast<float>(m_jump_counts[system_index]) / m_budget.m_max_jumps : 0.0f;
+   return m_budget.m_max_distance > 0.0f ? m_distances[system_index] / m_budget.m_max_distance : 0.0f;
+}
+
+
+auto sfn::update_isochrone(
+   const graph& jump_graph,
+   const universe& universe,
+   const int source_index,
+   const isochrone_budget& budget,
+   const position_mode mode,
+   isochrone& result
+) -> void
+{
+   const int node_count = static_cast<int>(std::ssize(jump_graph.m_nodes));
+   result.m_source_index = source_index;
+   result.m_jump_range = jump_graph.m_jump_range;
+   result.m_budget = budget;
+   result.m_jump_counts.resize(node_count);
+   result.m_distances.resize(node_count);
+   std::ranges::fill(result.m_jump_counts, isochrone::unreached);
+   std::ranges::fill(result.m_distances, shortest_path::no_distance);
+   result.m_reached.clear();
+   result.m_heap.clear();
+
+   // Dijkstra over (jumps, distance) or (distance, jumps). Both parts only grow along a route, so the lexicographic
+   // order is a valid cost. The arrays hold tentative labels until a node is settled, stale heap entries are skipped
+   const bool by_jumps = budget.m_metric == isochrone_metric::jumps;
+   const auto get_entry = [&](const int jumps, const float distance, const int node_index) {
+      return by_jumps
+         ? isochrone::heap_entry{ static_cast<float>(jumps), distance, node_index }
+         : isochrone::heap_entry{ distance, static_cast<float>(jumps), node_index };
+   };
+   const auto is_within_budget = [&](const int jumps, const float distance) {
+      return by_jumps ? jumps <= budget.m_max_jumps : distance <= budget.m_max_distance;
+   };
+
+   std::vector<int>& jump_counts = result.m_jump_counts;
+   std::vector<float>& distances = result.m_distances;
+   jump_counts[source_index] = 0;
+   distances[source_index] = 0.0f;
+   result.m_heap.push_back(get_entry(0, 0.0f, source_index));
+   while (result.m_heap.empty() == false)
+   {
+      std::ranges::pop_heap(result.m_heap, is_later);
+      const isochrone::heap_entry top = result.m_heap.back();
+      result.m_heap.pop_back();
+      const int current = top.m_node_index;
+      const int jumps = static_cast<int>(by_jumps ? top.m_primary : top.m_secondary);
+      const float distance = by_jumps ? top.m_secondary : top.m_primary;
+      if (jumps != jump_counts[current] || distance != distances[current])
+         continue;
+      result.m_reached.push_back(current);
+
+      for (const int neighbor : jump_graph.m_nodes[current].m_neighbor_nodes)
+      {
+         const int neighbor_jumps = jumps + 1;
+         const float neighbor_distance = distance + universe.get_distance(current, neighbor, mode);
+         if (is_within_budget(neighbor_jumps, neighbor_distance) == false)
+            continue;
+         const isochrone::heap_entry entry = get_entry(neighbor_jumps, neighbor_distance, neighbor);
+         if (jump_counts[neighbor] != isochrone::unreached && is_later(get_entry(jump_counts[neighbor], distances[neighbor], neighbor), entry) == false)
+            continue;
+         jump_counts[neighbor] = neighbor_jumps;
+         distances[neighbor] = neighbor_distance;
+         result.m_heap.push_back(entry);
+         std::ranges::push_heap(result.m_heap, is_later);
+      }
+   }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include "graph.h"
+#include "universe.h"
+
+
+namespace sfn
+{
+   enum class isochrone_metric { jumps, distance };
+
+   struct isochrone_budget
+   {
+      isochrone_metric m_metric = isochrone_metric::jumps;
+      int m_max_jumps = 3;
+      float m_max_distance = 50.0f;
+   };
+
+   // Everything reachable from a source within a budget of jumps or light-years. Ties in the budget metric are broken
+   // by the other one. The buffers are kept between queries, so recomputing doesn't allocate once they have grown to the
+   // graph size
+   struct isochrone
+   {
+      constexpr static inline int unreached = -1;
+
+      int m_source_index = 0;
+      float m_jump_range = 0.0f;      // of the graph it was computed on
+      isochrone_budget m_budget;
+      std::vector<int> m_jump_counts; // unreached if outside the budget
+      std::vector<float> m_distances; // along the same route
+      std::vector<int> m_reached;     // in the order they were settled, source first
+
+      struct heap_entry
+      {
+         float m_primary;
+         float m_secondary;
+         int m_node_index;
+      };
+      std::vector<heap_entry> m_heap;
+
+      [[nodiscard]] auto is_reached(const int system_index) const -> bool;
+
+      // Budget metric of a reached system relative to the budget, in [0, 1]
+      [[nodiscard]] auto get_budget_fraction(const int system_index) const -> float;
+   };
+
+   auto update_isochrone(const graph& jump_graph, const universe& universe, const int source_index, const isochrone_budget& budget, const position_mode mode, isochrone& result) -> void;
+}
@@ -0,0 +1,254 @@
+#include "itinerary.h"
+
+#include <bit>
+#include <numeric>
+
+#include "thread_pool.h"
+
+
+namespace
+{
+   using namespace sfn;
+
+   constexpr float unreachable = std::numeric_limits<float>::infinity();
+
+   // Leg lengths between waypoints plus the trees to reconstruct the legs
+   struct leg_matrix
+   {
+      int m_size;
+      std::vector<float> m_distances;
+      std::vector<shortest_path_tree> m_trees;
+
+      [[nodiscard]] auto get(const int from, const int to) const -> float
+      {
+         return m_distances[from * m_size + to];
+      }
+   };
+
+
+   [[nodiscard]] auto get_leg_matrix(
+      const graph& jump_graph,
+      const universe& universe,
+      const std::vector<int>& waypoints,
+      const position_mode mode
+   ) -> leg_matrix
+   {
+      const int n = static_cast<int>(std::ssize(waypoints));
+      leg_matrix result{ .m_size = n, .m_distances = std::vector<float>(n * n, unreachable) };
+      result.m_trees.reserve(n);
+      for (int i = 0; i < n; ++i)
+         result.m_trees.emplace_back(waypoints[i], static_cast<int>(std::ssize(jump_graph.m_nodes)));
+
+      const auto distance_getter = [&](const int i, const int j) {return universe.get_distance(i, j, mode); };
+      parallel_for(0, n, [&](const int i) {
+         result.m_trees[i] = jump_graph.get_dijkstra(waypoints[i], distance_getter);
+         for (int j = 0; j < n; ++j)
+         {
+            const float distance = result.m_trees[i].get_distance_from_source(waypoints[j]);
+            if (distance != shortest_path::no_distance)
+               result.m_distances[i * n + j] = distance;
+         }
+      }, 1);
+      return result;
+   }
+
+
+   [[nodiscard]] auto get_order_length(const leg_matrix& legs, const std::vector<int>& order) -> float
+   {
+      float result = 0.0f;
+      for (int i = 0; i < std::ssize(order) - 1; ++i)
+         result += legs.get(order[i], order[i + 1]);
+      return result;
+   }
+
+
+   // Open path starting at waypoint 0. dp[mask][last] is the shortest path from 0 through the waypoints in mask
+   // (waypoint i is bit i-1), ending in last
+   [[nodiscard]] auto get_held_karp_order(const leg_matrix& legs) -> std::vector<int>
+   {
+      const int n = legs.m_size;
+      if (n <= 2)
+      {
+         std::vector<int> order(n);
+         std::iota(std::begin(order), std::end(order), 0);
+         return order;
+      }
+
+      const int free_count = n - 1;
+      const uint32_t full_mask = (1u << free_count) - 1;
+      std::vector<float> dp(static_cast<size_t>(full_mask + 1) * n, unreachable);
+      std::vector<int8_t> parent(dp.size(), -1);
+      const auto get_index = [&](const uint32_t mask, const int last) { return static_cast<size_t>(mask) * n + last; };
+
+      for (int last = 1; last < n; ++last)
+         dp[get_index(1u << (last - 1), last)] = legs.get(0, last);
+      for (uint32_t mask = 1; mask <= full_mask; ++mask)
+      {
+         for (int last = 1; last < n; ++last)
+         {
+            const uint32_t last_bit = 1u << (last - 1);
+            if ((mask & last_bit) == 0 || dp[get_index(mask, last)] == unreachable)
+               continue;
+            for (int next = 1; next < n; ++next)
+            {
+               const uint32_t next_bit = 1u << (next - 1);
+               if (mask & next_bit)
+                  continue;
+               const float candidate = dp[get_index(mask, last)] + legs.get(last, next);
+               float& target = dp[get_index(mask | next_bit, next)];
+               if (candidate < target)
+               {
+                  target = candidate;
+                  parent[get_index(mask | next_bit, next)] = static_cast<int8_t>(last);
+               }
+            }
+         }
+      }
+
+      int last = 1;
+      for (int candidate = 2; candidate < n; ++candidate)
+      {
+         if (dp[get_index(full_mask, candidate)] < dp[get_index(full_mask, last)])
+            last = candidate;
+      }
+      std::vector<int> order;
+      for (uint32_t mask = full_mask; mask != 0; )
+      {
+         order.push_back(last);
+         const int previous = parent[get_index(mask, last)];
+         mask &= ~(1u << (last - 1));
+         if (previous < 0)
+            break;
+         last = previous;
+      }
+      order.push_back(0);
+      std::ranges::reverse(order);
+      return order;
+   }
+
+
+   [[nodiscard]] auto get_nearest_neighbor_order(const leg_matrix& legs) -> std::vector<int>
+   {
+      std::vector<int> order{ 0 };
+      std::vector<bool> visited(legs.m_size, false);
+      visited[0] = true;
+      for (int step = 1; step < legs.m_size; ++step)
+      {
+         int best = -1;
+         for (int candidate = 0; candidate < legs.m_size; ++candidate)
+         {
+            if (visited[candidate])
+               continue;
+            if (best == -1 || legs.get(order.back(), candidate) < legs.get(order.back(), best))
+               best = candidate;
+         }
+         visited[best] = true;
+         order.push_back(best);
+      }
+      return order;
+   }
+
+
+   // Reverses order[i..j] if that makes the path shorter. The start stays fixed
+   [[nodiscard]] auto try_2opt(const leg_matrix& legs, std::vector<int>& order) -> bool
+   {
+      const int n = static_cast<int>(std::ssize(order));
+      bool improved = false;
+      for (int i = 1; i < n - 1; ++i)
+      {
+         for (int j = i + 1; j < n; ++j)
+         {
+            float delta = legs.get(order[i - 1], order[j]) - legs.get(order[i - 1], order[i]);
+            if (j + 1 < n)
+               delta += legs.get(order[i], order[j + 1]) - legs.get(order[j], order[j + 1]);
+            if (delta < -0.0001f)
+            {
+               std::reverse(std::begin(order) + i, std::begin(order) + j + 1);
+               improved = true;
+            }
+         }
+      }
+      return improved;
+   }
+
+
+   // Moves segments of up to three waypoints to a better position
+   [[nodiscard]] auto try_or_opt(const leg_matrix& legs, std::vector<int>& order) -> bool
+   {
+      const int n = static_cast<int>(std::ssize(order));
+      for (int length = 1; length <= 3; ++length)
+      {
+         for (int begin = 1; begin + length <= n; ++begin)
+         {
+            const float before = get_order_length(legs, order);
+            std::vector<int> rest = order;
+            const std::vector<int> segment(std::begin(order) + begin, std::begin(order) + begin + length);
+            rest.erase(std::begin(rest) + begin, std::begin(rest) + begin + length);
+            for (int insert = 1; insert <= std::ssize(rest); ++insert)
+            {
+               if (insert == begin)
+                  continue;
+               std::vector<int> candidate = rest;
+               candidate.insert(std::begin(candidate) + insert, std::cbegin(segment), std::cend(segment));
+               if (get_order_length(legs, candidate) < before - 0.0001f)
+               {
+                  order = std::move(candidate);
+                  return true;
+               }
+            }
+         }
+      }
+      return false;
+   }
+
+
+   [[nodiscard]] auto get_heuristic_order(const leg_matrix& legs) -> std::vector<int>
+   {
+      std::vector<int> order = get_nearest_neighbor_order(legs);
+      while (try_2opt(legs, order) || try_or_opt(legs, order))
+      {
+
+      }
+      return order;
+   }
+
+} // namespace {}
+
+
+auto sfn::get_itinerary(
+   const graph& jump_graph,
+   const universe& universe,
+   const std::vector<int>& waypoints,
+   const position_mode mode
+) -> std::optional<itinerary>
+{
+   if (waypoints.empty())
+      return std::nullopt;
+
+   const leg_matrix legs = get_leg_matrix(jump_graph, universe, waypoints, mode);
+
+   // Jumps go both ways, so everything is reachable if it is from the first waypoint. The orderings rely on that
+   for (int i = 1; i < legs.m_size; ++i)
+   {
+      if (legs.get(0, i) == unreachable)
+         return std::nullopt;
+   }
+   const std::vector<int> order = std::ssize(waypoints) <= exact_waypoint_limit ? get_held_karp_order(legs) : get_heuristic_order(legs);
+   const float total_distance = get_order_length(legs, order);
+   if (total_distance == unreachable)
+      return std::nullopt;
+
+   itinerary result{ .m_total_distance = total_distance };
+   result.m_path.m_stops.push_back(waypoints[order.front()]);
+   for (int i = 0; i < std::ssize(order) - 1; ++i)
+   {
+      const shortest_path_tree& tree = legs.m_trees[order[i]];
+      std::vector<int> leg;
+      for (std::optional<int> position = waypoints[order[i + 1]]; *position != tree.m_source_node_index; position = tree.m_entries[*position].m_previous_vertex_index)
+         leg.push_back(*position);
+      result.m_path.m_stops.insert(std::end(result.m_path.m_stops), std::crbegin(leg), std::crend(leg));
+   }
+   for (const int waypoint : order)
+      result.m_waypoint_order.push_back(waypoints[waypoint]);
+   return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "graph.h"
+#include "universe.h"
+
+
+namespace sfn
+{
+   struct itinerary
+   {
+      std::vector<int> m_waypoint_order; // system indices, starting with the first waypoint
+      jump_path m_path;                  // all legs combined
+      float m_total_distance;
+   };
+
+   // Order of the waypoints with the least travel, starting at the first one. The leg matrix is computed in parallel,
+   // the order exactly with Held-Karp up to exact_waypoint_limit waypoints, with 2-opt and Or-opt beyond that.
+   // std::nullopt if a waypoint can't be reached with the graph's jump range
+   constexpr inline int exact_waypoint_limit = 16;
+   [[nodiscard]] auto get_itinerary(const graph& jump_graph, const universe& universe, const std::vector<int>& waypoints, const position_mode mode) -> std::optional<itinerary>;
+}
@@ -0,0 +1,240 @@
+#include "k_shortest_paths.h"
+
+#include <queue>
+
+#include "arena.h"
+
+
+namespace
+{
+   using namespace sfn;
+
+   constexpr float unreachable = std::numeric_limits<float>::max();
+   constexpr int no_node = -1;
+
+   struct candidate
+   {
+      std::pmr::vector<int> m_stops;
+      float m_total_distance;
+   };
+
+   // Distances and next hops towards the destination
+   struct destination_tree
+   {
+      std::pmr::vector<float> m_distances;
+      std::pmr::vector<int> m_next;
+   };
+
+
+   struct spur_search
+   {
+      const graph& m_graph;
+      const universe& m_universe;
+      const destination_tree& m_tree;
+      position_mode m_mode;
+      int m_destination_index;
+
+      // Stamped per search, so nothing has to be cleared between the spur searches
+      std::pmr::vector<int> m_blocked_stamp;
+      std::pmr::vector<int> m_visited_stamp;
+      std::pmr::vector<float> m_costs;
+      std::pmr::vector<int> m_previous;
+      int m_stamp = 0;
+
+      // The blocked edges all start at the spur node
+      [[nodiscard]] auto find(const int spur_index, const std::pmr::vector<int>& blocked_nodes, const std::pmr::vector<int>& blocked_first_hops, std::pmr::memory_resource* resource) -> std::optional<candidate>;
+   };
+
+
+   auto spur_search::find(
+      const int spur_index,
+      const std::pmr::vector<int>& blocked_nodes,
+      const std::pmr::vector<int>& blocked_first_hops,
+      std::pmr::memory_resource* resource
+   ) -> std::optional<candidate>
+   {
+      ++m_stamp;
+      for (const int node_index : blocked_nodes)
+         m_blocked_stamp[node_index] = m_stamp;
+      const auto is_blocked_hop = [&](const int from, const int to) {
+         if (m_blocked_stamp[to] == m_stamp)
+            return true;
+         return from == spur_index && std::ranges::find(blocked_first_hops, to) != std::cend(blocked_first_hops);
+      };
+
+      // Fast path: the tree route from the spur node is still open
+      bool tree_route_open = m_tree.m_distances[spur_index] != unreachable;
+      for (int node = spur_index; tree_route_open && node != m_destination_index; node = m_tree.m_next[node])
+         tree_route_open = is_blocked_hop(node, m_tree.m_next[node]) == false;
+      if (tree_route_open)
+      {
+         candidate result{ .m_stops = std::pmr::vector<int>(resource), .m_total_distance = m_tree.m_distances[spur_index] };
+         for (int node = spur_index; node != m_destination_index; node = m_tree.m_next[node])
+            result.m_stops.push_back(node);
+         result.m_stops.push_back(m_destination_index);
+         return result;
+      }
+
+      // A* with the exact unrestricted distances as heuristic
+      using entry = std::pair<float, int>;
+      std::priority_queue<entry, std::pmr::vector<entry>, std::greater<>> queue{ std::greater<>{}, std::pmr::vector<entry>(resource) };
+      m_visited_stamp[spur_index] = m_stamp;
+      m_costs[spur_index] = 0.0f;
+      m_previous[spur_index] = no_node;
+      queue.emplace(m_tree.m_distances[spur_index], spur_index);
+      while (queue.empty() == false)
+      {
+         const auto [estimate, node_index] = queue.top();
+         queue.pop();
+         if (estimate > m_costs[node_index] + m_tree.m_distances[node_index])
+            continue;
+         if (node_index == m_destination_index)
+         {
+            candidate result{ .m_stops = std::pmr::vector<int>(resource), .m_total_distance = m_costs[node_index] };
+            for (int node = node_index; node != no_node; node = m_previous[node])
+               result.m_stops.push_back(node);
+            std::ranges::reverse(result.m_stops);
+            return result;
+         }
+         for (const int neighbor : m_graph.m_nodes[node_index].m_neighbor_nodes)
+         {
+            if (m_tree.m_distances[neighbor] == unreachable || is_blocked_hop(node_index, neighbor))
+               continue;
+            const float cost = m_costs[node_index] + m_universe.get_distance(node_index, neighbor, m_mode);
+            if (m_visited_stamp[neighbor] == m_stamp && cost >= m_costs[neighbor])
+               continue;
+            m_visited_stamp[neighbor] = m_stamp;
+            m_costs[neighbor] = cost;
+            m_previous[neighbor] = node_index;
+            queue.emplace(cost + m_tree.m_distances[neighbor], neighbor);
+         }
+      }
+      return std::nullopt;
+   }
+
+
+   [[nodiscard]] auto get_destination_tree(
+      const graph& jump_graph,
+      const universe& universe,
+      const int destination_index,
+      const position_mode mode,
+      std::pmr::memory_resource* resource
+   ) -> destination_tree
+   {
+      const int node_count = static_cast<int>(std::ssize(jump_graph.m_nodes));
+      destination_tree result{
+         .m_distances = std::pmr::vector<float>(node_count, unreachable, resource),
+         .m_next = std::pmr::vector<int>(node_count, no_node, resource)
+      };
+      using entry = std::pair<float, int>;
+      std::priority_queue<entry, std::pmr::vector<entry>, std::greater<>> queue{ std::greater<>{}, std::pmr::vector<entry>(resource) };
+      result.m_distances[destination_index] = 0.0f;
+      queue.emplace(0.0f, destination_index);
+      while (queue.empty() == false)
+      {
+         const auto [distance, node_index] = queue.top();
+         queue.pop();
+         if (distance > result.m_distances[node_index])
+            continue;
+         for (const int neighbor : jump_graph.m_nodes[node_index].m_neighbor_nodes)
+         {
+            const float candidate_distance = distance + universe.get_distance(node_index, neighbor, mode);
+            if (candidate_distance >= result.m_distances[neighbor])
+               continue;
+            result.m_distances[neighbor] = candidate_distance;
+            result.m_next[neighbor] = node_index;
+            queue.emplace(candidate_distance, neighbor);
+         }
+      }
+      return result;
+   }
+
+} // namespace {}
+
+
+auto sfn::get_k_shortest_paths(
+   const graph& jump_graph,
+   const universe& universe,
+   const int source_index,
+   const int destination_index,
+   const int k,
+   const position_mode mode
+) -> std::vector<ranked_route>
+{
+   const arena_scope scope;
+   std::pmr::memory_resource* resource = scope.get_resource();
+   const int node_count = static_cast<int>(std::ssize(jump_graph.m_nodes));
+
+   const destination_tree tree = get_destination_tree(jump_graph, universe, destination_index, mode, resource);
+   if (k <= 0 || tree.m_distances[source_index] == unreachable)
+      return {};
+
+   spur_search search{
+      .m_graph = jump_graph,
+      .m_universe = universe,
+      .m_tree = tree,
+      .m_mode = mode,
+      .m_destination_index = destination_index,
+      .m_blocked_stamp = std::pmr::vector<int>(node_count, 0, resource),
+      .m_visited_stamp = std::pmr::vector<int>(node_count, 0, resource),
+      .m_costs = std::pmr::vector<float>(node_count, 0.0f, resource),
+      .m_previous = std::pmr::vector<int>(node_count, no_node, resource)
+   };
+
+   std::pmr::vector<candidate> accepted(resource);
+   std::pmr::vector<candidate> candidates(resource);
+   accepted.push_back(*search.find(source_index, std::pmr::vector<int>(resource), std::pmr::vector<int>(resource), resource));
+
+   std::pmr::vector<int> blocked_nodes(resource);
+   std::pmr::vector<int> blocked_first_hops(resource);
+   while (std::ssize(accepted) < k)
+   {
+      const candidate& previous = accepted.back();
+      float root_distance = 0.0f;
+      for (int spur_position = 0; spur_position < std::ssize(previous.m_stops) - 1; ++spur_position)
+      {
+         const int spur_index = previous.m_stops[spur_position];
+         const auto root_begin = std::cbegin(previous.m_stops);
+         const auto root_end = root_begin + spur_position + 1;
+
+         // Routes sharing this root can't leave the spur node the same way again
+         blocked_first_hops.clear();
+         for (const candidate& route : accepted)
+         {
+            if (std::ssize(route.m_stops) > spur_position + 1 && std::equal(root_begin, root_end, std::cbegin(route.m_stops)))
+               blocked_first_hops.push_back(route.m_stops[spur_position + 1]);
+         }
+         blocked_nodes.assign(root_begin, root_end - 1);
+
+         std::optional<candidate> spur = search.find(spur_index, blocked_nodes, blocked_first_hops, resource);
+         if (spur.has_value())
+         {
+            candidate total{ .m_stops = std::pmr::vector<int>(root_begin, root_end - 1, resource), .m_total_distance = root_distance + spur->m_total_distance };
+            total.m_stops.insert(std::end(total.m_stops), std::cbegin(spur->m_stops), std::cend(spur->m_stops));
+            const auto same_stops = [&](const candidate& other) { return other.m_stops == total.m_stops; };
+            if (std::ranges::none_of(candidates, same_stops))
+               candidates.push_back(std::move(total));
+         }
+         root_distance += universe.get_distance(spur_index, previous.m_stops[spur_position + 1], mode);
+      }
+
+      if (candidates.empty())
+         break;
+      const auto best = std::ranges::min_element(candidates, {}, &candidate::m_total_distance);
+      accepted.push_back(std::move(*best));
+      candidates.erase(best);
+   }
+
+   std::vector<ranked_route> result;
+   result.reserve(accepted.size());
+   for (const candidate& route : accepted)
+   {
+      result.push_back(
+         ranked_route{
+            .m_path = jump_path{ .m_stops = std::pmr::vector<int>(std::cbegin(route.m_stops), std::cend(route.m_stops), std::pmr::get_default_resource()) },
+            .m_total_distance = route.m_total_distance
+         }
+      );
+   }
+   return result;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+#include "graph.h"
+#include "universe.h"
+
+
+namespace sfn
+{
+   struct ranked_route
+   {
+      jump_path m_path;
+      float m_total_distance;
+   };
+
+   // Up to k loopless routes in order of total distance (Yen's algorithm). The shortest-path tree towards the
+   // destination is built once. Spur paths reuse it directly where no blocked edge is in the way, otherwise it's the
+   // exact heuristic of an A* search
+   [[nodiscard]] auto get_k_shortest_paths(const graph& jump_graph, const universe& universe, const int source_index, const int destination_index, const int k, const position_mode mode) -> std::vector<ranked_route>;
+}
@@ -19,6 +19,7 @@
 
 #include "engine.h"
 #include "graph.h"
+#include "headless.h"
 #include "setup.h"
 #include "universe_creation.h"
 
@@ -30,13 +31,19 @@
 
 // Disable console window in release mode
 #if defined(_DEBUG) || defined(SHOW_CONSOLE)
-auto main(int /*argc*/, char* /*argv*/) -> int
+auto main(int argc, char* argv[]) -> int
 #else
 auto CALLBACK WinMain(HINSTANCE /*hInstance*/, HINSTANCE /*hPrevInstance*/, LPSTR /*lpCmdLine*/, int /*nCmdShow*/) -> int
 #endif
 {
    using namespace sfn;
 
+#if defined(_DEBUG) || defined(SHOW_CONSOLE)
+   // Headless queries need the console
+   if (const std::optional<int> exit_code = run_headless(std::vector<std::string>(argv + 1, argv + argc)); exit_code.has_value())
+      return *exit_code;
+#endif
+
    config cfg{
          .res_x = 1280, .res_y = 720,
          .opengl_major_version = 4, .opengl_minor_version = 5,
@@ -0,0 +1,305 @@
+#include "mesh_lod.h"
+
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define SFN_TARGET(x)
+#else
+#define SFN_TARGET(x) __attribute__((target(x)))
+#endif
+
+#pragma warning(push, 0)
+#include <glm/geometric.hpp>
+#pragma warning(pop)
+
+
+namespace
+{
+   using namespace sfn;
+
+   [[nodiscard]] auto get_level(const float size, const lod_thresholds& thresholds) -> uint8_t
+   {
+      const auto& t = thresholds.m_min_pixels;
+      return static_cast<uint8_t>((size < t[0]) + (size < t[1]) + (size < t[2]) + (size < 0.0f));
+   }
+
+
+   // scalar ------------------------------------------------------------------------------------------------------------
+   auto lod_levels_scalar(const lod_projection& projection, const point_span& points, const lod_thresholds& thresholds, uint8_t* out_levels) -> void
+   {
+      const glm::vec4& rx = projection.m_row_x;
+      const glm::vec4& ry = projection.m_row_y;
+      const glm::vec4& rw = projection.m_row_w;
+      for (int i = 0; i < points.m_count; ++i)
+      {
+         const float x = points.m_x[i];
+         const float y = points.m_y[i];
+         const float z = points.m_z[i];
+         const float w = rw[0] * x + rw[1] * y + rw[2] * z + rw[3];
+         const float cx = rx[0] * x + rx[1] * y + rx[2] * z + rx[3];
+         const float cy = ry[0] * x + ry[1] * y + ry[2] * z + ry[3];
+         const bool visible = w > 0.0f && std::abs(cx) <= w + projection.m_clip_extent[0] && std::abs(cy) <= w + projection.m_clip_extent[1];
+         const float size = visible ? projection.m_pixel_numerator / w : -1.0f;
+         out_levels[i] = get_level(size, thresholds);
+      }
+   }
+
+
+   // SSE4 --------------------------------------------------------------------------------------------------------------
+   SFN_TARGET("sse4.1")
+   auto dot_sse4(const glm::vec4& row, const __m128 x, const __m128 y, const __m128 z) -> __m128
+   {
+      const __m128 xy = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[0]), x), _mm_mul_ps(_mm_set1_ps(row[1]), y));
+      return _mm_add_ps(_mm_add_ps(xy, _mm_mul_ps(_mm_set1_ps(row[2]), z)), _mm_set1_ps(row[3]));
+   }
+
+   SFN_TARGET("sse4.1")
+   auto lod_levels_sse4(const lod_projection& projection, const point_span& points, const lod_thresholds& thresholds, uint8_t* out_levels) -> void
+   {
+      const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+      const __m128 extent_x = _mm_set1_ps(projection.m_clip_extent[0]);
+      const __m128 extent_y = _mm_set1_ps(projection.m_clip_extent[1]);
+      const __m128 numerator = _mm_set1_ps(projection.m_pixel_numerator);
+      const __m128 zero = _mm_setzero_ps();
+      const __m128 culled = _mm_set1_ps(-1.0f);
+      const __m128 t0 = _mm_set1_ps(thresholds.m_min_pixels[0]);
+      const __m128 t1 = _mm_set1_ps(thresholds.m_min_pixels[1]);
+      const __m128 t2 = _mm_set1_ps(thresholds.m_min_pixels[2]);
+      int i = 0;
+      for (; i + 4 <= points.m_count; i += 4)
+      {
+         const __m128 x = _mm_loadu_ps(points.m_x + i);
+         const __m128 y = _mm_loadu_ps(points.m_y + i);
+         const __m128 z = _mm_loadu_ps(points.m_z + i);
+         const __m128 w = dot_sse4(projection.m_row_w, x, y, z);
+         const __m128 cx = _mm_and_ps(dot_sse4(projection.m_row_x, x, y, z), abs_mask);
+         const __m128 cy = _mm_and_ps(dot_sse4(projection.m_row_y, x, y, z), abs_mask);
+         const __m128 visible = _mm_and_ps(
+            _mm_cmpgt_ps(w, zero),
+            _mm_and_ps(_mm_cmple_ps(cx, _mm_add_ps(w, extent_x)), _mm_cmple_ps(cy, _mm_add_ps(w, extent_y)))
+         );
+         const __m128 size = _mm_blendv_ps(culled, _mm_div_ps(numerator, w), visible);
+
+         // Comparison masks are -1 per lane
+         __m128i level = _mm_setzero_si128();
+         level = _mm_sub_epi32(level, _mm_castps_si128(_mm_cmplt_ps(size, t0)));
+         level = _mm_sub_epi32(level, _mm_castps_si128(_mm_cmplt_ps(size, t1)));
+         level = _mm_sub_epi32(level, _mm_castps_si128(_mm_cmplt_ps(size, t2)));
+         level = _mm_sub_epi32(level, _mm_castps_si128(_mm_cmplt_ps(size, zero)));
+         const __m128i words = _mm_packs_epi32(level, level);
+         const int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+         std::memcpy(out_levels + i, &bytes, 4);
+      }
+      lod_levels_scalar(projection, points.get_subspan(i, points.m_count - i), thresholds, out_levels + i);
+   }
+
+
+   // AVX2 --------------------------------------------------------------------------------------------------------------
+   SFN_TARGET("avx2")
+   auto dot_avx2(const glm::vec4& row, const __m256 x, const __m256 y, const __m256 z) -> __m256
+   {
+      const __m256 xy = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(row[0]), x), _mm256_mul_ps(_mm256_set1_ps(row[1]), y));
+      return _mm256_add_ps(_mm256_add_ps(xy, _mm256_mul_ps(_mm256_set1_ps(row[2]), z)), _mm256_set1_ps(row[3]));
+   }
+
+   SFN_TARGET("avx2")
+   auto lod_levels_avx2(const lod_projection& projection, const point_span& points, const lod_thresholds& thresholds, uint8_t* out_levels) -> void
+   {
+      const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+      const __m256 extent_x = _mm256_set1_ps(projection.m_clip_extent[0]);
+      const __m256 extent_y = _mm256_set1_ps(projection.m_clip_extent[1]);
+      const __m256 numerator = _mm256_set1_ps(projection.m_pixel_numerator);
+      const __m256 zero = _mm256_setzero_ps();
+      const __m256 culled = _mm256_set1_ps(-1.0f);
+      const __m256 t0 = _mm256_set1_ps(thresholds.m_min_pixels[0]);
+      const __m256 t1 = _mm256_set1_ps(thresholds.m_min_pixels[1]);
+      const __m256 t2 = _mm256_set1_ps(thresholds.m_min_pixels[2]);
+      int i = 0;
+      for (; i + 8 <= points.m_count; i += 8)
+      {
+         const __m256 x = _mm256_loadu_ps(points.m_x + i);
+         const __m256 y = _mm256_loadu_ps(points.m_y + i);
+         const __m256 z = _mm256_loadu_ps(points.m_z + i);
+         const __m256 w = dot_avx2(projection.m_row_w, x, y, z);
+         const __m256 cx = _mm256_and_ps(dot_avx2(projection.m_row_x, x, y, z), abs_mask);
+         const __m256 cy = _mm256_and_ps(dot_avx2(projection.m_row_y, x, y, z), abs_mask);
+         const __m256 visible = _mm256_and_ps(
+            _mm256_cmp_ps(w, zero, _CMP_GT_OQ),
+            _mm256_and_ps(_mm256_cmp_ps(cx, _mm256_add_ps(w, extent_x), _CMP_LE_OQ), _mm256_cmp_ps(cy, _mm256_add_ps(w, extent_y), _CMP_LE_OQ))
+         );
+         const __m256 size = _mm256_blendv_ps(culled, _mm256_div_ps(numerator, w), visible);
+
+         __m256i level = _mm256_setzero_si256();
+         level = _mm256_sub_epi32(level, _mm256_castps_si256(_mm256_cmp_ps(size, t0, _CMP_LT_OQ)));
+         level = _mm256_sub_epi32(level, _mm256_castps_si256(_mm256_cmp_ps(size, t1, _CMP_LT_OQ)));
+         level = _mm256_sub_epi32(level, _mm256_castps_si256(_mm256_cmp_ps(size, t2, _CMP_LT_OQ)));
+         level = _mm256_sub_epi32(level, _mm256_castps_si256(_mm256_cmp_ps(size, zero, _CMP_LT_OQ)));
+         const __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(level), _mm256_extracti128_si256(level, 1));
+         _mm_storel_epi64(reinterpret_cast<__m128i*>(out_levels + i), _mm_packus_epi16(words, words));
+      }
+      lod_levels_scalar(projection, points.get_subspan(i, points.m_count - i), thresholds, out_levels + i);
+   }
+
+
+   [[nodiscard]] auto to_vertex_data(const std::vector<glm::vec3>& positions) -> std::vector<position_vertex_data>
+   {
+      std::vector<position_vertex_data> result;
+      result.reserve(positions.size());
+      for (const glm::vec3& position : positions)
+         result.push_back(position_vertex_data{ position });
+      return result;
+   }
+
+} // namespace {}
+
+
+auto sfn::get_icosphere(const int subdivisions) -> std::vector<position_vertex_data>
+{
+   const float t = 0.5f * (1.0f + std::sqrt(5.0f));
+   const std::array<glm::vec3, 12> corners{
+      glm::vec3{ -1, t, 0 }, glm::vec3{ 1, t, 0 }, glm::vec3{ -1, -t, 0 }, glm::vec3{ 1, -t, 0 },
+      glm::vec3{ 0, -1, t }, glm::vec3{ 0, 1, t }, glm::vec3{ 0, -1, -t }, glm::vec3{ 0, 1, -t },
+      glm::vec3{ t, 0, -1 }, glm::vec3{ t, 0, 1 }, glm::vec3{ -t, 0, -1 }, glm::vec3{ -t, 0, 1 }
+   };
+   constexpr std::array<std::array<int, 3>, 20> faces{ {
+      { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+      { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+      { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+      { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+   } };
+   std::vector<glm::vec3> triangles;
+   for (const std::array<int, 3>& face : faces)
+   {
+      for (const int corner : face)
+         triangles.push_back(glm::normalize(corners[corner]));
+   }
+
+   // Every triangle into four, the new corners pushed out onto the sphere
+   for (int level = 0; level < subdivisions; ++level)
+   {
+      std::vector<glm::vec3> subdivided;
+      subdivided.reserve(4 * triangles.size());
+      for (size_t i = 0; i < triangles.size(); i += 3)
+      {
+         const glm::vec3& a = triangles[i];
+         const glm::vec3& b = triangles[i + 1];
+         const glm::vec3& c = triangles[i + 2];
+         const glm::vec3 ab = glm::normalize(a + b);
+         const glm::vec3 bc = glm::normalize(b + c);
+         const glm::vec3 ca = glm::normalize(c + a);
+         for (const glm::vec3& corner : { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca })
+            subdivided.push_back(corner);
+      }
+      triangles = std::move(subdivided);
+   }
+   return to_vertex_data(triangles);
+}
+
+
+auto sfn::get_cylinder(const int segments) -> std::vector<position_vertex_data>
+{
+   const auto get_ring_point = [&](const float x, const int segment)
+   {
+      const float angle = 2.0f * std::numbers::pi_v<float> * segment / segments;
+      return glm::vec3{ x, std::cos(angle), std::sin(angle) };
+   };
+   std::vector<glm::vec3> triangles;
+   triangles.reserve(12 * segments);
+   for (int i = 0; i < segments; ++i)
+   {
+      const glm::vec3 bottom0 = get_ring_point(0.0f, i);
+      const glm::vec3 bottom1 = get_ring_point(0.0f, i + 1);
+      const glm::vec3 top0 = get_ring_point(1.0f, i);
+      const glm::vec3 top1 = get_ring_point(1.0f, i + 1);
+
+      // Counter-clockwise from the outside
+      for (const glm::vec3& corner : { bottom0, top1, top0, bottom0, bottom1, top1 })
+         triangles.push_back(corner);
+      for (const glm::vec3& corner : { glm::vec3{ 0, 0, 0 }, bottom1, bottom0, glm::vec3{ 1, 0, 0 }, top0, top1 })
+         triangles.push_back(corner);
+   }
+   return to_vertex_data(triangles);
+}
+
+
+auto sfn::get_sphere_lods() -> lod_meshes
+{
+   constexpr std::array<int, lod_count> subdivisions{ 3, 2, 1 };
+   lod_meshes result;
+   for (int level = 0; level < lod_count; ++level)
+   {
+      const std::vector<position_vertex_data> mesh = get_icosphere(subdivisions[level]);
+      result.m_first[level] = static_cast<int>(std::ssize(result.m_vertices));
+      result.m_count[level] = static_cast<int>(std::ssize(mesh));
+      result.m_vertices.insert(std::end(result.m_vertices), std::begin(mesh), std::end(mesh));
+   }
+   return result;
+}
+
+
+auto sfn::get_lod_projection(
+   const glm::mat4& projection,
+   const glm::mat4& view,
+   const float viewport_height,
+   const float radius
+) -> lod_projection
+{
+   const glm::mat4 view_projection = projection * view;
+   const auto get_row = [&](const int row) {
+      return glm::vec4{ view_projection[0][row], view_projection[1][row], view_projection[2][row], view_projection[3][row] };
+   };
+   return lod_projection{
+      .m_row_x = get_row(0),
+      .m_row_y = get_row(1),
+      .m_row_w = get_row(3),
+      .m_clip_extent = glm::vec2{ radius * std::abs(projection[0][0]), radius * std::abs(projection[1][1]) },
+      .m_pixel_numerator = radius * std::abs(projection[1][1]) * viewport_height
+   };
+}
+
+
+auto sfn::get_lod_levels(
+   const lod_projection& projection,
+   const point_span& points,
+   const lod_thresholds& thresholds,
+   uint8_t* out_levels
+) -> void
+{
+   switch (get_simd_level())
+   {
+   case simd_level::avx512:
+   case simd_level::avx2:
+      lod_levels_avx2(projection, points, thresholds, out_levels);
+      return;
+   case simd_level::sse4:
+      lod_levels_sse4(projection, points, thresholds, out_levels);
+      return;
+   case simd_level::scalar:
+      lod_levels_scalar(projection, points, thresholds, out_levels);
+      return;
+   }
+   std::terminate();
+}
+
+
+auto sfn::bucket_by_level(
+   const std::vector<uint8_t>& levels,
+   lod_buckets& buckets
+) -> void
+{
+   // Counting sort
+   buckets.m_offsets.fill(0);
+   for (const uint8_t level : levels)
+      ++buckets.m_offsets[level + 1];
+   for (int level = 0; level <= culled_level; ++level)
+      buckets.m_offsets[level + 1] += buckets.m_offsets[level];
+
+   buckets.m_indices.resize(levels.size());
+   std::array<int, culled_level + 1> cursors;
+   std::copy_n(std::begin(buckets.m_offsets), cursors.size(), std::begin(cursors));
+   for (int i = 0; i < std::ssize(levels); ++i)
+      buckets.m_indices[cursors[levels[i]]++] = i;
+}
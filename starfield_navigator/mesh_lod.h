@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "distance_kernels.h"
+#include "vertex_data.h"
+
+#pragma warning(push, 0)
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#pragma warning(pop)
+
+
+namespace sfn
+{
+   // Mesh levels, most detailed first. Instances below the last one are drawn as impostor points, culled ones not at all
+   constexpr inline int lod_count = 3;
+   constexpr inline int impostor_level = lod_count;
+   constexpr inline int culled_level = lod_count + 1;
+
+   // Unit radius, triangles without indices. Subdivision 0 is the icosahedron
+   [[nodiscard]] auto get_icosphere(const int subdivisions) -> std::vector<position_vertex_data>;
+
+   // Along x from 0 to 1 with radius 1, which is what get_obj_trafo_between_points() scales
+   [[nodiscard]] auto get_cylinder(const int segments) -> std::vector<position_vertex_data>;
+
+   // All levels in one vertex array
+   struct lod_meshes
+   {
+      std::vector<position_vertex_data> m_vertices;
+      std::array<int, lod_count> m_first{};
+      std::array<int, lod_count> m_count{};
+   };
+   [[nodiscard]] auto get_sphere_lods() -> lod_meshes;
+
+   // Smallest projected diameter in pixels for each mesh level
+   struct lod_thresholds
+   {
+      std::array<float, lod_count> m_min_pixels{ 48.0f, 16.0f, 3.0f };
+   };
+
+   // Spheres of one radius seen through a camera
+   struct lod_projection
+   {
+      glm::vec4 m_row_x; // rows of the view projection, for clip x, y and w
+      glm::vec4 m_row_y;
+      glm::vec4 m_row_w;
+      glm::vec2 m_clip_extent;  // of the radius in clip space, widens the frustum test
+      float m_pixel_numerator; // projected diameter times clip w
+   };
+   [[nodiscard]] auto get_lod_projection(const glm::mat4& projection, const glm::mat4& view, const float viewport_height, const float radius) -> lod_projection;
+
+   // One level per point, SIMD like the distance kernels
+   auto get_lod_levels(const lod_projection& projection, const point_span& points, const lod_thresholds& thresholds, uint8_t* out_levels) -> void;
+
+   // Instance indices sorted by level, keeping their order within a level. Level l is [m_offsets[l], m_offsets[l+1])
+   struct lod_buckets
+   {
+      std::vector<int> m_indices;
+      std::array<int, culled_level + 2> m_offsets{};
+   };
+   auto bucket_by_level(const std::vector<uint8_t>& levels, lod_buckets& buckets) -> void;
+}
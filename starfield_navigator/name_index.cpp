@@ -0,0 +1,269 @@
+#include "name_index.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+
+
+namespace
+{
+   using namespace sfn;
+
+   [[nodiscard]] auto get_hash(const std::string_view str) -> uint64_t
+   {
+      // FNV-1a
+      uint64_t hash = 14695981039346656037ull;
+      for (const char c : str)
+      {
+         hash ^= static_cast<uint8_t>(c);
+         hash *= 1099511628211ull;
+      }
+      return hash;
+   }
+
+
+   [[nodiscard]] auto get_common_prefix_length(const std::string_view a, const std::string_view b) -> int
+   {
+      const size_t max_length = std::min(a.size(), b.size());
+      size_t i = 0;
+      while (i < max_length && a[i] == b[i])
+         ++i;
+      return static_cast<int>(i);
+   }
+
+
+   auto add_unique(std::vector<name_match>& matches, const name_match& new_match) -> void
+   {
+      const auto pred = [&](const name_match& match) {
+         return match.m_system_index == new_match.m_system_index;
+      };
+      if (std::ranges::any_of(matches, pred))
+         return;
+      matches.push_back(new_match);
+   }
+
+} // namespace {}
+
+
+auto sfn::get_folded(const std::string_view str) -> std::string
+{
+   std::string result(str);
+   std::ranges::transform(
+      result,
+      result.begin(),
+      [](const char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); }
+   );
+   return result;
+}
+
+
+auto sfn::name_index::add(const std::string_view name, const int system_index) -> void
+{
+   const std::string folded = get_folded(name);
+   if (folded.empty())
+      return;
+   m_keys.push_back(
+      key_entry{
+         .m_offset = static_cast<uint32_t>(m_pool.size()),
+         .m_length = static_cast<uint32_t>(folded.size()),
+         .m_system_index = system_index
+      }
+   );
+   m_pool += folded;
+}
+
+
+auto sfn::name_index::finalize() -> void
+{
+   const size_t capacity = std::bit_ceil(std::max<size_t>(16, 2 * m_keys.size()));
+   m_slots.assign(capacity, 0);
+   m_sorted_keys.clear();
+   m_sorted_keys.reserve(m_keys.size());
+   for (uint32_t i = 0; i < m_keys.size(); ++i)
+   {
+      if (find_key(get_key(i)).has_value())
+         continue;
+      insert_slot(i);
+      m_sorted_keys.push_back(i);
+   }
+
+   const auto pred = [&](const uint32_t a, const uint32_t b) {
+      return get_key(a) < get_key(b);
+   };
+   std::ranges::sort(m_sorted_keys, pred);
+}
+
+
+auto sfn::name_index::clear() -> void
+{
+   m_pool.clear();
+   m_keys.clear();
+   m_slots.clear();
+   m_sorted_keys.clear();
+}
+
+
+auto sfn::name_index::find(const std::string_view name) const -> std::optional<int>
+{
+   const std::optional<uint32_t> key_index = find_key(get_folded(name));
+   if (key_index.has_value() == false)
+      return std::nullopt;
+   return m_keys[*key_index].m_system_index;
+}
+
+
+auto sfn::name_index::find_prefix(
+   const std::string_view prefix,
+   const int max_results
+) const -> std::vector<name_match>
+{
+   const std::string folded = get_folded(prefix);
+   std::vector<name_match> result;
+
+   const auto proj = [&](const uint32_t key_index) { return get_key(key_index); };
+   auto it = std::ranges::lower_bound(m_sorted_keys, std::string_view(folded), {}, proj);
+   for (; it != std::cend(m_sorted_keys) && std::ssize(result) < max_results; ++it)
+   {
+      if (get_key(*it).starts_with(folded) == false)
+         break;
+      add_unique(result, name_match{ .m_system_index = m_keys[*it].m_system_index, .m_distance = 0 });
+   }
+   return result;
+}
+
+
+auto sfn::name_index::find_fuzzy(
+   const std::string_view query,
+   const int max_distance,
+   const int max_results
+) const -> std::vector<name_match>
+{
+   const std::string folded = get_folded(query);
+   const int column_count = static_cast<int>(folded.size()) + 1;
+
+   // Levenshtein rows, one per key depth. Sorted keys share prefixes, so rows up to the common prefix with the
+   // previous key are still valid. Once a row exceeds the distance everywhere, all keys with that prefix are skipped
+   std::vector<int> rows(column_count);
+   for (int j = 0; j < column_count; ++j)
+      rows[j] = j;
+
+   int valid_depth = 0;
+   std::string_view last_key;
+
+   std::vector<name_match> hits;
+   auto it = std::cbegin(m_sorted_keys);
+   while (it != std::cend(m_sorted_keys))
+   {
+      const std::string_view key = get_key(*it);
+      const int common = std::min(get_common_prefix_length(last_key, key), valid_depth);
+      last_key = key;
+
+      const int key_length = static_cast<int>(key.size());
+      if (std::ssize(rows) < (key_length + 1) * column_count)
+         rows.resize((key_length + 1) * column_count);
+
+      std::optional<int> dead_depth;
+      for (int depth = common + 1; depth <= key_length; ++depth)
+      {
+         const int* previous = &rows[(depth - 1) * column_count];
+         int* current = &rows[depth * column_count];
+         current[0] = depth;
+         int row_min = depth;
+         for (int j = 1; j < column_count; ++j)
+         {
+            const int substitution = previous[j - 1] + (key[depth - 1] == folded[j - 1] ? 0 : 1);
+            current[j] = std::min({ previous[j] + 1, current[j - 1] + 1, substitution });
+            row_min = std::min(row_min, current[j]);
+         }
+         if (row_min > max_distance)
+         {
+            dead_depth = depth;
+            break;
+         }
+      }
+
+      if (dead_depth.has_value())
+      {
+         // Skip every key sharing the dead prefix
+         valid_depth = *dead_depth;
+         const std::string_view dead_prefix = key.substr(0, *dead_depth);
+         const auto pred = [&](const uint32_t key_index) {
+            return get_key(key_index).substr(0, *dead_depth) <= dead_prefix;
+         };
+         // Galloping search, dead subtrees are usually small
+         ptrdiff_t step = 1;
+         auto last = it;
+         while (std::cend(m_sorted_keys) - last > step && pred(*(last + step)))
+         {
+            last += step;
+            step *= 2;
+         }
+         const auto gallop_end = std::cend(m_sorted_keys) - last > step ? last + step : std::cend(m_sorted_keys);
+         it = std::partition_point(last, gallop_end, pred);
+         continue;
+      }
+
+      valid_depth = key_length;
+      const int distance = rows[key_length * column_count + column_count - 1];
+      if (distance <= max_distance)
+         hits.push_back(name_match{ .m_system_index = m_keys[*it].m_system_index, .m_distance = distance });
+      ++it;
+   }
+
+   std::ranges::stable_sort(hits, {}, &name_match::m_distance);
+   std::vector<name_match> result;
+   for (const name_match& hit : hits)
+   {
+      if (std::ssize(result) >= max_results)
+         break;
+      add_unique(result, hit);
+   }
+   return result;
+}
+
+
+auto sfn::name_index::search(
+   const std::string_view query,
+   const int max_results
+) const -> std::vector<name_match>
+{
+   std::vector<name_match> result = find_prefix(query, max_results);
+   if (result.empty() == false)
+      return result;
+
+   const int max_distance = query.size() <= 4 ? 1 : 2;
+   return find_fuzzy(query, max_distance, max_results);
+}
+
+
+auto sfn::name_index::get_key(const uint32_t key_index) const -> std::string_view
+{
+   const key_entry& entry = m_keys[key_index];
+   return std::string_view(m_pool).substr(entry.m_offset, entry.m_length);
+}
+
+
+auto sfn::name_index::find_key(const std::string_view folded) const -> std::optional<uint32_t>
+{
+   if (m_slots.empty())
+      return std::nullopt;
+   const size_t mask = m_slots.size() - 1;
+   for (size_t slot = get_hash(folded) & mask; ; slot = (slot + 1) & mask)
+   {
+      if (m_slots[slot] == 0)
+         return std::nullopt;
+      const uint32_t key_index = m_slots[slot] - 1;
+      if (get_key(key_index) == folded)
+         return key_index;
+   }
+}
+
+
+auto sfn::name_index::insert_slot(const uint32_t key_index) -> void
+{
+   const size_t mask = m_slots.size() - 1;
+   size_t slot = get_hash(get_key(key_index)) & mask;
+   while (m_slots[slot] != 0)
+      slot = (slot + 1) & mask;
+   m_slots[slot] = key_index + 1;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace sfn
+{
+   struct name_match
+   {
+      int m_system_index;
+      int m_distance; // edit distance, 0 for exact and prefix hits
+   };
+
+   // Case-folded lookup structure over system names. All keys are interned into one pool. Exact lookups go through an
+   // open-addressing hash table, prefix and fuzzy searches through a sorted key array
+   struct name_index
+   {
+      struct key_entry
+      {
+         uint32_t m_offset;
+         uint32_t m_length;
+         int m_system_index;
+      };
+
+      std::string m_pool;
+      std::vector<key_entry> m_keys;
+      std::vector<uint32_t> m_slots; // key index + 1, 0 is empty
+      std::vector<uint32_t> m_sorted_keys;
+
+      // First add wins if two systems share a (folded) name
+      auto add(const std::string_view name, const int system_index) -> void;
+      auto finalize() -> void;
+      auto clear() -> void;
+
+      [[nodiscard]] auto find(const std::string_view name) const -> std::optional<int>;
+      [[nodiscard]] auto find_prefix(const std::string_view prefix, const int max_results) const -> std::vector<name_match>;
+      [[nodiscard]] auto find_fuzzy(const std::string_view query, const int max_distance, const int max_results) const -> std::vector<name_match>;
+
+      // Prefix hits if there are any, otherwise fuzzy hits sorted by distance. Each system appears only once
+      [[nodiscard]] auto search(const std::string_view query, const int max_results) const -> std::vector<name_match>;
+
+   private:
+      [[nodiscard]] auto get_key(const uint32_t key_index) const -> std::string_view;
+      [[nodiscard]] auto find_key(const std::string_view folded) const -> std::optional<uint32_t>;
+      auto insert_slot(const uint32_t key_index) -> void;
+   };
+
+   [[nodiscard]] auto get_folded(const std::string_view str) -> std::string;
+}
@@ -1,8 +1,11 @@
 #include "obj_parsing.h"
 
-#include <random>
+#include <charconv>
+#include <cstring>
 #include <fstream>
-#include <map>
+#include <numeric>
+#include <string_view>
+#include <type_traits>
 
 #pragma warning(push, 0)
 #include <fmt/format.h>
@@ -15,245 +18,392 @@ namespace
 {
    using namespace sfn;
 
+   static_assert(std::is_trivially_copyable_v<complete_obj_vertex_info>);
 
-   template<typename vec_type>
-   auto get_vec_from_line(const std::string& line) -> vec_type
+   constexpr uint32_t cooked_magic = 0x4853454d; // "MESH"
+   constexpr uint32_t cooked_version = 2;
+
+   // Size and modification time of the OBJ. If they match, the cooked mesh is taken without reading the OBJ
+   struct source_stamp
    {
-      const std::vector<std::string> splitted = get_split_string(line, " ");
-      vec_type result{};
-      for(int i=0; i<vec_type::length(); ++i)
-      {
-         result[i] = std::stof(splitted[i + 1]);
-      }
-      return result;
-   }
+      uint64_t m_size = 0;
+      int64_t m_write_time = 0;
+
+      [[nodiscard]] auto operator==(const source_stamp&) const -> bool = default;
+   };
+
+   struct cooked_header
+   {
+      uint32_t m_magic;
+      uint32_t m_version;
+      float m_max_smoothing_angle;
+      uint32_t m_reserved = 0;
+      source_stamp m_source_stamp;
+      uint64_t m_source_hash;
+      uint64_t m_vertex_count;
+   };
 
-   struct index_triple
+   struct cooked_mesh
    {
-      size_t m_vertex_index;
-      size_t m_uv_index;
-      size_t m_normal_index;
+      cooked_header m_header;
+      std::vector<complete_obj_vertex_info> m_vertices;
    };
 
-   struct face_indices {
-      std::vector<size_t> m_position_indices;
-      std::vector<size_t> m_final_normal_indices;
-      std::string m_mat_name;
 
-      [[nodiscard]] auto get_position_index_index(const size_t index) const -> std::optional<size_t>
+   // Faces in flat arrays, the corners of face f are [m_face_offsets[f], m_face_offsets[f+1])
+   struct obj_faces
+   {
+      std::vector<int> m_face_offsets{ 0 };
+      std::vector<int> m_position_indices;
+      std::vector<int> m_normal_indices; // into the file normals while parsing, into all normals after that
+
+      [[nodiscard]] auto get_face_count() const -> int
       {
-         for(size_t i=0; i< m_position_indices.size(); ++i)
-         {
-            if(m_position_indices[i] == index)
-            {
-               return i;
-            }
-         }
-         return std::nullopt;
+         return static_cast<int>(std::ssize(m_face_offsets)) - 1;
       }
    };
 
-   auto get_face_index_triple(const std::string& triple_str) -> index_triple
+
+   // Next token separated by spaces. Empty at the end
+   [[nodiscard]] auto pop_token(std::string_view& str) -> std::string_view
    {
-      constexpr auto get_index = [](const std::string& str)
+      const size_t begin = str.find_first_not_of(' ');
+      if (begin == std::string_view::npos)
       {
-         return static_cast<size_t>(std::stoi(str) - 1);
-      };
+         str = {};
+         return {};
+      }
+      str.remove_prefix(begin);
+      const size_t end = std::min(str.find(' '), str.size());
+      const std::string_view token = str.substr(0, end);
+      str.remove_prefix(end);
+      return token;
+   }
 
-      const std::vector<std::string> splitted = get_split_string(triple_str, "/");
-      return index_triple{
-         .m_vertex_index = get_index(splitted[0]),
-         .m_uv_index = get_index(splitted[1]),
-         .m_normal_index = get_index(splitted[2])
-      };
+
+   template<typename T>
+   [[nodiscard]] auto parse_number(const std::string_view str) -> T
+   {
+      T value{};
+      const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+      sfn_assert(ec == std::errc{}, "malformed number in obj file");
+      return value;
    }
 
 
-   [[nodiscard]] auto get_face_indices(
-      const std::string& line,
-      std::vector<glm::vec3>& normals,
-      const std::string& mat_name
-   ) -> face_indices
+   [[nodiscard]] auto parse_vec3(std::string_view str) -> glm::vec3
    {
-      const std::vector<std::string> splitted = get_split_string(line, " ");
-      std::vector<size_t> positions;
-      std::vector<size_t> uvs;
-      glm::vec3 normal{};
-      for(int i=1; i< splitted.size(); ++i)
-      {
-         const auto triple = get_face_index_triple(splitted[i]);
-         positions.push_back(triple.m_vertex_index);
-         uvs.push_back(triple.m_uv_index);
-         normal += normals[triple.m_normal_index];
-      }
-      normal = glm::normalize(normal);
-      normals.push_back(normal);
-      const size_t normal_index = normals.size() - 1;
-      return face_indices{
-         .m_position_indices = positions,
-         .m_final_normal_indices = std::vector<size_t>(positions.size(), normal_index),
-         .m_mat_name = mat_name
-      };
+      glm::vec3 result{};
+      for (int i = 0; i < 3; ++i)
+         result[i] = parse_number<float>(pop_token(str));
+      return result;
    }
 
 
-   [[nodiscard]] auto get_quad_center(
-      const std::vector<glm::vec3>& positions,
-      const face_indices& indices
-   ) -> glm::vec3
+   // "v/vt/vn" or "v//vn", one-based. The uv index isn't used
+   auto add_face_corner(const std::string_view corner, obj_faces& faces) -> void
+   {
+      const size_t first_slash = corner.find('/');
+      const size_t second_slash = corner.find('/', first_slash + 1);
+      sfn_assert(second_slash != std::string_view::npos, "obj faces need normals");
+      faces.m_position_indices.push_back(parse_number<int>(corner.substr(0, first_slash)) - 1);
+      faces.m_normal_indices.push_back(parse_number<int>(corner.substr(second_slash + 1)) - 1);
+   }
+
+
+   [[nodiscard]] auto get_file_contents(const fs::path& path) -> std::string
    {
-      sfn_assert(indices.m_position_indices.size() == 4);
-      glm::vec3 position{};
-      for(const size_t& i : indices.m_position_indices)
+      std::ifstream file(path, std::ios::binary);
+      std::string contents(fs::file_size(path), '\0');
+      file.read(contents.data(), std::ssize(contents));
+      return contents;
+   }
+
+
+   // FNV-1a's xor and multiply step, but over eight-byte words instead of bytes. That's not FNV-1a and mixes worse,
+   // but it only has to tell an edited OBJ from the one that was cooked. Byte by byte it would cost more than loading
+   // the cooked mesh
+   [[nodiscard]] auto get_source_hash(const std::string_view contents, const float max_smoothing_angle) -> uint64_t
+   {
+      uint64_t hash = 14695981039346656037ull;
+      const auto add_word = [&](const uint64_t word)
       {
-         position += positions[i];
+         hash ^= word;
+         hash *= 1099511628211ull;
+      };
+      size_t i = 0;
+      for (; i + sizeof(uint64_t) <= contents.size(); i += sizeof(uint64_t))
+      {
+         uint64_t word;
+         std::memcpy(&word, contents.data() + i, sizeof(word));
+         add_word(word);
       }
-      return position /= 4.0f;
+      for (; i < contents.size(); ++i)
+         add_word(static_cast<uint8_t>(contents[i]));
+      uint32_t angle_bits;
+      std::memcpy(&angle_bits, &max_smoothing_angle, sizeof(angle_bits));
+      add_word(angle_bits);
+      add_word(contents.size());
+      add_word(cooked_version);
+      return hash;
    }
-   
-} // namespace {}
 
 
+   [[nodiscard]] auto get_cooked_path(const fs::path& path) -> fs::path
+   {
+      fs::path result = path;
+      result += ".meshcache";
+      return result;
+   }
 
 
-[[nodiscard]] auto sfn::get_complete_obj_info(
-   const fs::path& path,
-   const float max_smoothing_angle
-) -> complete_obj
-{
-   sfn_assert(fs::exists(path), "obj file doesn't exist");
+   [[nodiscard]] auto get_source_stamp(const fs::path& path) -> source_stamp
+   {
+      return source_stamp{
+         .m_size = static_cast<uint64_t>(fs::file_size(path)),
+         .m_write_time = static_cast<int64_t>(fs::last_write_time(path).time_since_epoch().count())
+      };
+   }
+
+
+   // Only checks that the file is intact and was cooked with the same angle. Whether it belongs to the OBJ is up to the
+   // caller
+   [[nodiscard]] auto read_cooked(const fs::path& cooked_path, const float max_smoothing_angle) -> std::optional<cooked_mesh>
+   {
+      std::error_code ec;
+      const uintmax_t file_size = fs::file_size(cooked_path, ec);
+      if (ec || file_size < sizeof(cooked_header))
+         return std::nullopt;
+
+      const std::string contents = get_file_contents(cooked_path);
+      cooked_header header;
+      std::memcpy(&header, contents.data(), sizeof(header));
+      const bool valid = header.m_magic == cooked_magic && header.m_version == cooked_version && header.m_max_smoothing_angle == max_smoothing_angle
+         && contents.size() == sizeof(header) + header.m_vertex_count * sizeof(complete_obj_vertex_info);
+      if (valid == false)
+         return std::nullopt;
 
-   std::vector<glm::vec3> positions;
-   std::vector<glm::vec3> normals;
-   std::vector<face_indices> indexed_faces;
-   
+      cooked_mesh result{ .m_header = header, .m_vertices = std::vector<complete_obj_vertex_info>(header.m_vertex_count) };
+      std::memcpy(result.m_vertices.data(), contents.data() + sizeof(header), header.m_vertex_count * sizeof(complete_obj_vertex_info));
+      return result;
+   }
 
-   std::ifstream infile(path.string());
-   std::string line;
 
-   // collect indixed data + indices
-   while (std::getline(infile, line))
+   // Failing is fine, the next start parses again
+   auto write_cooked(
+      const fs::path& cooked_path,
+      const float max_smoothing_angle,
+      const source_stamp& stamp,
+      const uint64_t source_hash,
+      const std::vector<complete_obj_vertex_info>& vertices
+   ) -> void
    {
-      if (line.starts_with("v "))
-      {
-         positions.push_back(c4d_convert(0.01f * get_vec_from_line<glm::vec3>(line)));
-         positions.back()[1] *= -1.0f; // TODO
-      }
-      else if (line.starts_with("vn "))
+      const cooked_header header{
+         .m_magic = cooked_magic,
+         .m_version = cooked_version,
+         .m_max_smoothing_angle = max_smoothing_angle,
+         .m_source_stamp = stamp,
+         .m_source_hash = source_hash,
+         .m_vertex_count = vertices.size()
+      };
+      std::ofstream file(cooked_path, std::ios::binary);
+      const auto write = [&](const std::span<const std::byte> bytes)
       {
-         normals.push_back(c4d_convert(get_vec_from_line<glm::vec3>(line)));
-      }
+         file.write(reinterpret_cast<const char*>(bytes.data()), std::ssize(bytes));
+      };
+      write(as_bytes(header));
+      write(as_bytes(vertices));
    }
 
-   complete_obj result;
 
-   std::string current_mat;
-   std::string current_obj;
-   infile = std::ifstream(path.string());
-   while (std::getline(infile, line))
+   [[nodiscard]] auto get_vertex_bb(const std::vector<complete_obj_vertex_info>& vertices) -> bb_3D
    {
-      if (line.starts_with("f "))
+      const auto accessor = [](const complete_obj_vertex_info& in)
       {
-         const face_indices face_indices = get_face_indices(line, normals, current_mat);
-         indexed_faces.push_back(face_indices);
-      }
-      else if (line.starts_with("o "))
-      {
-         current_obj = get_split_string(line, " ")[1];
-      }
-      else if (line.starts_with("usemtl "))
-      {
-         current_mat = get_split_string(line, " ")[1];
-      }
+         return std::optional<glm::vec3>(in.m_position);
+      };
+      return get_bb(vertices, accessor);
    }
 
-   // post-process indexed data (normal smoothing)
-   if (max_smoothing_angle > 0.0f)
+
+   // Every face gets its averaged normal. Corners whose face normal is within the angle of the average of all
+   // faces around their position get that average instead
+   auto smooth_normals(
+      const std::vector<glm::vec3>& positions,
+      const float max_smoothing_angle,
+      std::vector<glm::vec3>& normals,
+      obj_faces& faces
+   ) -> void
    {
-      for (size_t position_index = 0; position_index < positions.size(); ++position_index)
+      // Corners around each position, built once
+      std::vector<int> corner_offsets(positions.size() + 1, 0);
+      for (const int position_index : faces.m_position_indices)
+         ++corner_offsets[position_index + 1];
+      std::inclusive_scan(std::begin(corner_offsets), std::end(corner_offsets), std::begin(corner_offsets));
+      std::vector<int> position_corners(faces.m_position_indices.size());
       {
-         // calculate smoothed normal
-         glm::vec3 smoothed_normal{};
-         std::vector<std::reference_wrapper<face_indices>> relevant_faces;
-         for (face_indices& indexed_face : indexed_faces)
-         {
-            const std::optional<size_t> position_index_index = indexed_face.get_position_index_index(position_index);
+         std::vector<int> cursors(std::begin(corner_offsets), std::end(corner_offsets) - 1);
+         for (int corner = 0; corner < std::ssize(faces.m_position_indices); ++corner)
+            position_corners[cursors[faces.m_position_indices[corner]]++] = corner;
+      }
 
-            if (position_index_index.has_value())
-            {
-               smoothed_normal += normals[indexed_face.m_final_normal_indices[position_index_index.value()]];
-               relevant_faces.push_back(indexed_face);
-            }
-         }
+      for (int position_index = 0; position_index < std::ssize(positions); ++position_index)
+      {
+         const std::span<const int> corners = std::span{ position_corners }.subspan(corner_offsets[position_index], corner_offsets[position_index + 1] - corner_offsets[position_index]);
+         glm::vec3 smoothed_normal{};
+         for (const int corner : corners)
+            smoothed_normal += normals[faces.m_normal_indices[corner]];
          if (glm::isNull(smoothed_normal, 0.001f))
-         {
             continue;
-         }
 
          smoothed_normal = glm::normalize(smoothed_normal);
          normals.push_back(smoothed_normal);
-         const size_t smoothed_normal_index = normals.size() - 1;
-
-         // Apply it to faces that satisfy angle predicate
-         for (std::reference_wrapper<face_indices>& indexed_face : relevant_faces)
+         const int smoothed_normal_index = static_cast<int>(std::ssize(normals)) - 1;
+         for (const int corner : corners)
          {
-            const std::optional<size_t> position_index_index = indexed_face.get().get_position_index_index(position_index);
-            const glm::vec3& normal = normals[indexed_face.get().m_final_normal_indices[position_index_index.value()]];
-            const float angle = glm::angle(smoothed_normal, normal);
+            const float angle = glm::angle(smoothed_normal, normals[faces.m_normal_indices[corner]]);
             if (angle <= max_smoothing_angle)
-            {
-               indexed_face.get().m_final_normal_indices[position_index_index.value()] = smoothed_normal_index;
-            }
+               faces.m_normal_indices[corner] = smoothed_normal_index;
          }
       }
    }
 
-   // build non-indexed data
-   
-   auto build_complete_vertex_info = [&](const face_indices& face, const int i)
-   {
-      return complete_obj_vertex_info{
-         .m_position = positions[face.m_position_indices[i]],
-         .m_normal = normals[face.m_final_normal_indices[i]]
-      };
-   };
-   for (const face_indices& face : indexed_faces)
+
+   [[nodiscard]] auto parse_obj(
+      const std::string_view contents,
+      const float max_smoothing_angle
+   ) -> complete_obj
    {
-      if (face.m_position_indices.size() == 3)
+      std::vector<glm::vec3> positions;
+      std::vector<glm::vec3> normals;
+      obj_faces faces;
+
+      // One pass, faces only keep indices until all normals are known
+      std::string_view rest = contents;
+      while (rest.empty() == false)
       {
-         result.m_vertices.push_back(build_complete_vertex_info(face, 0));
-         result.m_vertices.push_back(build_complete_vertex_info(face, 1));
-         result.m_vertices.push_back(build_complete_vertex_info(face, 2));
+         const size_t line_end = std::min(rest.find('\n'), rest.size());
+         std::string_view line = rest.substr(0, line_end);
+         rest.remove_prefix(std::min(line_end + 1, rest.size()));
+         if (line.ends_with('\r'))
+            line.remove_suffix(1);
+
+         const std::string_view keyword = pop_token(line);
+         if (keyword == "v")
+         {
+            positions.push_back(c4d_convert(0.01f * parse_vec3(line)));
+            positions.back()[1] *= -1.0f; // TODO
+         }
+         else if (keyword == "vn")
+         {
+            normals.push_back(c4d_convert(parse_vec3(line)));
+         }
+         else if (keyword == "f")
+         {
+            for (std::string_view corner = pop_token(line); corner.empty() == false; corner = pop_token(line))
+               add_face_corner(corner, faces);
+            faces.m_face_offsets.push_back(static_cast<int>(std::ssize(faces.m_position_indices)));
+         }
       }
-      else if (face.m_position_indices.size() == 4)
-      {
-         result.m_vertices.push_back(build_complete_vertex_info(face, 0));
-         result.m_vertices.push_back(build_complete_vertex_info(face, 1));
-         result.m_vertices.push_back(build_complete_vertex_info(face, 2));
 
-         result.m_vertices.push_back(build_complete_vertex_info(face, 0));
-         result.m_vertices.push_back(build_complete_vertex_info(face, 2));
-         result.m_vertices.push_back(build_complete_vertex_info(face, 3));
+      // Face normals, appended behind the ones from the file
+      for (int face = 0; face < faces.get_face_count(); ++face)
+      {
+         glm::vec3 normal{};
+         for (int corner = faces.m_face_offsets[face]; corner < faces.m_face_offsets[face + 1]; ++corner)
+            normal += normals[faces.m_normal_indices[corner]];
+         normals.push_back(glm::normalize(normal));
+         const int normal_index = static_cast<int>(std::ssize(normals)) - 1;
+         for (int corner = faces.m_face_offsets[face]; corner < faces.m_face_offsets[face + 1]; ++corner)
+            faces.m_normal_indices[corner] = normal_index;
       }
-      else
+
+      if (max_smoothing_angle > 0.0f)
+         smooth_normals(positions, max_smoothing_angle, normals, faces);
+
+      // build non-indexed data
+      complete_obj result;
+      const auto add_vertex = [&](const int corner)
+      {
+         result.m_vertices.push_back(complete_obj_vertex_info{
+            .m_position = positions[faces.m_position_indices[corner]],
+            .m_normal = normals[faces.m_normal_indices[corner]]
+         });
+      };
+      for (int face = 0; face < faces.get_face_count(); ++face)
       {
-         std::terminate();
+         const int first = faces.m_face_offsets[face];
+         const int corner_count = faces.m_face_offsets[face + 1] - first;
+         if (corner_count == 3)
+         {
+            add_vertex(first + 0);
+            add_vertex(first + 1);
+            add_vertex(first + 2);
+         }
+         else if (corner_count == 4)
+         {
+            add_vertex(first + 0);
+            add_vertex(first + 1);
+            add_vertex(first + 2);
+
+            add_vertex(first + 0);
+            add_vertex(first + 2);
+            add_vertex(first + 3);
+         }
+         else
+         {
+            std::terminate();
+         }
       }
+      result.m_vertex_bb = get_vertex_bb(result.m_vertices);
+      return result;
    }
 
-   const auto accessor = [](const complete_obj_vertex_info& in)
+} // namespace {}
+
+
+
+
+[[nodiscard]] auto sfn::get_complete_obj_info(
+   const fs::path& path,
+   const float max_smoothing_angle
+) -> complete_obj
+{
+   sfn_assert(fs::exists(path), "obj file doesn't exist");
+   return parse_obj(get_file_contents(path), max_smoothing_angle);
+}
+
+
+auto sfn::get_cooked_obj_info(
+   const fs::path& path,
+   const float max_smoothing_angle
+) -> complete_obj
+{
+   sfn_assert(fs::exists(path), "obj file doesn't exist");
+   const source_stamp stamp = get_source_stamp(path);
+   const fs::path cooked_path = get_cooked_path(path);
+   std::optional<cooked_mesh> cooked = read_cooked(cooked_path, max_smoothing_angle);
+   const auto get_cooked_result = [&]()
    {
-      return std::optional<glm::vec3>(in.m_position);
+      complete_obj result;
+      result.m_vertices = std::move(cooked->m_vertices);
+      result.m_vertex_bb = get_vertex_bb(result.m_vertices);
+      return result;
    };
-   result.m_vertex_bb = get_bb(result.m_vertices, accessor);
+   if (cooked.has_value() && cooked->m_header.m_source_stamp == stamp)
+      return get_cooked_result();
+
+   // The OBJ was touched or never cooked. If only its time changed, the hash still matches and the stamp is renewed
+   const std::string contents = get_file_contents(path);
+   const uint64_t source_hash = get_source_hash(contents, max_smoothing_angle);
+   if (cooked.has_value() && cooked->m_header.m_source_hash == source_hash)
    {
-      const glm::vec3 size = result.m_vertex_bb.get_size();
-      fmt::print(
-         "loaded {}. dimensions: {:.2f}, {:.2f}, {:.2f}",
-         path.string(), size[0], size[1], size[2]
-      );
+      write_cooked(cooked_path, max_smoothing_angle, stamp, source_hash, cooked->m_vertices);
+      return get_cooked_result();
    }
 
+   complete_obj result = parse_obj(contents, max_smoothing_angle);
+   write_cooked(cooked_path, max_smoothing_angle, stamp, source_hash, result.m_vertices);
    return result;
 }
 
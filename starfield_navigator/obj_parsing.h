@@ -18,5 +18,13 @@ namespace sfn
       const float max_smoothing_angle
    ) -> complete_obj;
 
+   // Same result, but cooked into "<path>.meshcache" after parsing. Later loads only read that as long as the OBJ's size
+   // and modification time are the ones it was cooked from. If they changed, the OBJ is read and hashed, and only
+   // parsed again if its contents changed too
+   [[nodiscard]] auto get_cooked_obj_info(
+      const fs::path& path,
+      const float max_smoothing_angle
+   ) -> complete_obj;
+
    [[nodiscard]] auto get_position_vertex_data(const complete_obj& obj_info) -> std::vector<position_vertex_data>;
 }
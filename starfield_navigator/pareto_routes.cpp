@@ -0,0 +1,210 @@
+#include "pareto_routes.h"
+
+#include <queue>
+
+#include "arena.h"
+
+
+namespace
+{
+   using namespace sfn;
+
+   struct criteria
+   {
+      int m_jump_count = 0;
+      float m_distance = 0.0f;
+      float m_max_hop = 0.0f;
+
+      [[nodiscard]] auto dominates(const criteria& other) const -> bool
+      {
+         return m_jump_count <= other.m_jump_count && m_distance <= other.m_distance && m_max_hop <= other.m_max_hop;
+      }
+   };
+
+   [[nodiscard]] auto operator<(const criteria& a, const criteria& b) -> bool
+   {
+      if (a.m_jump_count != b.m_jump_count)
+         return a.m_jump_count < b.m_jump_count;
+      if (a.m_distance != b.m_distance)
+         return a.m_distance < b.m_distance;
+      return a.m_max_hop < b.m_max_hop;
+   }
+
+   struct label
+   {
+      criteria m_cost;
+      int m_node_index;
+      int m_previous_label; // -1 at the source
+   };
+
+   struct queue_entry
+   {
+      criteria m_estimate; // cost plus the bounds to the destination
+      int m_label_index;
+
+      // Reversed for the min-heap
+      [[nodiscard]] auto operator<(const queue_entry& other) const -> bool
+      {
+         return other.m_estimate < m_estimate;
+      }
+   };
+
+   struct destination_bounds
+   {
+      std::pmr::vector<int> m_jump_counts;  // BFS hops
+      std::pmr::vector<float> m_bottleneck; // minimal longest hop
+   };
+
+   constexpr int unreachable_jumps = std::numeric_limits<int>::max();
+   constexpr float unreachable_hop = std::numeric_limits<float>::max();
+
+
+   [[nodiscard]] auto get_destination_bounds(
+      const graph& jump_graph,
+      const universe& universe,
+      const int destination_index,
+      const position_mode mode,
+      std::pmr::memory_resource* resource
+   ) -> destination_bounds
+   {
+      const int node_count = static_cast<int>(std::ssize(jump_graph.m_nodes));
+      destination_bounds result{
+         .m_jump_counts = std::pmr::vector<int>(node_count, unreachable_jumps, resource),
+         .m_bottleneck = std::pmr::vector<float>(node_count, unreachable_hop, resource)
+      };
+
+      std::pmr::vector<int> bfs_queue(resource);
+      bfs_queue.reserve(node_count);
+      bfs_queue.push_back(destination_index);
+      result.m_jump_counts[destination_index] = 0;
+      for (int i = 0; i < std::ssize(bfs_queue); ++i)
+      {
+         const int node_index = bfs_queue[i];
+         for (const int neighbor : jump_graph.m_nodes[node_index].m_neighbor_nodes)
+         {
+            if (result.m_jump_counts[neighbor] != unreachable_jumps)
+               continue;
+            result.m_jump_counts[neighbor] = result.m_jump_counts[node_index] + 1;
+            bfs_queue.push_back(neighbor);
+         }
+      }
+
+      // Minimax Dijkstra
+      using entry = std::pair<float, int>;
+      std::priority_queue<entry, std::pmr::vector<entry>, std::greater<>> queue{ std::greater<>{}, std::pmr::vector<entry>(resource) };
+      result.m_bottleneck[destination_index] = 0.0f;
+      queue.emplace(0.0f, destination_index);
+      while (queue.empty() == false)
+      {
+         const auto [bottleneck, node_index] = queue.top();
+         queue.pop();
+         if (bottleneck > result.m_bottleneck[node_index])
+            continue;
+         for (const int neighbor : jump_graph.m_nodes[node_index].m_neighbor_nodes)
+         {
+            const float candidate = std::max(bottleneck, universe.get_distance(node_index, neighbor, mode));
+            if (candidate >= result.m_bottleneck[neighbor])
+               continue;
+            result.m_bottleneck[neighbor] = candidate;
+            queue.emplace(candidate, neighbor);
+         }
+      }
+      return result;
+   }
+
+} // namespace {}
+
+
+auto sfn::get_pareto_routes(
+   const graph& jump_graph,
+   const universe& universe,
+   const int source_index,
+   const int destination_index,
+   const position_mode mode
+) -> std::vector<pareto_route>
+{
+   const arena_scope scope;
+   std::pmr::memory_resource* resource = scope.get_resource();
+
+   const destination_bounds bounds = get_destination_bounds(jump_graph, universe, destination_index, mode, resource);
+   if (bounds.m_jump_counts[source_index] == unreachable_jumps)
+      return {};
+
+   // All three bounds are consistent, so estimates never decrease along a path and the lexicographic order makes
+   // every label that survives popping final
+   const auto get_estimate = [&](const label& l) {
+      return criteria{
+         .m_jump_count = l.m_cost.m_jump_count + bounds.m_jump_counts[l.m_node_index],
+         .m_distance = l.m_cost.m_distance + universe.get_distance(l.m_node_index, destination_index, mode),
+         .m_max_hop = std::max(l.m_cost.m_max_hop, bounds.m_bottleneck[l.m_node_index])
+      };
+   };
+
+   std::pmr::vector<label> labels(resource);
+   std::pmr::vector<std::pmr::vector<int>> settled(jump_graph.m_nodes.size(), resource);
+   std::priority_queue<queue_entry, std::pmr::vector<queue_entry>> queue{ std::less<queue_entry>{}, std::pmr::vector<queue_entry>(resource) };
+
+   const auto is_dominated = [&](const int node_index, const criteria& cost) {
+      const auto pred = [&](const int label_index) { return labels[label_index].m_cost.dominates(cost); };
+      return std::ranges::any_of(settled[node_index], pred);
+   };
+
+   labels.push_back(label{ .m_cost = criteria{}, .m_node_index = source_index, .m_previous_label = -1 });
+   queue.push(queue_entry{ .m_estimate = get_estimate(labels.back()), .m_label_index = 0 });
+   while (queue.empty() == false)
+   {
+      const queue_entry top = queue.top();
+      queue.pop();
+      const label current = labels[top.m_label_index];
+      if (is_dominated(current.m_node_index, current.m_cost))
+         continue;
+      // No completion can beat a route that's already found
+      if (is_dominated(destination_index, top.m_estimate))
+         continue;
+      settled[current.m_node_index].push_back(top.m_label_index);
+      if (current.m_node_index == destination_index)
+         continue;
+
+      for (const int neighbor : jump_graph.m_nodes[current.m_node_index].m_neighbor_nodes)
+      {
+         if (bounds.m_jump_counts[neighbor] == unreachable_jumps)
+            continue;
+         const float hop = universe.get_distance(current.m_node_index, neighbor, mode);
+         const label next{
+            .m_cost = criteria{
+               .m_jump_count = current.m_cost.m_jump_count + 1,
+               .m_distance = current.m_cost.m_distance + hop,
+               .m_max_hop = std::max(current.m_cost.m_max_hop, hop)
+            },
+            .m_node_index = neighbor,
+            .m_previous_label = top.m_label_index
+         };
+         const criteria estimate = get_estimate(next);
+         if (is_dominated(neighbor, next.m_cost) || is_dominated(destination_index, estimate))
+            continue;
+         labels.push_back(next);
+         queue.push(queue_entry{ .m_estimate = estimate, .m_label_index = static_cast<int>(std::ssize(labels)) - 1 });
+      }
+   }
+
+   std::vector<pareto_route> result;
+   for (const int label_index : settled[destination_index])
+   {
+      const label& end = labels[label_index];
+      pareto_route route{
+         .m_path = jump_path{ .m_stops = std::pmr::vector<int>(std::pmr::get_default_resource()) },
+         .m_jump_count = end.m_cost.m_jump_count,
+         .m_total_distance = end.m_cost.m_distance,
+         .m_max_hop = end.m_cost.m_max_hop
+      };
+      for (int i = label_index; i != -1; i = labels[i].m_previous_label)
+         route.m_path.m_stops.push_back(labels[i].m_node_index);
+      std::ranges::reverse(route.m_path.m_stops);
+      result.push_back(std::move(route));
+   }
+   const auto pred = [](const pareto_route& a, const pareto_route& b) {
+      return std::pair(a.m_jump_count, a.m_total_distance) < std::pair(b.m_jump_count, b.m_total_distance);
+   };
+   std::ranges::sort(result, pred);
+   return result;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include "graph.h"
+#include "universe.h"
+
+
+namespace sfn
+{
+   struct pareto_route
+   {
+      jump_path m_path;
+      int m_jump_count;
+      float m_total_distance;
+      float m_max_hop;
+   };
+
+   // All routes that aren't beaten in jump count, total distance and longest hop at once, sorted by jump count.
+   // Label-setting search in lexicographic order, pruned with lower bounds towards the destination: hop counts,
+   // straight-line distance and the bottleneck (minimal longest hop)
+   [[nodiscard]] auto get_pareto_routes(const graph& jump_graph, const universe& universe, const int source_index, const int destination_index, const position_mode mode) -> std::vector<pareto_route>;
+}
@@ -0,0 +1,167 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+#pragma warning(push, 0)
+#include <fmt/format.h>
+#pragma warning(pop)
+
+
+namespace
+{
+   using namespace sfn;
+
+   const auto profile_epoch = std::chrono::steady_clock::now();
+
+   // Rings live until the end of the program, so events of finished threads can still be read
+   std::mutex rings_mutex;
+   std::vector<std::unique_ptr<profile_ring>> rings;
+
+   [[nodiscard]] auto get_thread_ring() -> profile_ring&
+   {
+      thread_local profile_ring* ring = nullptr;
+      if (ring == nullptr)
+      {
+         std::lock_guard lock(rings_mutex);
+         rings.push_back(std::make_unique<profile_ring>());
+         ring = rings.back().get();
+         ring->m_thread_index = static_cast<int>(std::ssize(rings)) - 1;
+      }
+      return *ring;
+   }
+
+
+   [[nodiscard]] auto get_json_escaped(const std::string_view str) -> std::string
+   {
+      std::string result;
+      for (const char c : str)
+      {
+         if (c == '"' || c == '\\')
+            result += '\\';
+         result += c;
+      }
+      return result;
+   }
+
+} // namespace {}
+
+
+auto sfn::profile_ring::push(
+   const profile_zone& zone,
+   const int64_t begin_ns,
+   const int64_t end_ns,
+   const int depth
+) -> void
+{
+   // Seqlock order: announce the slot, write it, then commit. Readers check the announced count afterwards
+   const uint64_t index = m_begun_count.load(std::memory_order_relaxed);
+   m_begun_count.store(index + 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+
+   slot& target = m_slots[index % capacity];
+   target.m_zone.store(&zone, std::memory_order_relaxed);
+   target.m_begin_ns.store(begin_ns, std::memory_order_relaxed);
+   target.m_end_ns.store(end_ns, std::memory_order_relaxed);
+   target.m_depth.store(depth, std::memory_order_relaxed);
+   m_committed_count.store(index + 1, std::memory_order_release);
+}
+
+
+auto sfn::profile_ring::append_events(
+   const int64_t since_ns,
+   std::vector<profile_event>& out
+) const -> void
+{
+   const uint64_t committed = m_committed_count.load(std::memory_order_acquire);
+   const uint64_t first = committed > capacity ? committed - capacity : 0;
+   const size_t out_begin = out.size();
+   uint64_t first_appended = committed;
+   for (uint64_t i = first; i < committed; ++i)
+   {
+      const slot& source = m_slots[i % capacity];
+      if (source.m_end_ns.load(std::memory_order_relaxed) < since_ns)
+         continue;
+      first_appended = std::min(first_appended, i);
+      out.push_back(profile_event{
+         .m_zone = source.m_zone.load(std::memory_order_relaxed),
+         .m_begin_ns = source.m_begin_ns.load(std::memory_order_relaxed),
+         .m_end_ns = source.m_end_ns.load(std::memory_order_relaxed),
+         .m_depth = source.m_depth.load(std::memory_order_relaxed),
+         .m_thread_index = m_thread_index
+      });
+   }
+
+   // Slots the writer started on since then may be torn. Events are pushed in end order, so everything appended
+   // after the first one is contiguous
+   std::atomic_thread_fence(std::memory_order_acquire);
+   const uint64_t begun = m_begun_count.load(std::memory_order_relaxed);
+   const uint64_t first_valid = begun > capacity ? begun - capacity : 0;
+   if (first_valid > first_appended)
+   {
+      const size_t torn_count = std::min<size_t>(first_valid - first_appended, out.size() - out_begin);
+      out.erase(std::begin(out) + out_begin, std::begin(out) + out_begin + torn_count);
+   }
+}
+
+
+auto sfn::get_profile_time_ns() -> int64_t
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profile_epoch).count();
+}
+
+
+sfn::scoped_zone::scoped_zone(const profile_zone& zone)
+   : m_zone(zone)
+   , m_ring(get_thread_ring())
+   , m_begin_ns(get_profile_time_ns())
+{
+   ++m_ring.m_depth;
+}
+
+
+sfn::scoped_zone::~scoped_zone()
+{
+   --m_ring.m_depth;
+   m_ring.push(m_zone, m_begin_ns, get_profile_time_ns(), m_ring.m_depth);
+}
+
+
+auto sfn::get_profile_events(const int64_t since_ns) -> std::vector<profile_event>
+{
+   std::vector<profile_event> result;
+   {
+      std::lock_guard lock(rings_mutex);
+      for (const std::unique_ptr<profile_ring>& ring : rings)
+         ring->append_events(since_ns, result);
+   }
+   std::ranges::sort(result, {}, &profile_event::m_begin_ns);
+   return result;
+}
+
+
+auto sfn::write_chrome_trace(const std::string& path) -> bool
+{
+   std::ofstream file(path);
+   if (file.is_open() == false)
+      return false;
+
+   file << "{\"traceEvents\":[\n";
+   bool first = true;
+   for (const profile_event& event : get_profile_events())
+   {
+      if (first == false)
+         file << ",\n";
+      first = false;
+      file << fmt::format(
+         R"({{"name":"{}","cat":"{}:{}","ph":"X","pid":0,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+         get_json_escaped(event.m_zone->m_name), get_json_escaped(event.m_zone->m_file), event.m_zone->m_line,
+         event.m_thread_index, event.m_begin_ns / 1000.0, (event.m_end_ns - event.m_begin_ns) / 1000.0
+      );
+   }
+   file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+   return file.good();
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Zones cost two clock reads and a ring buffer write. Define SFN_PROFILER as 0 to compile them out entirely
+#ifndef SFN_PROFILER
+#define SFN_PROFILER 1
+#endif
+
+
+namespace sfn
+{
+   // One per call site, static
+   struct profile_zone
+   {
+      const char* m_name;
+      const char* m_file;
+      int m_line;
+   };
+
+   struct profile_event
+   {
+      const profile_zone* m_zone;
+      int64_t m_begin_ns;
+      int64_t m_end_ns;
+      int m_depth;        // nesting level on its thread
+      int m_thread_index; // in order of the first zone on each thread
+   };
+
+   // Written by its thread only. Readers copy out without locking and drop whatever the writer may have overwritten
+   // in the meantime
+   struct profile_ring
+   {
+      static constexpr inline int capacity = 1 << 14;
+
+      struct slot
+      {
+         std::atomic<const profile_zone*> m_zone = nullptr;
+         std::atomic<int64_t> m_begin_ns = 0;
+         std::atomic<int64_t> m_end_ns = 0;
+         std::atomic<int> m_depth = 0;
+      };
+      std::array<slot, capacity> m_slots;
+      std::atomic<uint64_t> m_begun_count = 0;
+      std::atomic<uint64_t> m_committed_count = 0;
+      int m_thread_index = 0;
+      int m_depth = 0;
+
+      auto push(const profile_zone& zone, const int64_t begin_ns, const int64_t end_ns, const int depth) -> void;
+      auto append_events(const int64_t since_ns, std::vector<profile_event>& out) const -> void;
+   };
+
+   // Nanoseconds since the profiler's epoch
+   [[nodiscard]] auto get_profile_time_ns() -> int64_t;
+
+   struct scoped_zone
+   {
+      explicit scoped_zone(const profile_zone& zone);
+      ~scoped_zone();
+      scoped_zone(const scoped_zone&) = delete;
+      scoped_zone& operator=(const scoped_zone&) = delete;
+
+   private:
+      const profile_zone& m_zone;
+      profile_ring& m_ring;
+      int64_t m_begin_ns;
+   };
+
+   // Events still in the rings of all threads that ended after since_ns, sorted by begin time
+   [[nodiscard]] auto get_profile_events(const int64_t since_ns = 0) -> std::vector<profile_event>;
+
+   // chrome://tracing and Perfetto format
+   [[nodiscard]] auto write_chrome_trace(const std::string& path) -> bool;
+}
+
+
+#define SFN_PROFILE_CONCAT_IMPL(a, b) a##b
+#define SFN_PROFILE_CONCAT(a, b) SFN_PROFILE_CONCAT_IMPL(a, b)
+
+#if SFN_PROFILER
+#define SFN_PROFILE_ZONE(name) \
+   static constexpr ::sfn::profile_zone SFN_PROFILE_CONCAT(sfn_profile_zone_, __LINE__){ name, __FILE__, __LINE__ }; \
+   const ::sfn::scoped_zone SFN_PROFILE_CONCAT(sfn_scoped_zone_, __LINE__)(SFN_PROFILE_CONCAT(sfn_profile_zone_, __LINE__))
+#else
+#define SFN_PROFILE_ZONE(name)
+#endif
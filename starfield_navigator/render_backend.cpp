@@ -0,0 +1,44 @@
+#include "render_backend.h"
+
+#include <cstring>
+
+#include "tools.h"
+
+
+static_assert(sfn::render_backend<sfn::null_backend>);
+
+
+namespace
+{
+   template<typename T>
+   auto append_bytes(std::vector<std::byte>& staging, const T& data) -> void
+   {
+      const auto bytes = sfn::as_bytes(data);
+      const size_t offset = staging.size();
+      staging.resize(offset + bytes.size());
+      if (bytes.empty() == false)
+         std::memcpy(staging.data() + offset, bytes.data(), bytes.size());
+   }
+} // namespace {}
+
+
+auto sfn::null_backend::upload(const frame_description& frame) -> void
+{
+   m_staging.clear();
+   append_bytes(m_staging, frame.m_view);
+   append_bytes(m_staging, frame.m_projection);
+   append_bytes(m_staging, frame.m_cam_pos);
+   append_bytes(m_staging, frame.m_selected_system_pos);
+   append_bytes(m_staging, frame.m_bb_trafos);
+   append_bytes(m_staging, frame.m_connection_trafos);
+   append_bytes(m_staging, frame.m_stars);
+   append_bytes(m_staging, frame.m_jump_lines);
+   append_bytes(m_staging, frame.m_indicator);
+   m_uploaded_bytes += std::ssize(m_staging);
+}
+
+
+auto sfn::null_backend::draw(const frame_description& frame) -> void
+{
+   m_instance_count += std::ssize(frame.m_stars) + std::ssize(frame.m_bb_trafos) + std::ssize(frame.m_connection_trafos);
+}
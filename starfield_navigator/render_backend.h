@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "camera_replay.h"
+#include "frame_description.h"
+
+
+namespace sfn
+{
+   // Uploads the per-frame data, then draws it. Labels are left to the caller, they go through ImGui
+   template<typename T>
+   concept render_backend = requires(T& backend, const frame_description& frame)
+   {
+      backend.upload(frame);
+      backend.draw(frame);
+   };
+
+   // Packs the frame like the GL backend does but never touches a GPU, so the CPU side of a frame can run and be
+   // profiled without a context
+   struct null_backend
+   {
+      std::vector<std::byte> m_staging;
+      int64_t m_uploaded_bytes = 0;
+      int64_t m_instance_count = 0;
+
+      auto upload(const frame_description& frame) -> void;
+      auto draw(const frame_description& frame) -> void;
+   };
+
+   template<render_backend T>
+   auto submit_frame(T& backend, const frame_description& frame, replay_frame* timings) -> void
+   {
+      {
+         scoped_phase_timer timer(timings, replay_phase::upload);
+         backend.upload(frame);
+      }
+      backend.draw(frame);
+   }
+}
@@ -0,0 +1,160 @@
+#include "route_cache.h"
+
+
+namespace
+{
+   using namespace sfn;
+
+   [[nodiscard]] auto get_combined_hash(const size_t seed, const size_t value) -> size_t
+   {
+      return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+   }
+
+} // namespace {}
+
+
+auto sfn::cache_stats::get_hit_rate() const -> double
+{
+   const int64_t total = m_hits + m_misses;
+   if (total == 0)
+      return 0.0;
+   return static_cast<double>(m_hits) / static_cast<double>(total);
+}
+
+
+auto sfn::route_query_hash::operator()(const route_query& query) const -> size_t
+{
+   size_t result = std::hash<uint64_t>{}(query.m_generation);
+   result = get_combined_hash(result, std::hash<int>{}(query.m_source_index));
+   result = get_combined_hash(result, std::hash<int>{}(query.m_destination_index));
+   result = get_combined_hash(result, std::hash<float>{}(query.m_jump_range));
+   result = get_combined_hash(result, std::hash<int>{}(static_cast<int>(query.m_mode)));
+   return result;
+}
+
+
+sfn::route_cache::route_cache(const int capacity)
+   : m_min_jump_cache(capacity)
+   , m_route_cache(capacity)
+{
+
+}
+
+
+auto sfn::route_cache::get_min_jump_dist(
+   const universe& universe,
+   const int source_index,
+   const int destination_index,
+   const position_mode mode
+) -> float
+{
+   const route_query query{
+      .m_generation = universe.m_generation,
+      .m_source_index = source_index,
+      .m_destination_index = destination_index,
+      .m_jump_range = 0.0f,
+      .m_mode = mode
+   };
+   {
+      std::lock_guard lock(m_mutex);
+      if (const std::optional<float> cached = m_min_jump_cache.find(query); cached.has_value())
+         return *cached;
+   }
+
+   const float result = sfn::get_min_jump_dist(universe, source_index, destination_index, mode);
+   std::lock_guard lock(m_mutex);
+   m_min_jump_cache.insert(query, result);
+   return result;
+}
+
+
+auto sfn::route_cache::get_route(
+   const universe& universe,
+   const int source_index,
+   const int destination_index,
+   const float jump_range,
+   const position_mode mode
+) -> std::optional<jump_path>
+{
+   const route_query query{
+      .m_generation = universe.m_generation,
+      .m_source_index = source_index,
+      .m_destination_index = destination_index,
+      .m_jump_range = jump_range,
+      .m_mode = mode
+   };
+   if (std::optional<std::optional<jump_path>> cached = find_route(query); cached.has_value())
+      return std::move(*cached);
+
+   std::optional<jump_path> result = sfn::get_route(universe, source_index, destination_index, jump_range, mode);
+   insert_route(query, result);
+   return result;
+}
+
+
+auto sfn::route_cache::get_route(
+   const universe& universe,
+   const graph& jump_graph,
+   const int source_index,
+   const int destination_index,
+   const position_mode mode
+) -> std::optional<jump_path>
+{
+   const route_query query{
+      .m_generation = universe.m_generation,
+      .m_source_index = source_index,
+      .m_destination_index = destination_index,
+      .m_jump_range = jump_graph.m_jump_range,
+      .m_mode = mode
+   };
+   if (std::optional<std::optional<jump_path>> cached = find_route(query); cached.has_value())
+      return std::move(*cached);
+
+   const auto distance_getter = [&](const int i, const int j) {return universe.get_distance(i, j, mode); };
+   std::optional<jump_path> result = jump_graph.get_jump_path(source_index, destination_index, distance_getter);
+   insert_route(query, result);
+   return result;
+}
+
+
+auto sfn::route_cache::find_route(const route_query& query) -> std::optional<std::optional<jump_path>>
+{
+   std::lock_guard lock(m_mutex);
+   return m_route_cache.find(query);
+}
+
+
+auto sfn::route_cache::insert_route(const route_query& query, const std::optional<jump_path>& route) -> void
+{
+   std::lock_guard lock(m_mutex);
+   m_route_cache.insert(query, route);
+}
+
+
+auto sfn::route_cache::get_min_jump_stats() const -> cache_stats
+{
+   std::lock_guard lock(m_mutex);
+   return m_min_jump_cache.get_stats();
+}
+
+
+auto sfn::route_cache::get_route_stats() const -> cache_stats
+{
+   std::lock_guard lock(m_mutex);
+   return m_route_cache.get_stats();
+}
+
+
+auto sfn::route_cache::clear() -> void
+{
+   std::lock_guard lock(m_mutex);
+   m_min_jump_cache.clear();
+   m_route_cache.clear();
+}
+
+
+auto sfn::get_route_cache() -> route_cache&
+{
+   static route_cache cache(256);
+   return cache;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include "graph.h"
+#include "universe.h"
+
+
+namespace sfn
+{
+   struct cache_stats
+   {
+      int64_t m_hits = 0;
+      int64_t m_misses = 0;
+
+      [[nodiscard]] auto get_hit_rate() const -> double;
+   };
+
+   // Bounded map that evicts the least recently used entry
+   template<typename key_type, typename value_type, typename hash_type>
+   struct lru_cache
+   {
+      explicit lru_cache(const int capacity);
+
+      [[nodiscard]] auto find(const key_type& key) -> std::optional<value_type>;
+      auto insert(const key_type& key, const value_type& value) -> void;
+      auto clear() -> void;
+      [[nodiscard]] auto get_stats() const -> const cache_stats&;
+
+   private:
+      using entry = std::pair<key_type, value_type>;
+      int m_capacity;
+      std::list<entry> m_entries; // most recent first
+      std::unordered_map<key_type, typename std::list<entry>::iterator, hash_type> m_lookup;
+      cache_stats m_stats;
+   };
+
+   // The generation makes entries of older universe states unreachable
+   struct route_query
+   {
+      uint64_t m_generation;
+      int m_source_index;
+      int m_destination_index;
+      float m_jump_range; // unused for min jump queries
+      position_mode m_mode;
+
+      friend auto operator==(const route_query&, const route_query&) -> bool = default;
+   };
+
+   struct route_query_hash
+   {
+      [[nodiscard]] auto operator()(const route_query& query) const -> size_t;
+   };
+
+   // Shared by the GUI and the console commands. Misses are computed outside the lock
+   struct route_cache
+   {
+      explicit route_cache(const int capacity);
+
+      [[nodiscard]] auto get_min_jump_dist(const universe& universe, const int source_index, const int destination_index, const position_mode mode) -> float;
+      [[nodiscard]] auto get_route(const universe& universe, const int source_index, const int destination_index, const float jump_range, const position_mode mode) -> std::optional<jump_path>;
+      // Misses route through the given graph instead of building one for its jump range
+      [[nodiscard]] auto get_route(const universe& universe, const graph& jump_graph, const int source_index, const int destination_index, const position_mode mode) -> std::optional<jump_path>;
+      [[nodiscard]] auto get_min_jump_stats() const -> cache_stats;
+      [[nodiscard]] auto get_route_stats() const -> cache_stats;
+      auto clear() -> void;
+
+   private:
+      mutable std::mutex m_mutex;
+      lru_cache<route_query, float, route_query_hash> m_min_jump_cache;
+      lru_cache<route_query, std::optional<jump_path>, route_query_hash> m_route_cache;
+
+      [[nodiscard]] auto find_route(const route_query& query) -> std::optional<std::optional<jump_path>>;
+      auto insert_route(const route_query& query, const std::optional<jump_path>& route) -> void;
+   };
+
+   [[nodiscard]] auto get_route_cache() -> route_cache&;
+}
+
+
+template<typename key_type, typename value_type, typename hash_type>
+sfn::lru_cache<key_type, value_type, hash_type>::lru_cache(const int capacity)
+   : m_capacity(capacity)
+{
+   m_lookup.reserve(capacity);
+}
+
+
+template<typename key_type, typename value_type, typename hash_type>
+auto sfn::lru_cache<key_type, value_type, hash_type>::find(const key_type& key) -> std::optional<value_type>
+{
+   const auto it = m_lookup.find(key);
+   if (it == std::end(m_lookup))
+   {
+      ++m_stats.m_misses;
+      return std::nullopt;
+   }
+   ++m_stats.m_hits;
+   m_entries.splice(std::begin(m_entries), m_entries, it->second);
+   return it->second->second;
+}
+
+
+template<typename key_type, typename value_type, typename hash_type>
+auto sfn::lru_cache<key_type, value_type, hash_type>::insert(const key_type& key, const value_type& value) -> void
+{
+   const auto it = m_lookup.find(key);
+   if (it != std::end(m_lookup))
+   {
+      it->second->second = value;
+      m_entries.splice(std::begin(m_entries), m_entries, it->second);
+      return;
+   }
+   if (std::ssize(m_entries) >= m_capacity)
+   {
+      m_lookup.erase(m_entries.back().first);
+      m_entries.pop_back();
+   }
+   m_entries.emplace_front(key, value);
+   m_lookup.emplace(key, std::begin(m_entries));
+}
+
+
+template<typename key_type, typename value_type, typename hash_type>
+auto sfn::lru_cache<key_type, value_type, hash_type>::clear() -> void
+{
+   m_entries.clear();
+   m_lookup.clear();
+}
+
+
+template<typename key_type, typename value_type, typename hash_type>
+auto sfn::lru_cache<key_type, value_type, hash_type>::get_stats() const -> const cache_stats&
+{
+   return m_stats;
+}
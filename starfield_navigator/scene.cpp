@@ -0,0 +1,542 @@
+#include "scene.h"
+
+#include "profiler.h"
+
+#pragma warning(push, 0)
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/vector_angle.hpp>
+#pragma warning(pop)
+
+
+namespace
+{
+   using namespace sfn;
+
+
+   // written so it yields (0, -1, 0) for 0, 0, 1 parameters, which is how the geometry is set up
+   [[nodiscard]] auto get_cartesian_from_spherical(
+      const float phi_offset,
+      const float theta,
+      const float r,
+      const cs& cs
+   ) -> glm::vec3
+   {
+      const float phi = -std::numbers::pi_v<float> / 2 + phi_offset;
+      const float equation_theta = -theta + std::numbers::pi_v<float> / 2.0f;
+      const float x = r * std::cos(phi) * std::sin(equation_theta);
+      const float y = r * std::sin(phi) * std::sin(equation_theta);
+      const float z = r * std::cos(equation_theta);
+      return glm::vec3{} + x * cs.m_right + y * cs.m_front + z * cs.m_up;
+   }
+
+
+   template<is_alternative<projection_params> T>
+   [[nodiscard]] auto get_projection_matrix_impl(const glm::ivec2& resolution, const T& param) -> glm::mat4
+   {
+      const float aspect = static_cast<float>(resolution.x) / resolution.y;
+      if constexpr (std::same_as<T, perspective_params>)
+      {
+         constexpr float x_fov = glm::radians(60.0f);
+         const float y_fov = x_fov / aspect;
+         return glm::perspective(y_fov, aspect, 0.1f, 3000.0f);
+      }
+      else if constexpr (std::same_as<T, ortho_params>)
+      {
+         const float frustum_width = param.width;
+         return glm::ortho(
+            -0.5f * frustum_width,
+            0.5f * frustum_width,
+            -0.5f * frustum_width/ aspect,
+            0.5f * frustum_width/ aspect,
+            0.0f,
+            500.0f
+         );
+      }
+   }
+
+
+   [[nodiscard]] auto get_bb_mesh(
+      const bb_3D& old_coord_bb,
+      const glm::mat4& trafo
+   ) -> std::vector<glm::vec3>
+   {
+      const auto forward = [&](const glm::vec3& in) {
+         return apply_trafo(trafo, in);
+      };
+
+      const glm::vec3 bottom_p0 = old_coord_bb.m_min + glm::vec3{ 0, 0, 0 } *old_coord_bb.get_size();
+      const glm::vec3 bottom_p1 = old_coord_bb.m_min + glm::vec3{ 1, 0, 0 } *old_coord_bb.get_size();
+      const glm::vec3 bottom_p2 = old_coord_bb.m_min + glm::vec3{ 1, 1, 0 } *old_coord_bb.get_size();
+      const glm::vec3 bottom_p3 = old_coord_bb.m_min + glm::vec3{ 0, 1, 0 } *old_coord_bb.get_size();
+      const glm::vec3 top_p0 = old_coord_bb.m_min + glm::vec3{ 0, 0, 1 } *old_coord_bb.get_size();
+      const glm::vec3 top_p1 = old_coord_bb.m_min + glm::vec3{ 1, 0, 1 } *old_coord_bb.get_size();
+      const glm::vec3 top_p2 = old_coord_bb.m_min + glm::vec3{ 1, 1, 1 } *old_coord_bb.get_size();
+      const glm::vec3 top_p3 = old_coord_bb.m_min + glm::vec3{ 0, 1, 1 } *old_coord_bb.get_size();
+
+
+      std::vector<glm::vec3> result;
+      result.reserve(24);
+
+      // bottom
+      result.push_back(forward(bottom_p0));
+      result.push_back(forward(bottom_p1));
+      result.push_back(forward(bottom_p1));
+      result.push_back(forward(bottom_p2));
+      result.push_back(forward(bottom_p2));
+      result.push_back(forward(bottom_p3));
+      result.push_back(forward(bottom_p3));
+      result.push_back(forward(bottom_p0));
+
+      // top
+      result.push_back(forward(top_p0));
+      result.push_back(forward(top_p1));
+      result.push_back(forward(top_p1));
+      result.push_back(forward(top_p2));
+      result.push_back(forward(top_p2));
+      result.push_back(forward(top_p3));
+      result.push_back(forward(top_p3));
+      result.push_back(forward(top_p0));
+
+      // connections
+      result.push_back(forward(bottom_p0));
+      result.push_back(forward(top_p0));
+      result.push_back(forward(bottom_p1));
+      result.push_back(forward(top_p1));
+      result.push_back(forward(bottom_p2));
+      result.push_back(forward(top_p2));
+      result.push_back(forward(bottom_p3));
+      result.push_back(forward(top_p3));
+
+      return result;
+   }
+
+
+   struct mouse_movement_visitor
+   {
+      glm::vec2 m_mouse_movement;
+
+      template<typename T>
+      auto operator()([[maybe_unused]] T& alternative) -> void
+      {
+
+      }
+
+      template<centery T>
+      auto operator()(T& alternative) -> void
+      {
+         alternative.horiz_angle_offset += -0.005f * m_mouse_movement[0];
+         alternative.vert_angle_offset += 0.005f * m_mouse_movement[1];
+      }
+   };
+
+
+   auto add_compass_labels(
+      const glm::vec3& system_pos,
+      const glm::mat4& view_projection,
+      frame_description& frame
+   ) -> void
+   {
+      constexpr float dist_from_center = 1.1f;
+      constexpr glm::vec4 color{ 1, 0, 0, 1 };
+      const auto add = [&](const char* text, const glm::vec3& direction) {
+         const std::optional<glm::vec2> screen_pos = get_screen_pos(view_projection, frame.m_resolution, system_pos + dist_from_center * direction);
+         if (screen_pos.has_value())
+            frame.m_labels.push_back(frame_label{ .m_text = text, .m_screen_pos = *screen_pos, .m_center_offset = glm::vec2{}, .m_color = color });
+      };
+      add("0", glm::vec3{ 1, 0, 0 });
+      add("90", glm::vec3{ 0, 1, 0 });
+      add("180", glm::vec3{ -1, 0, 0 });
+      add("270", glm::vec3{ 0, -1, 0 });
+   }
+
+
+   auto add_system_labels(
+      const universe& univ,
+      const frame_settings& settings,
+      const glm::mat4& view_projection,
+      replay_frame* timings,
+      frame_description& frame
+   ) -> void
+   {
+      SFN_PROFILE_ZONE("system labels");
+      thread_local std::vector<int> visible;
+      thread_local std::vector<label_placement> placements;
+      {
+         scoped_phase_timer timer(timings, replay_phase::culling);
+         cull_systems(univ, settings.m_position_mode, view_projection, visible);
+      }
+      {
+         scoped_phase_timer timer(timings, replay_phase::label_projection);
+         project_labels(univ, settings.m_position_mode, view_projection, glm::vec2{ settings.m_resolution }, frame.m_cam_pos, visible, placements);
+      }
+      for (const label_placement& placement : placements)
+      {
+         const sfn::system& system = univ.m_systems[placement.m_system_index];
+         const float pointsize = 500 / placement.m_distance;
+         const float planet_radius = 0.5f * pointsize;
+         constexpr float label_opacity = 0.8f;
+         constexpr glm::vec4 normal_color{ 1, 1, 1, label_opacity };
+         constexpr glm::vec4 speculation_color{ 1, 0.6, 0.95, label_opacity };
+         glm::vec4 color = system.get_starfield_name().has_value() ? normal_color : speculation_color;
+         if (system.m_speculative)
+            color = glm::vec4{ 1, 1, 0, 1 };
+         frame.m_labels.push_back(frame_label{
+            .m_text = system.get_useful_name().value(),
+            .m_screen_pos = placement.m_screen_pos,
+            .m_center_offset = glm::vec2{ 0, planet_radius + 8.0f },
+            .m_color = color
+         });
+      }
+   }
+
+
+   // Stars bucketed by their size on screen, culled ones dropped
+   auto add_star_lods(
+      const universe& univ,
+      const scene& scene,
+      const frame_settings& settings,
+      frame_description& frame
+   ) -> void
+   {
+      SFN_PROFILE_ZONE("star lods");
+      constexpr float star_radius = 0.3f; // the scale in star_shader.vert
+      const point_span positions = univ.m_arrays.get_positions(settings.m_position_mode).get_span();
+      const int count = static_cast<int>(std::min(std::ssize(scene.m_stars), static_cast<std::ptrdiff_t>(positions.m_count)));
+
+      thread_local std::vector<uint8_t> levels;
+      thread_local lod_buckets buckets;
+      levels.resize(count);
+      const lod_projection projection = get_lod_projection(frame.m_projection, frame.m_view, static_cast<float>(settings.m_resolution.y), star_radius);
+      get_lod_levels(projection, positions.get_subspan(0, count), lod_thresholds{}, levels.data());
+      bucket_by_level(levels, buckets);
+
+      const int visible_count = buckets.m_offsets[culled_level];
+      frame.m_stars.resize(visible_count);
+      frame.m_selected_index = -1;
+      for (int i = 0; i < visible_count; ++i)
+      {
+         const int star_index = buckets.m_indices[i];
+         frame.m_stars[i] = scene.m_stars[star_index];
+         if (star_index == settings.m_selection)
+            frame.m_selected_index = i;
+      }
+      std::copy_n(std::cbegin(buckets.m_offsets), frame.m_star_lod_offsets.size(), std::begin(frame.m_star_lod_offsets));
+   }
+
+} // namespace {}
+
+
+auto sfn::get_camera_cs(const cam_info& info, const camera_mode& mode) -> cs
+{
+   if(std::holds_alternative<galactic_circle_mode>(mode))
+   {
+      return cs(glm::vec3{ 0, 1, 0 }, glm::vec3{ 0, 0, 1 });
+   }
+   else
+   {
+      return info.m_cs;
+   }
+}
+
+
+auto sfn::get_camera_pos(
+   const universe& univ,
+   const position_mode pos_mode,
+   const camera_mode& mode
+) -> glm::vec3
+{
+   const auto visitor = [&]<typename T>(const T& alternative) -> glm::vec3{
+      if constexpr(std::same_as<T, wasd_mode>)
+      {
+         return alternative.m_camera_pos;
+      }
+      else if constexpr (std::same_as<T, trailer_mode>)
+      {
+         return glm::mix(univ.m_cam_info.m_cam_pos0, univ.m_cam_info.m_cam_pos1, alternative.m_progress);
+      }
+      else if constexpr (std::same_as<T, replay_mode>)
+      {
+         return alternative.m_path->get_pose(alternative.m_frame).m_pos;
+      }
+      else if constexpr (centery<T>)
+      {
+         const glm::vec3 offset = get_cartesian_from_spherical(alternative.horiz_angle_offset, alternative.vert_angle_offset, alternative.distance, get_camera_cs(univ.m_cam_info, mode));
+         return univ.m_systems[alternative.m_planet].get_position(pos_mode) + offset;
+      }
+   };
+   return std::visit(visitor, mode);
+}
+
+
+auto sfn::get_camera_target(
+   const universe& univ,
+   const position_mode pos_mode,
+   const camera_mode& mode
+) -> glm::vec3
+{
+   const auto visitor = [&]<typename T>(const T& alternative) {
+      if constexpr(centery<T>)
+         return univ.m_systems[alternative.m_planet].get_position(pos_mode);
+      else if constexpr(std::same_as<T, wasd_mode> || std::same_as<T, trailer_mode>)
+         return get_camera_pos(univ, pos_mode, mode) + univ.m_cam_info.m_cs.m_front;
+      else if constexpr(std::same_as<T, replay_mode>)
+         return alternative.m_path->get_pose(alternative.m_frame).m_target;
+   };
+   return std::visit(visitor, mode);
+}
+
+
+auto sfn::get_view_matrix(
+   const universe& univ,
+   const position_mode pos_mode,
+   const camera_mode& mode
+) -> glm::mat4
+{
+   glm::vec3 up_vector = univ.m_cam_info.m_cs.m_up;
+   if(std::holds_alternative<galactic_circle_mode>(mode))
+   {
+      up_vector = glm::vec3{ 0, 0, 1 };
+   }
+
+   return glm::lookAt(
+      get_camera_pos(univ, pos_mode, mode),
+      get_camera_target(univ, pos_mode, mode),
+      up_vector
+   );
+}
+
+
+auto sfn::get_projection_matrix(
+   const glm::ivec2& resolution,
+   const projection_params& params
+) -> glm::mat4
+{
+   return std::visit(
+      [&](const auto& alternative) {return get_projection_matrix_impl(resolution, alternative); },
+      params
+   );
+}
+
+
+auto sfn::get_screen_pos(
+   const glm::mat4& view_projection,
+   const glm::ivec2& resolution,
+   const glm::vec3& pos
+) -> std::optional<glm::vec2>
+{
+   glm::vec4 screen_pos = view_projection * glm::vec4{ pos, 1.0f };
+   if (screen_pos[3] < 0)
+      return std::nullopt;
+   screen_pos /= screen_pos[3];
+
+   glm::vec2 result = 0.5f * (glm::vec2(screen_pos) + 1.0f);
+   result[1] = 1.0f - result[1];
+   result *= glm::vec2{ resolution };
+   return result;
+}
+
+
+auto sfn::update_camera(
+   camera_mode& mode,
+   const cam_info& info,
+   const camera_input& input
+) -> void
+{
+   std::visit(mouse_movement_visitor{ input.m_mouse_movement }, mode);
+
+   const auto center_tiler = [&]<typename T>(T & alternative) {
+      if constexpr (centery<T>)
+      {
+         if (input.m_forward)
+            alternative.vert_angle_offset += 0.01f;
+         if (input.m_backward)
+            alternative.vert_angle_offset -= 0.01f;
+         if (input.m_left)
+            alternative.horiz_angle_offset -= 0.01f;
+         if (input.m_right)
+            alternative.horiz_angle_offset += 0.01f;
+
+         constexpr float half_pi = glm::radians(85.0f);
+         alternative.vert_angle_offset = std::clamp(alternative.vert_angle_offset, -half_pi, half_pi);
+      }
+   };
+   std::visit(center_tiler, mode);
+
+   if (std::holds_alternative<wasd_mode>(mode))
+   {
+      auto& camera_pos = std::get<wasd_mode>(mode).m_camera_pos;
+      constexpr float ly_per_sec = 10.0f;
+
+      // The first frame after idling would jump otherwise
+      const float move_distance = std::min(input.m_frame_duration, 0.1f) * ly_per_sec;
+      if (input.m_forward)
+         camera_pos += move_distance * info.m_cs.m_front;
+      if (input.m_backward)
+         camera_pos += -move_distance * info.m_cs.m_front;
+      if (input.m_left)
+         camera_pos += -move_distance * info.m_cs.m_right;
+      if (input.m_right)
+         camera_pos += move_distance * info.m_cs.m_right;
+   }
+
+   if(std::holds_alternative<trailer_mode>(mode))
+   {
+      float& progress = std::get<trailer_mode>(mode).m_progress;
+      progress = std::fmod(progress + 0.002f, 1.0f);
+   }
+}
+
+
+auto sfn::get_obj_trafo_between_points(
+   const glm::vec3& p0,
+   const glm::vec3& p1,
+   const float diameter
+) -> glm::mat4
+{
+   glm::mat4 trafo(1.0f);
+
+   constexpr glm::vec3 galactic_cylinder{ 1, 0, 0 };
+   const glm::vec3 target_direction = glm::normalize(p1 - p0);
+   const float length = glm::distance(p1, p0);
+
+   trafo = glm::translate(trafo, p0);
+
+   const auto axis = glm::cross(galactic_cylinder, target_direction);
+   const float angle = glm::orientedAngle(galactic_cylinder, target_direction, axis);
+   trafo = glm::rotate(trafo, angle, axis);
+   const float radius = 0.5f * diameter;
+   trafo = glm::scale(trafo, glm::vec3{ length, radius, radius });
+   return trafo;
+}
+
+
+auto sfn::get_bb_trafos(const universe& univ) -> std::vector<glm::mat4>
+{
+   const std::vector<glm::vec3> x = get_bb_mesh(univ.m_map_bb, univ.m_trafo);
+   std::vector<glm::mat4> result;
+   result.reserve(x.size() / 2);
+   for (int i = 0; i < x.size()/2; ++i)
+   {
+      const glm::vec3 p0 = x[2 * i];
+      const glm::vec3 p1 = x[2 * i + 1];
+      result.push_back(get_obj_trafo_between_points(p0, p1, 0.1f));
+   }
+   return result;
+}
+
+
+auto sfn::get_connection_trafos(
+   const universe& univ,
+   const graph& connection_graph,
+   const position_mode mode
+) -> std::vector<glm::mat4>
+{
+   SFN_PROFILE_ZONE("connection mesh");
+   std::vector<glm::mat4> result;
+   result.reserve(connection_graph.m_connections.size());
+   for (const auto& [key, con] : connection_graph.m_connections)
+   {
+      const glm::vec3& p0 = univ.m_systems[con.m_node_index0].get_position(mode);
+      const glm::vec3& p1 = univ.m_systems[con.m_node_index1].get_position(mode);
+      result.push_back(get_obj_trafo_between_points(p0, p1, 0.05f));
+   }
+   return result;
+}
+
+
+auto sfn::get_star_instances(
+   const universe& univ,
+   const position_mode mode
+) -> std::vector<star_prop_element>
+{
+   constexpr glm::vec3 red{ 1.0f, 0.5f, 0.5f };
+   constexpr glm::vec3 green{ 0.5f, 1.0f, 0.5f };
+   constexpr glm::vec3 speculative_color{ 1, 1, 0 };
+
+   const position_arrays& positions = univ.m_arrays.get_positions(mode);
+   const std::vector<uint8_t>& flags = univ.m_arrays.m_flags;
+   std::vector<star_prop_element> result(positions.size());
+   for (int i = 0; i < positions.size(); ++i)
+   {
+      result[i].position = positions.get(i);
+      result[i].color = (flags[i] & system_flag_small) ? red : green;
+      if (flags[i] & system_flag_speculative)
+         result[i].color = speculative_color;
+   }
+   return result;
+}
+
+
+auto sfn::get_indicator_mesh(
+   const glm::vec3& center,
+   const cs& cs
+) -> std::vector<position_vertex_data>
+{
+   std::vector<position_vertex_data> result;
+   result.reserve(128);
+
+   constexpr float cross_extension = 1.0;
+   result.push_back(position_vertex_data{ .m_position = center - cross_extension* cs.m_front });
+   result.push_back(position_vertex_data{ .m_position = center + cross_extension* cs.m_front });
+   result.push_back(position_vertex_data{ .m_position = center - cross_extension* cs.m_right });
+   result.push_back(position_vertex_data{ .m_position = center + cross_extension* cs.m_right });
+   result.push_back(position_vertex_data{ .m_position = center - cross_extension* cs.m_up });
+   result.push_back(position_vertex_data{ .m_position = center + cross_extension* cs.m_up });
+
+   constexpr int circle_segments = 32;
+   const auto i_to_pos = [&](int i){
+      i = i % circle_segments;
+      const float angle = 1.0f * i / circle_segments * 2.0f * std::numbers::pi_v<float>;
+      const float x_rel = cross_extension * std::cos(angle);
+      const float y_rel = cross_extension * std::sin(angle);
+      return center + cs.m_right * x_rel + cs.m_front * y_rel;
+   };
+   for(int i=0; i<circle_segments; ++i)
+   {
+      result.push_back(position_vertex_data{ .m_position = i_to_pos(i)});
+      result.push_back(position_vertex_data{ .m_position = i_to_pos(i+1)});
+   }
+
+   return result;
+}
+
+
+auto sfn::build_frame(
+   const universe& univ,
+   const scene& scene,
+   const frame_settings& settings,
+   replay_frame* timings,
+   frame_description& frame
+) -> void
+{
+   SFN_PROFILE_ZONE("build frame");
+   frame.m_resolution = settings.m_resolution;
+   frame.m_steady_time = settings.m_steady_time;
+   frame.m_view = get_view_matrix(univ, settings.m_position_mode, settings.m_camera_mode);
+   frame.m_projection = get_projection_matrix(settings.m_resolution, settings.m_projection_params);
+   frame.m_cam_pos = get_camera_pos(univ, settings.m_position_mode, settings.m_camera_mode);
+   frame.m_selected_system_pos = univ.m_systems[settings.m_selection].get_position(settings.m_position_mode);
+
+   // assign() keeps the capacity, so this doesn't allocate after the first frames
+   add_star_lods(univ, scene, settings, frame);
+   frame.m_bb_trafos.clear();
+   if (settings.m_show_bb)
+      frame.m_bb_trafos.assign(std::cbegin(scene.m_bb_trafos), std::cend(scene.m_bb_trafos));
+   frame.m_connection_trafos.assign(std::cbegin(scene.m_connection_trafos), std::cend(scene.m_connection_trafos));
+   frame.m_connections_write_depth = settings.m_show_route == false;
+   frame.m_jump_lines.clear();
+   if (settings.m_show_route)
+      frame.m_jump_lines.assign(std::cbegin(scene.m_jump_lines), std::cend(scene.m_jump_lines));
+   const bool circling = std::holds_alternative<circle_mode>(settings.m_camera_mode) || std::holds_alternative<galactic_circle_mode>(settings.m_camera_mode);
+   frame.m_indicator.clear();
+   if (circling)
+      frame.m_indicator.assign(std::cbegin(scene.m_indicator), std::cend(scene.m_indicator));
+
+   frame.m_labels.clear();
+   const glm::mat4 view_projection = frame.m_projection * frame.m_view;
+   if (std::holds_alternative<galactic_circle_mode>(settings.m_camera_mode) && glm::distance(frame.m_selected_system_pos, frame.m_cam_pos) < 50.0f)
+      add_compass_labels(frame.m_selected_system_pos, view_projection, frame);
+   if (settings.m_show_labels)
+      add_system_labels(univ, settings, view_projection, timings, frame);
+}
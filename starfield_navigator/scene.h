@@ -0,0 +1,117 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <variant>
+#include <vector>
+
+#include "camera_replay.h"
+#include "frame_description.h"
+#include "graph.h"
+#include "universe.h"
+
+
+namespace sfn
+{
+   struct wasd_mode
+   {
+      glm::vec3 m_camera_pos{};
+   };
+   struct circle_mode
+   {
+      int m_planet;
+      float distance;
+      float horiz_angle_offset;
+      float vert_angle_offset;
+   };
+   struct galactic_circle_mode
+   {
+      int m_planet;
+      float distance;
+      float horiz_angle_offset;
+      float vert_angle_offset;
+   };
+   struct trailer_mode{
+      float m_progress = 0.0;
+   };
+   struct replay_mode
+   {
+      std::shared_ptr<const camera_path> m_path;
+      int m_frame = 0;
+   };
+
+   using camera_mode = std::variant<wasd_mode, circle_mode, galactic_circle_mode, trailer_mode, replay_mode>;
+
+   template<typename T>
+   concept centery = std::same_as<T, circle_mode> || std::same_as<T, galactic_circle_mode>;
+
+   struct ortho_params
+   {
+      float width = 50.0f;
+   };
+   struct perspective_params{};
+   using projection_params = std::variant<perspective_params, ortho_params>;
+
+   // What the user did to the camera since the last frame
+   struct camera_input
+   {
+      bool m_forward = false;
+      bool m_backward = false;
+      bool m_left = false;
+      bool m_right = false;
+      glm::vec2 m_mouse_movement{}; // in pixels
+      float m_frame_duration = 0.0f;
+   };
+
+   // Instance data that only changes on user action, kept between frames
+   struct scene
+   {
+      std::vector<star_prop_element> m_stars;
+      std::vector<glm::mat4> m_bb_trafos;
+      std::vector<glm::mat4> m_connection_trafos;
+      std::vector<line_vertex_data> m_jump_lines;
+      std::vector<position_vertex_data> m_indicator;
+   };
+
+   // The view settings of one frame
+   struct frame_settings
+   {
+      camera_mode m_camera_mode;
+      projection_params m_projection_params;
+      position_mode m_position_mode = position_mode::reconstructed;
+      glm::ivec2 m_resolution{};
+      int m_selection = 0;
+      float m_steady_time = 0.0f;
+      bool m_show_bb = true;
+      bool m_show_labels = true;
+      bool m_show_route = false; // the route is drawn over see-through connections
+   };
+
+   [[nodiscard]] auto get_camera_cs(const cam_info& info, const camera_mode& mode) -> cs;
+   [[nodiscard]] auto get_camera_pos(const universe& univ, const position_mode pos_mode, const camera_mode& mode) -> glm::vec3;
+   [[nodiscard]] auto get_camera_target(const universe& univ, const position_mode pos_mode, const camera_mode& mode) -> glm::vec3;
+   [[nodiscard]] auto get_view_matrix(const universe& univ, const position_mode pos_mode, const camera_mode& mode) -> glm::mat4;
+   [[nodiscard]] auto get_projection_matrix(const glm::ivec2& resolution, const projection_params& params) -> glm::mat4;
+   [[nodiscard]] auto get_screen_pos(const glm::mat4& view_projection, const glm::ivec2& resolution, const glm::vec3& pos) -> std::optional<glm::vec2>;
+
+   // Moves and turns the camera, and advances the animated ones by a frame
+   auto update_camera(camera_mode& mode, const cam_info& info, const camera_input& input) -> void;
+
+   // Instances of the unit cylinder
+   [[nodiscard]] auto get_obj_trafo_between_points(const glm::vec3& p0, const glm::vec3& p1, const float diameter) -> glm::mat4;
+   [[nodiscard]] auto get_bb_trafos(const universe& univ) -> std::vector<glm::mat4>;
+   [[nodiscard]] auto get_connection_trafos(const universe& univ, const graph& connection_graph, const position_mode mode) -> std::vector<glm::mat4>;
+
+   // Positions, colored by size and speculation
+   [[nodiscard]] auto get_star_instances(const universe& univ, const position_mode mode) -> std::vector<star_prop_element>;
+   [[nodiscard]] auto get_indicator_mesh(const glm::vec3& center, const cs& cs) -> std::vector<position_vertex_data>;
+
+   // Fills the frame, reusing its allocations. Culling and label projection go into the replay timings if there are any
+   auto build_frame(
+      const universe& univ,
+      const scene& scene,
+      const frame_settings& settings,
+      replay_frame* timings,
+      frame_description& frame
+   ) -> void;
+}
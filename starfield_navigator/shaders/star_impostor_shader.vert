@@ -0,0 +1,19 @@
+#version 450 core
+
+{{ubo_code}}
+
+uniform int instance_offset;
+uniform float pixels_per_unit;
+
+out float io_blink_weight;
+out vec3 io_color;
+
+void main()
+{
+   int star_index = instance_offset + gl_VertexID;
+   vec4 pos = projection * view * vec4(ssbo_data[star_index].position, 1.0);
+   gl_Position = pos;
+   gl_PointSize = clamp(2.0 * 0.3 * pixels_per_unit / pos.w, 1.0, 4.0);
+   io_color = ssbo_data[star_index].color;
+   io_blink_weight = (star_index == selected_index) ? 1.0 : 0.0;
+}
\ No newline at end of file
@@ -4,13 +4,16 @@ layout (location = 1) in vec3 position;
 
 {{ubo_code}}
 
+uniform int instance_offset;
+
 out float io_blink_weight;
 out vec3 io_color;
 
 void main()
 {
-   vec4 pos = projection * view * vec4(0.3*position + ssbo_data[gl_InstanceID].position, 1.0);
+   int star_index = instance_offset + gl_InstanceID;
+   vec4 pos = projection * view * vec4(0.3*position + ssbo_data[star_index].position, 1.0);
    gl_Position = pos;
-   io_color = ssbo_data[gl_InstanceID].color;
-   io_blink_weight = (gl_InstanceID == selected_index) ? 1.0 : 0.0;
+   io_color = ssbo_data[star_index].color;
+   io_blink_weight = (star_index == selected_index) ? 1.0 : 0.0;
 }
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "star_catalog.h"
+
+#include <algorithm>
+#include <numeric>
+
+#pragma warning(push, 0)
+#include <glm/common.hpp>
+#include <glm/matrix.hpp>
+#pragma warning(pop)
+
+
+namespace
+{
+   using namespace sfn;
+
+   // Caps the grid memory for sparse catalogs that span a lot of space
+   constexpr float max_cell_count = 1 << 20;
+
+
+   [[nodiscard]] auto get_region_bb(const catalog_region& region) -> bb_3D
+   {
+      if (const bb_3D* bb = std::get_if<bb_3D>(&region))
+         return *bb;
+      if (const sphere* s = std::get_if<sphere>(&region))
+         return bb_3D{ .m_min = s->m_center - s->m_radius, .m_max = s->m_center + s->m_radius };
+
+      const transformed_bb& tbb = std::get<transformed_bb>(region);
+      bb_3D result{ .m_min = glm::vec3{ std::numeric_limits<float>::max() }, .m_max = glm::vec3{ std::numeric_limits<float>::lowest() } };
+      for (int corner = 0; corner < 8; ++corner)
+      {
+         const glm::vec3 factors{ corner & 1, (corner >> 1) & 1, (corner >> 2) & 1 };
+         const glm::vec3 pos = apply_trafo(tbb.m_trafo, tbb.m_bb.m_min + factors * tbb.m_bb.get_size());
+         result.m_min = glm::min(result.m_min, pos);
+         result.m_max = glm::max(result.m_max, pos);
+      }
+      return result;
+   }
+
+
+   [[nodiscard]] auto get_region_center(const catalog_region& region) -> glm::vec3
+   {
+      if (const bb_3D* bb = std::get_if<bb_3D>(&region))
+         return bb->m_min + 0.5f * bb->get_size();
+      if (const sphere* s = std::get_if<sphere>(&region))
+         return s->m_center;
+      const transformed_bb& tbb = std::get<transformed_bb>(region);
+      return apply_trafo(tbb.m_trafo, tbb.m_bb.m_min + 0.5f * tbb.m_bb.get_size());
+   }
+
+
+   [[nodiscard]] auto is_inside(const bb_3D& bb, const glm::vec3& pos) -> bool
+   {
+      return pos.x >= bb.m_min.x && pos.x <= bb.m_max.x
+         && pos.y >= bb.m_min.y && pos.y <= bb.m_max.y
+         && pos.z >= bb.m_min.z && pos.z <= bb.m_max.z;
+   }
+
+} // namespace {}
+
+
+auto sfn::star_catalog::size() const -> int
+{
+   return static_cast<int>(std::ssize(m_x));
+}
+
+
+auto sfn::star_catalog::get_position(const int star_index) const -> glm::vec3
+{
+   return glm::vec3{ m_x[star_index], m_y[star_index], m_z[star_index] };
+}
+
+
+auto sfn::star_catalog::query(const catalog_query& query) const -> catalog_query_result
+{
+   catalog_query_result result;
+   if (m_cell_offsets.empty())
+      return result;
+
+   // Cells overlapping both the region and the distance band
+   bb_3D search_bb = get_region_bb(query.m_region);
+   if (query.m_max_distance < std::numeric_limits<float>::max())
+   {
+      search_bb.m_min = glm::max(search_bb.m_min, query.m_band_center - query.m_max_distance);
+      search_bb.m_max = glm::min(search_bb.m_max, query.m_band_center + query.m_max_distance);
+   }
+   const auto get_cell = [&](const glm::vec3& pos) {
+      return glm::clamp(glm::ivec3(glm::floor((pos - m_grid_origin) / m_cell_size)), glm::ivec3{ 0 }, m_grid_size - 1);
+   };
+   if (glm::any(glm::greaterThan(search_bb.m_min, search_bb.m_max)))
+      return result;
+   const glm::ivec3 cell_min = get_cell(search_bb.m_min);
+   const glm::ivec3 cell_max = get_cell(search_bb.m_max);
+
+   // Exact region test, the transformed box is tested in its own frame
+   const glm::mat4 inverse_trafo = std::holds_alternative<transformed_bb>(query.m_region)
+      ? glm::inverse(std::get<transformed_bb>(query.m_region).m_trafo)
+      : glm::mat4{ 1.0f };
+   const auto is_in_region = [&](const glm::vec3& pos) {
+      if (const sphere* s = std::get_if<sphere>(&query.m_region))
+      {
+         const glm::vec3 delta = pos - s->m_center;
+         return glm::dot(delta, delta) <= s->m_radius * s->m_radius;
+      }
+      if (const bb_3D* bb = std::get_if<bb_3D>(&query.m_region))
+         return is_inside(*bb, pos);
+      return is_inside(std::get<transformed_bb>(query.m_region).m_bb, apply_trafo(inverse_trafo, pos));
+   };
+
+   const glm::vec3 region_center = get_region_center(query.m_region);
+   const float min_distance2 = query.m_min_distance * query.m_min_distance;
+   const float max_distance2 = query.m_max_distance < std::numeric_limits<float>::max()
+      ? query.m_max_distance * query.m_max_distance
+      : std::numeric_limits<float>::max();
+   for (int z = cell_min.z; z <= cell_max.z; ++z)
+   {
+      for (int y = cell_min.y; y <= cell_max.y; ++y)
+      {
+         const int row_cell = (z * m_grid_size.y + y) * m_grid_size.x;
+         const int begin = m_cell_offsets[row_cell + cell_min.x];
+         const int end = m_cell_offsets[row_cell + cell_max.x + 1];
+         for (int i = begin; i < end; ++i)
+         {
+            // Cheap attribute tests first, they reject most stars
+            if (m_abs_mag[i] < query.m_min_abs_mag || m_abs_mag[i] > query.m_max_abs_mag)
+               continue;
+            if (query.m_exclude_known && m_known[i])
+               continue;
+            const glm::vec3 pos{ m_x[i], m_y[i], m_z[i] };
+            const glm::vec3 band_delta = pos - query.m_band_center;
+            const float distance2 = glm::dot(band_delta, band_delta);
+            if (distance2 < min_distance2 || distance2 > max_distance2)
+               continue;
+            if (is_in_region(pos) == false)
+               continue;
+
+            const float distance = std::sqrt(distance2);
+            const float score = -query.m_weights.m_brightness * m_abs_mag[i]
+               - query.m_weights.m_closeness * distance
+               - query.m_weights.m_centrality * glm::distance(pos, region_center);
+            result.m_candidates.push_back(catalog_candidate{ .m_star_index = i, .m_score = score, .m_distance = distance });
+         }
+      }
+   }
+
+   result.m_match_count = static_cast<int>(std::ssize(result.m_candidates));
+   const auto better = [](const catalog_candidate& a, const catalog_candidate& b) {
+      if (a.m_score != b.m_score)
+         return a.m_score > b.m_score;
+      return a.m_star_index < b.m_star_index;
+   };
+   const int kept_count = std::clamp(query.m_max_results, 0, result.m_match_count);
+   std::ranges::partial_sort(result.m_candidates, std::begin(result.m_candidates) + kept_count, better);
+   result.m_candidates.resize(kept_count);
+   return result;
+}
+
+
+auto sfn::get_star_catalog(
+   const std::vector<catalog_star>& stars,
+   const float cell_size
+) -> star_catalog
+{
+   star_catalog result;
+   if (stars.empty())
+      return result;
+
+   bb_3D bb{ .m_min = stars.front().m_position, .m_max = stars.front().m_position };
+   for (const catalog_star& star : stars)
+   {
+      bb.m_min = glm::min(bb.m_min, star.m_position);
+      bb.m_max = glm::max(bb.m_max, star.m_position);
+   }
+   const glm::vec3 size = glm::max(bb.get_size(), glm::vec3{ cell_size });
+   result.m_cell_size = std::max({ cell_size, std::cbrt(size.x * size.y * size.z / max_cell_count), 0.001f });
+   result.m_grid_origin = bb.m_min;
+   result.m_grid_size = glm::ivec3(glm::floor(bb.get_size() / result.m_cell_size)) + 1;
+
+   // Counting sort by cell
+   const auto get_cell_index = [&](const glm::vec3& pos) {
+      const glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor((pos - result.m_grid_origin) / result.m_cell_size)), glm::ivec3{ 0 }, result.m_grid_size - 1);
+      return (cell.z * result.m_grid_size.y + cell.y) * result.m_grid_size.x + cell.x;
+   };
+   const int cell_count = result.m_grid_size.x * result.m_grid_size.y * result.m_grid_size.z;
+   result.m_cell_offsets.assign(cell_count + 1, 0);
+   std::vector<int> cell_indices(std::ssize(stars));
+   for (int i = 0; i < std::ssize(stars); ++i)
+   {
+      cell_indices[i] = get_cell_index(stars[i].m_position);
+      ++result.m_cell_offsets[cell_indices[i] + 1];
+   }
+   std::partial_sum(std::begin(result.m_cell_offsets), std::end(result.m_cell_offsets), std::begin(result.m_cell_offsets));
+
+   const int star_count = static_cast<int>(std::ssize(stars));
+   result.m_x.resize(star_count);
+   result.m_y.resize(star_count);
+   result.m_z.resize(star_count);
+   result.m_abs_mag.resize(star_count);
+   result.m_known.resize(star_count);
+   result.m_names.resize(star_count);
+   std::vector<int> cursors(std::begin(result.m_cell_offsets), std::end(result.m_cell_offsets) - 1);
+   for (int i = 0; i < star_count; ++i)
+   {
+      const int target = cursors[cell_indices[i]]++;
+      result.m_x[target] = stars[i].m_position.x;
+      result.m_y[target] = stars[i].m_position.y;
+      result.m_z[target] = stars[i].m_position.z;
+      result.m_abs_mag[target] = stars[i].m_abs_mag;
+      result.m_known[target] = stars[i].m_known ? 1 : 0;
+      result.m_names[target] = pooled_string(stars[i].m_name);
+   }
+   return result;
+}
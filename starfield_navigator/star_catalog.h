@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <variant>
+#include <vector>
+
+#include "string_pool.h"
+#include "tools.h"
+
+#pragma warning(push, 0)
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#pragma warning(pop)
+
+
+namespace sfn
+{
+   struct sphere
+   {
+      glm::vec3 m_center{};
+      float m_radius = 0.0f;
+   };
+
+   // Box in its own frame, m_trafo maps it into catalog coordinates. That's how universe stores its map boxes
+   struct transformed_bb
+   {
+      bb_3D m_bb;
+      glm::mat4 m_trafo{ 1.0f };
+   };
+
+   using catalog_region = std::variant<bb_3D, transformed_bb, sphere>;
+
+   // Higher scores rank first. Every term is per magnitude or light-year
+   struct candidate_score_weights
+   {
+      float m_brightness = 1.0f; // brighter stars score higher
+      float m_closeness = 0.0f;  // closer to the distance band center scores higher
+      float m_centrality = 0.0f; // closer to the region center scores higher
+   };
+
+   struct catalog_query
+   {
+      catalog_region m_region = sphere{ .m_radius = 50.0f };
+      float m_min_abs_mag = -30.0f;
+      float m_max_abs_mag = 30.0f;
+      glm::vec3 m_band_center{}; // Sol by default
+      float m_min_distance = 0.0f;
+      float m_max_distance = std::numeric_limits<float>::max();
+      bool m_exclude_known = true;
+      candidate_score_weights m_weights;
+      int m_max_results = 50;
+   };
+
+   struct catalog_candidate
+   {
+      int m_star_index;
+      float m_score;
+      float m_distance; // to the band center
+   };
+
+   struct catalog_query_result
+   {
+      std::vector<catalog_candidate> m_candidates; // best first, at most m_max_results
+      int m_match_count = 0;                       // before the cut
+   };
+
+   struct catalog_star
+   {
+      glm::vec3 m_position;
+      float m_abs_mag;
+      std::string m_name;
+      bool m_known; // already a system of the universe
+   };
+
+   // Real stars in catalog coordinates, the same as position_mode::from_catalog. Sorted into a uniform grid so that
+   // every x-row of cells is one contiguous range of the arrays
+   struct star_catalog
+   {
+      std::vector<float> m_x;
+      std::vector<float> m_y;
+      std::vector<float> m_z;
+      std::vector<float> m_abs_mag;
+      std::vector<uint8_t> m_known;
+      std::vector<pooled_string> m_names;
+
+      glm::vec3 m_grid_origin{};
+      float m_cell_size = 1.0f;
+      glm::ivec3 m_grid_size{ 0 };
+      std::vector<int> m_cell_offsets; // stars of cell i are [m_cell_offsets[i], m_cell_offsets[i + 1])
+
+      [[nodiscard]] auto size() const -> int;
+      [[nodiscard]] auto get_position(const int star_index) const -> glm::vec3;
+      [[nodiscard]] auto query(const catalog_query& query) const -> catalog_query_result;
+   };
+
+   [[nodiscard]] auto get_star_catalog(const std::vector<catalog_star>& stars, const float cell_size = 10.0f) -> star_catalog;
+}
@@ -0,0 +1,53 @@
+#include "string_pool.h"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+
+namespace
+{
+   struct string_pool
+   {
+      // deque doesn't move its elements, so the views in the lookup stay valid
+      std::deque<std::string> m_strings{ std::string{} };
+      std::unordered_map<std::string_view, uint32_t> m_lookup{ {std::string_view{}, 0} };
+      std::mutex m_mutex;
+   };
+
+   [[nodiscard]] auto get_pool() -> string_pool&
+   {
+      static string_pool pool;
+      return pool;
+   }
+
+} // namespace {}
+
+
+sfn::pooled_string::pooled_string(const std::string_view str)
+{
+   string_pool& pool = get_pool();
+   std::lock_guard lock(pool.m_mutex);
+   const auto it = pool.m_lookup.find(str);
+   if (it != std::end(pool.m_lookup))
+   {
+      m_id = it->second;
+      return;
+   }
+   m_id = static_cast<uint32_t>(pool.m_strings.size());
+   const std::string& stored = pool.m_strings.emplace_back(str);
+   pool.m_lookup.emplace(stored, m_id);
+}
+
+
+auto sfn::pooled_string::get() const -> const std::string&
+{
+   return get_pool().m_strings[m_id];
+}
+
+
+auto sfn::pooled_string::empty() const -> bool
+{
+   return m_id == 0;
+}
+
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+namespace sfn
+{
+   // Handle into the global string pool. Equal strings are stored once and share a handle, so comparing handles
+   // compares strings. Interning happens while loading data, lookups afterwards aren't synchronized against it
+   struct pooled_string
+   {
+      uint32_t m_id = 0; // 0 is the empty string
+
+      pooled_string() = default;
+      explicit pooled_string(const std::string_view str);
+
+      [[nodiscard]] auto get() const -> const std::string&;
+      [[nodiscard]] auto empty() const -> bool;
+      friend auto operator==(const pooled_string&, const pooled_string&) -> bool = default;
+   };
+}
@@ -0,0 +1,73 @@
+#include "territory.h"
+
+#include <queue>
+#include <tuple>
+
+
+auto sfn::faction_territory::is_outdated(
+   const graph& jump_graph,
+   const position_mode mode
+) const -> bool
+{
+   return m_jump_range != jump_graph.m_jump_range || m_position_mode != mode || std::ssize(m_owners) != std::ssize(jump_graph.m_nodes);
+}
+
+
+auto sfn::get_faction_territory(
+   const graph& jump_graph,
+   const universe& universe,
+   const position_mode mode
+) -> faction_territory
+{
+   const int node_count = static_cast<int>(std::ssize(jump_graph.m_nodes));
+   faction_territory result{
+      .m_jump_range = jump_graph.m_jump_range,
+      .m_position_mode = mode,
+      .m_owners = std::vector<std::optional<factions>>(node_count),
+      .m_closest_seeds = std::vector<int>(node_count, -1),
+      .m_distances = std::vector<float>(node_count, shortest_path::no_distance)
+   };
+
+   // Entries are (distance, seed, node). Comparing the seed second settles ties toward the lower seed index
+   using entry = std::tuple<float, int, int>;
+   std::priority_queue<entry, std::vector<entry>, std::greater<>> queue;
+   for (int i = 0; i < node_count; ++i)
+   {
+      if (universe.m_systems[i].m_faction_seed.has_value() == false)
+         continue;
+      result.m_distances[i] = 0.0f;
+      result.m_closest_seeds[i] = i;
+      queue.emplace(0.0f, i, i);
+   }
+
+   while (queue.empty() == false)
+   {
+      const auto [distance, seed, current] = queue.top();
+      queue.pop();
+      if (distance != result.m_distances[current] || seed != result.m_closest_seeds[current])
+         continue;
+      result.m_owners[current] = universe.m_systems[seed].m_faction_seed;
+
+      for (const int neighbor : jump_graph.m_nodes[current].m_neighbor_nodes)
+      {
+         const float neighbor_distance = distance + universe.get_distance(current, neighbor, mode);
+         const bool is_closer = neighbor_distance < result.m_distances[neighbor];
+         const bool is_tie_winner = neighbor_distance == result.m_distances[neighbor] && seed < result.m_closest_seeds[neighbor];
+         if (is_closer == false && is_tie_winner == false)
+            continue;
+         result.m_distances[neighbor] = neighbor_distance;
+         result.m_closest_seeds[neighbor] = seed;
+         queue.emplace(neighbor_distance, seed, neighbor);
+      }
+   }
+
+   for (const id connection_id : jump_graph.m_sorted_connections)
+   {
+      const connection& con = jump_graph.m_connections.at(connection_id);
+      const std::optional<factions>& owner0 = result.m_owners[con.m_node_index0];
+      const std::optional<factions>& owner1 = result.m_owners[con.m_node_index1];
+      if (owner0.has_value() && owner1.has_value() && owner0 != owner1)
+         result.m_border_connections.push_back(con);
+   }
+   return result;
+}
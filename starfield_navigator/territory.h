@@ -0,0 +1,28 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "graph.h"
+#include "universe.h"
+
+
+namespace sfn
+{
+   struct faction_territory
+   {
+      float m_jump_range = 0.0f; // of the graph it was computed on
+      position_mode m_position_mode = position_mode::reconstructed;
+      std::vector<std::optional<factions>> m_owners; // std::nullopt if no seed can be reached
+      std::vector<int> m_closest_seeds;              // -1 if no seed can be reached
+      std::vector<float> m_distances;                // along the jumps to the closest seed
+      std::vector<connection> m_border_connections;  // connections between systems of different factions
+
+      [[nodiscard]] auto is_outdated(const graph& jump_graph, const position_mode mode) const -> bool;
+   };
+
+   // Every system goes to the faction of the closest seed system (see system::m_faction_seed) by jump distance. One
+   // Dijkstra pass starting from all seeds at once, so the cost doesn't grow with the number of factions or seeds.
+   // Equal distances go to the lower seed index, which keeps the result deterministic
+   [[nodiscard]] auto get_faction_territory(const graph& jump_graph, const universe& universe, const position_mode mode) -> faction_territory;
+}
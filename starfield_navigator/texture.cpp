@@ -1,6 +1,6 @@
 #include "texture.h"
 
-#include <execution>
+#include "thread_pool.h"
 
 #include <stb_image.h>
 
@@ -342,15 +342,10 @@ auto texture_manager::create_from_rgb_file(
    }
    if (linearize)
    {
-      std::transform(
-         std::execution::par_unseq,
-         std::cbegin(pixels),
-         std::cend(pixels),
-         std::begin(pixels),
-         [](const uint8_t rgb){
-            return srgb_to_linear_ui8(rgb);
-         }
-      );
+      const auto linearize_pixel = [&](const int i) {
+         pixels[i] = srgb_to_linear_ui8(pixels[i]);
+      };
+      parallel_for(0, byte_size, linearize_pixel);
    }
 
    sfn_assert(data != nullptr);
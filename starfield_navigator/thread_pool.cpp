@@ -0,0 +1,178 @@
+#include "thread_pool.h"
+
+
+namespace
+{
+   using namespace sfn;
+
+   thread_local const thread_pool* current_pool = nullptr;
+   thread_local int current_worker_index = -1;
+
+   std::mutex global_pool_mutex;
+   std::unique_ptr<thread_pool> global_pool;
+
+   [[nodiscard]] auto get_default_worker_count() -> int
+   {
+      const int hardware_threads = static_cast<int>(std::thread::hardware_concurrency());
+      return std::max(0, hardware_threads - 1); // the caller is the last thread
+   }
+
+} // namespace {}
+
+
+sfn::thread_pool::thread_pool(const int worker_count)
+{
+   for (int i = 0; i < worker_count + 1; ++i)
+      m_queues.push_back(std::make_unique<task_queue>());
+   m_workers.reserve(worker_count);
+   for (int i = 0; i < worker_count; ++i)
+      m_workers.emplace_back([this, i]() { worker_loop(i); });
+}
+
+
+sfn::thread_pool::~thread_pool()
+{
+   {
+      std::lock_guard lock(m_sleep_mutex);
+      m_stopping = true;
+   }
+   m_sleep_cv.notify_all();
+   for (std::thread& worker : m_workers)
+      worker.join();
+}
+
+
+auto sfn::thread_pool::get_thread_count() const -> int
+{
+   return static_cast<int>(std::ssize(m_workers)) + 1;
+}
+
+
+auto sfn::thread_pool::submit(task&& fn) -> void
+{
+   task_queue& queue = *m_queues[get_own_queue_index()];
+   {
+      std::lock_guard lock(queue.m_mutex);
+      queue.m_tasks.push_back(std::move(fn));
+   }
+   m_queued_count.fetch_add(1, std::memory_order_release);
+
+   // Taking the sleep mutex orders this with a worker that's just about to sleep, so the wakeup can't get lost
+   {
+      std::lock_guard lock(m_sleep_mutex);
+   }
+   m_sleep_cv.notify_one();
+}
+
+
+auto sfn::thread_pool::try_run_one() -> bool
+{
+   if (m_queued_count.load(std::memory_order_acquire) == 0)
+      return false;
+
+   const int own_index = get_own_queue_index();
+   std::optional<task> fn = try_pop(own_index, true);
+   const int queue_count = static_cast<int>(std::ssize(m_queues));
+   for (int offset = 1; offset < queue_count && fn.has_value() == false; ++offset)
+      fn = try_pop((own_index + offset) % queue_count, false);
+   if (fn.has_value() == false)
+      return false;
+
+   (*fn)();
+   return true;
+}
+
+
+auto sfn::thread_pool::get_own_queue_index() const -> int
+{
+   if (current_pool == this)
+      return current_worker_index;
+   return static_cast<int>(std::ssize(m_queues)) - 1;
+}
+
+
+auto sfn::thread_pool::try_pop(const int queue_index, const bool from_back) -> std::optional<task>
+{
+   task_queue& queue = *m_queues[queue_index];
+   std::lock_guard lock(queue.m_mutex);
+   if (queue.m_tasks.empty())
+      return std::nullopt;
+
+   std::optional<task> result;
+   if (from_back)
+   {
+      result.emplace(std::move(queue.m_tasks.back()));
+      queue.m_tasks.pop_back();
+   }
+   else
+   {
+      result.emplace(std::move(queue.m_tasks.front()));
+      queue.m_tasks.pop_front();
+   }
+   m_queued_count.fetch_sub(1, std::memory_order_relaxed);
+   return result;
+}
+
+
+auto sfn::thread_pool::worker_loop(const int worker_index) -> void
+{
+   current_pool = this;
+   current_worker_index = worker_index;
+   while (true)
+   {
+      if (try_run_one())
+         continue;
+
+      std::unique_lock lock(m_sleep_mutex);
+      m_sleep_cv.wait(lock, [&]() { return m_stopping || m_queued_count.load(std::memory_order_acquire) > 0; });
+      if (m_stopping && m_queued_count.load(std::memory_order_acquire) == 0)
+         return;
+   }
+}
+
+
+auto sfn::get_thread_pool() -> thread_pool&
+{
+   std::lock_guard lock(global_pool_mutex);
+   if (global_pool == nullptr)
+      global_pool = std::make_unique<thread_pool>(get_default_worker_count());
+   return *global_pool;
+}
+
+
+auto sfn::set_thread_count(const int thread_count) -> void
+{
+   std::lock_guard lock(global_pool_mutex);
+   global_pool.reset();
+   global_pool = std::make_unique<thread_pool>(std::max(0, thread_count - 1));
+}
+
+
+sfn::task_group::task_group(thread_pool& pool)
+   : m_pool(pool)
+{
+
+}
+
+
+sfn::task_group::~task_group()
+{
+   wait();
+}
+
+
+auto sfn::task_group::wait() -> void
+{
+   while (m_pending.load(std::memory_order_acquire) > 0)
+   {
+      if (m_pool.try_run_one() == false)
+         std::this_thread::yield();
+   }
+}
+
+
+auto sfn::get_auto_grain(const int count) -> int
+{
+   const int chunk_count = 4 * get_thread_pool().get_thread_count();
+   return std::max(1, count / chunk_count);
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+
+namespace sfn
+{
+   // Work-stealing scheduler. Every worker owns a deque: it pushes and pops its own tasks at the back, idle workers
+   // steal from the front. Threads outside the pool submit into an extra shared queue. Waiting threads help out
+   // instead of blocking, so nested parallelism can't deadlock
+   struct thread_pool
+   {
+      using task = std::function<void()>;
+
+      explicit thread_pool(const int worker_count);
+      ~thread_pool();
+      thread_pool(const thread_pool&) = delete;
+      thread_pool& operator=(const thread_pool&) = delete;
+
+      // Workers plus the waiting caller
+      [[nodiscard]] auto get_thread_count() const -> int;
+      auto submit(task&& fn) -> void;
+
+      // Runs one queued task on the calling thread, if there is any
+      auto try_run_one() -> bool;
+
+   private:
+      struct task_queue
+      {
+         std::mutex m_mutex;
+         std::deque<task> m_tasks;
+      };
+
+      std::vector<std::unique_ptr<task_queue>> m_queues; // one per worker, last one for external threads
+      std::vector<std::thread> m_workers;
+      std::atomic<int> m_queued_count = 0;
+      std::atomic<bool> m_stopping = false;
+      std::mutex m_sleep_mutex;
+      std::condition_variable m_sleep_cv;
+
+      [[nodiscard]] auto get_own_queue_index() const -> int;
+      [[nodiscard]] auto try_pop(const int queue_index, const bool from_back) -> std::optional<task>;
+      auto worker_loop(const int worker_index) -> void;
+   };
+
+   // Global pool, sized to the hardware on first use
+   [[nodiscard]] auto get_thread_pool() -> thread_pool&;
+
+   // Replaces the global pool. Only call while no parallel work is running
+   auto set_thread_count(const int thread_count) -> void;
+
+   // Tasks that can be waited on together. The destructor waits
+   struct task_group
+   {
+      explicit task_group(thread_pool& pool);
+      ~task_group();
+      task_group(const task_group&) = delete;
+      task_group& operator=(const task_group&) = delete;
+
+      template<typename T>
+      auto run(T&& fn) -> void;
+      auto wait() -> void;
+
+   private:
+      thread_pool& m_pool;
+      std::atomic<int> m_pending = 0;
+   };
+
+   // Ranges are split recursively down to the grain size. A grain of 0 picks one that gives every thread a few chunks
+   template<typename T>
+   auto parallel_for(const int begin, const int end, const T& fn, const int grain = 0) -> void;
+
+   // Chunks are reduced in index order, so results don't depend on the scheduling
+   template<typename T, typename map_type, typename reduce_type>
+   [[nodiscard]] auto parallel_reduce(const int begin, const int end, const T& identity, const map_type& map, const reduce_type& reduce, const int grain = 0) -> T;
+
+   [[nodiscard]] auto get_auto_grain(const int count) -> int;
+}
+
+
+template<typename T>
+auto sfn::task_group::run(T&& fn) -> void
+{
+   m_pending.fetch_add(1, std::memory_order_relaxed);
+   m_pool.submit(
+      [this, fn = std::forward<T>(fn)]() mutable
+      {
+         fn();
+         m_pending.fetch_sub(1, std::memory_order_release);
+      }
+   );
+}
+
+
+template<typename T>
+auto sfn::parallel_for(
+   const int begin,
+   const int end,
+   const T& fn,
+   const int grain
+) -> void
+{
+   if (end <= begin)
+      return;
+   const int chunk_size = grain > 0 ? grain : get_auto_grain(end - begin);
+   if (end - begin <= chunk_size)
+   {
+      for (int i = begin; i < end; ++i)
+         fn(i);
+      return;
+   }
+
+   task_group group(get_thread_pool());
+   const auto split = [&](const auto& self, const int range_begin, int range_end) -> void
+   {
+      // Hand off the upper halves, keep the lowest chunk
+      while (range_end - range_begin > chunk_size)
+      {
+         const int mid = range_begin + (range_end - range_begin) / 2;
+         group.run([&self, mid, range_end]() { self(self, mid, range_end); });
+         range_end = mid;
+      }
+      for (int i = range_begin; i < range_end; ++i)
+         fn(i);
+   };
+   split(split, begin, end);
+   group.wait();
+}
+
+
+template<typename T, typename map_type, typename reduce_type>
+auto sfn::parallel_reduce(
+   const int begin,
+   const int end,
+   const T& identity,
+   const map_type& map,
+   const reduce_type& reduce,
+   const int grain
+) -> T
+{
+   if (end <= begin)
+      return identity;
+   const int chunk_size = grain > 0 ? grain : get_auto_grain(end - begin);
+   const int chunk_count = (end - begin + chunk_size - 1) / chunk_size;
+   std::vector<std::optional<T>> partials(chunk_count);
+   const auto reduce_chunk = [&](const int chunk)
+   {
+      const int chunk_begin = begin + chunk * chunk_size;
+      const int chunk_end = std::min(end, chunk_begin + chunk_size);
+      T partial = identity;
+      for (int i = chunk_begin; i < chunk_end; ++i)
+         partial = reduce(partial, map(i));
+      partials[chunk] = partial;
+   };
+   parallel_for(0, chunk_count, reduce_chunk, 1);
+
+   T result = identity;
+   for (const std::optional<T>& partial : partials)
+      result = reduce(result, *partial);
+   return result;
+}
@@ -1,7 +1,19 @@
 #include "timing_provider.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+
+#pragma warning(push, 0)
+#include <fmt/format.h>
+#pragma warning(pop)
+
+
 namespace
 {
+   using namespace sfn;
+
    [[nodiscard]] auto get_tp_diff_in_seconds(
       const std::chrono::high_resolution_clock::time_point& first,
       const std::chrono::high_resolution_clock::time_point& second
@@ -11,6 +23,94 @@ namespace
       const float seconds = static_cast<float>(ns) / 1'000'000'000.0f;
       return seconds;
    }
+
+
+   [[nodiscard]] auto get_tp_diff_in_us(
+      const std::chrono::high_resolution_clock::time_point& first,
+      const std::chrono::high_resolution_clock::time_point& second
+   ) -> int64_t
+   {
+      return std::chrono::duration_cast<std::chrono::microseconds>(second - first).count();
+   }
+
+
+   [[nodiscard]] auto get_percentiles(
+      const duration_histogram& histogram,
+      const std::vector<frame_sample>& window,
+      int64_t frame_sample::* member
+   ) -> duration_percentiles
+   {
+      duration_percentiles result{
+         .m_p50 = histogram.get_percentile(0.50),
+         .m_p95 = histogram.get_percentile(0.95),
+         .m_p99 = histogram.get_percentile(0.99)
+      };
+
+      // Exact, the window is small
+      for (const frame_sample& sample : window)
+         result.m_max = std::max(result.m_max, sample.*member);
+      return result;
+   }
+}
+
+
+auto sfn::duration_histogram::get_bucket_index(const int64_t us) -> int
+{
+   const uint64_t value = static_cast<uint64_t>(std::max<int64_t>(0, us));
+   if (value < sub_bucket_count)
+      return static_cast<int>(value);
+
+   // value >> shift lands in [32, 64)
+   const int shift = std::bit_width(value) - std::bit_width(static_cast<uint64_t>(sub_bucket_count));
+   const int index = sub_bucket_count + shift * sub_bucket_count + static_cast<int>((value >> shift) - sub_bucket_count);
+   return std::min(index, bucket_count - 1);
+}
+
+
+auto sfn::duration_histogram::get_bucket_upper_bound(const int bucket_index) -> int64_t
+{
+   if (bucket_index < sub_bucket_count)
+      return bucket_index;
+   const int shift = (bucket_index - sub_bucket_count) / sub_bucket_count;
+   const int64_t sub_bucket = (bucket_index - sub_bucket_count) % sub_bucket_count + sub_bucket_count;
+   return ((sub_bucket + 1) << shift) - 1;
+}
+
+
+auto sfn::duration_histogram::add(const int64_t us) -> void
+{
+   ++m_counts[get_bucket_index(us)];
+   ++m_total_count;
+}
+
+
+auto sfn::duration_histogram::remove(const int64_t us) -> void
+{
+   --m_counts[get_bucket_index(us)];
+   --m_total_count;
+}
+
+
+auto sfn::duration_histogram::clear() -> void
+{
+   m_counts.fill(0);
+   m_total_count = 0;
+}
+
+
+auto sfn::duration_histogram::get_percentile(const double fraction) const -> int64_t
+{
+   if (m_total_count == 0)
+      return 0;
+   const int rank = std::max(1, static_cast<int>(std::ceil(fraction * m_total_count)));
+   int cumulative = 0;
+   for (int i = 0; i < bucket_count; ++i)
+   {
+      cumulative += m_counts[i];
+      if (cumulative >= rank)
+         return get_bucket_upper_bound(i);
+   }
+   return get_bucket_upper_bound(bucket_count - 1);
 }
 
 
@@ -19,7 +119,13 @@ sfn::timing_provider::timing_provider()
    , m_last_frame_t(m_t0)
    , m_t_last_fps(m_t0)
 {
+   m_window.reserve(window_capacity);
+}
+
 
+auto sfn::timing_provider::mark_swap_begin() -> void
+{
+   m_swap_begin_t = std::chrono::high_resolution_clock::now();
 }
 
 
@@ -29,12 +135,40 @@ auto sfn::timing_provider::mark_frame_end() -> void
 
    ++m_fps_frame_count;
 
+   // Rolling window. Without a swap mark the whole frame counts as CPU time
+   const auto swap_begin = m_swap_begin_t.value_or(now);
+   const frame_sample sample{
+      .m_frame_index = m_frame_count,
+      .m_frame_us = get_tp_diff_in_us(m_last_frame_t, now),
+      .m_cpu_us = get_tp_diff_in_us(m_last_frame_t, swap_begin),
+      .m_swap_us = get_tp_diff_in_us(swap_begin, now)
+   };
+   m_swap_begin_t.reset();
+   if (std::ssize(m_window) < window_capacity)
+   {
+      m_window.push_back(sample);
+   }
+   else
+   {
+      frame_sample& oldest = m_window[m_frame_count % window_capacity];
+      m_frame_histogram.remove(oldest.m_frame_us);
+      m_cpu_histogram.remove(oldest.m_cpu_us);
+      m_swap_histogram.remove(oldest.m_swap_us);
+      oldest = sample;
+   }
+   m_frame_histogram.add(sample.m_frame_us);
+   m_cpu_histogram.add(sample.m_cpu_us);
+   m_swap_histogram.add(sample.m_swap_us);
+   if (sample.m_frame_us > m_budget_us)
+      ++m_over_budget_total;
+   ++m_frame_count;
+
    // frame duration
    m_next_timing_info.m_last_frame_duration = static_cast<float>(get_tp_diff_in_seconds(m_last_frame_t, now));
    m_last_frame_t = now;
 
    // steady time
-   m_next_timing_info.m_steady_time = get_tp_diff_in_seconds(m_t0, now);;
+   m_next_timing_info.m_steady_time = get_tp_diff_in_seconds(m_t0, now);
 
    // fps
    const float seconds_since_last_fps_query = get_tp_diff_in_seconds(m_t_last_fps, now);
@@ -57,3 +191,51 @@ auto sfn::timing_provider::get_timing_info() const -> timing_info
    return m_next_timing_info;
 }
 
+
+auto sfn::timing_provider::get_frame_stats() const -> frame_stats
+{
+   frame_stats result{
+      .m_frame = get_percentiles(m_frame_histogram, m_window, &frame_sample::m_frame_us),
+      .m_cpu = get_percentiles(m_cpu_histogram, m_window, &frame_sample::m_cpu_us),
+      .m_swap = get_percentiles(m_swap_histogram, m_window, &frame_sample::m_swap_us),
+      .m_window_size = static_cast<int>(std::ssize(m_window)),
+      .m_over_budget_total = m_over_budget_total,
+      .m_frame_count = m_frame_count
+   };
+   result.m_over_budget_in_window = static_cast<int>(std::ranges::count_if(m_window, [&](const frame_sample& sample) {
+      return sample.m_frame_us > m_budget_us;
+   }));
+   return result;
+}
+
+
+auto sfn::timing_provider::get_window() const -> std::vector<frame_sample>
+{
+   std::vector<frame_sample> result = m_window;
+   std::ranges::sort(result, {}, &frame_sample::m_frame_index);
+   return result;
+}
+
+
+auto sfn::timing_provider::get_budget_us() const -> int64_t
+{
+   return m_budget_us;
+}
+
+
+auto sfn::timing_provider::set_budget_us(const int64_t budget_us) -> void
+{
+   m_budget_us = budget_us;
+}
+
+
+auto sfn::timing_provider::write_csv(const std::string& path) const -> bool
+{
+   std::ofstream file(path);
+   if (file.is_open() == false)
+      return false;
+   file << "frame,frame_us,cpu_us,swap_us,over_budget\n";
+   for (const frame_sample& sample : get_window())
+      file << fmt::format("{},{},{},{},{}\n", sample.m_frame_index, sample.m_frame_us, sample.m_cpu_us, sample.m_swap_us, sample.m_frame_us > m_budget_us ? 1 : 0);
+   return file.good();
+}
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
 
 
 namespace sfn
@@ -12,21 +17,92 @@ namespace sfn
       std::optional<int> m_last_fps;
    };
 
-   // yields: time (for sin etc), fps, delta frame time
+   // HDR histogram style: exact below 32 us, above that 32 linear buckets per power of two, so values are off by at
+   // most ~3%. Counts can be removed again, which keeps it in sync with a rolling window
+   struct duration_histogram
+   {
+      static constexpr inline int sub_bucket_count = 32;
+      static constexpr inline int bucket_count = 1024;
+
+      std::array<int, bucket_count> m_counts{};
+      int m_total_count = 0;
+
+      auto add(const int64_t us) -> void;
+      auto remove(const int64_t us) -> void;
+      auto clear() -> void;
+
+      // Upper bound of the bucket that holds the given fraction of values, 0 if empty
+      [[nodiscard]] auto get_percentile(const double fraction) const -> int64_t;
+
+      [[nodiscard]] static auto get_bucket_index(const int64_t us) -> int;
+      [[nodiscard]] static auto get_bucket_upper_bound(const int bucket_index) -> int64_t;
+   };
+
+   // Microseconds
+   struct duration_percentiles
+   {
+      int64_t m_p50 = 0;
+      int64_t m_p95 = 0;
+      int64_t m_p99 = 0;
+      int64_t m_max = 0;
+   };
+
+   struct frame_sample
+   {
+      int64_t m_frame_index;
+      int64_t m_frame_us; // start of the frame to the start of the next one
+      int64_t m_cpu_us;   // until the swap
+      int64_t m_swap_us;  // swap and vsync wait
+   };
+
+   struct frame_stats
+   {
+      duration_percentiles m_frame;
+      duration_percentiles m_cpu;
+      duration_percentiles m_swap;
+      int m_window_size = 0;
+      int m_over_budget_in_window = 0;
+      int64_t m_over_budget_total = 0;
+      int64_t m_frame_count = 0;
+   };
+
+   // yields: time (for sin etc), fps, delta frame time. Keeps a rolling window of frame, CPU and swap durations
    struct timing_provider
    {
    private:
       std::chrono::high_resolution_clock::time_point m_t0; // steady time
       std::chrono::high_resolution_clock::time_point m_last_frame_t; // for delta frame time
       std::chrono::high_resolution_clock::time_point m_t_last_fps; // for fps
+      std::optional<std::chrono::high_resolution_clock::time_point> m_swap_begin_t;
       int m_fps_frame_count = 0;
       timing_info m_next_timing_info{};
 
+      static constexpr inline int window_capacity = 1024;
+      std::vector<frame_sample> m_window; // ring buffer
+      int64_t m_frame_count = 0;
+      int64_t m_over_budget_total = 0;
+      int64_t m_budget_us = 1'000'000 / 60;
+      duration_histogram m_frame_histogram;
+      duration_histogram m_cpu_histogram;
+      duration_histogram m_swap_histogram;
+
    public:
       explicit timing_provider();
+
+      // Call right before swapping buffers, splits the frame into CPU work and swap wait
+      auto mark_swap_begin() -> void;
       auto mark_frame_end() -> void;
 
       [[nodiscard]] auto get_timing_info() const -> timing_info;
+      [[nodiscard]] auto get_frame_stats() const -> frame_stats;
+
+      // Oldest first
+      [[nodiscard]] auto get_window() const -> std::vector<frame_sample>;
+
+      [[nodiscard]] auto get_budget_us() const -> int64_t;
+      auto set_budget_us(const int64_t budget_us) -> void;
+
+      [[nodiscard]] auto write_csv(const std::string& path) const -> bool;
    };
 
 }
@@ -1,9 +1,11 @@
 #include "universe.h"
 
+#include <atomic>
 
-#include <execution>
-
+#include "arena.h"
 #include "graph.h"
+#include "profiler.h"
+#include "thread_pool.h"
 
 #pragma warning(push, 0)    
 #include <glm/geometric.hpp>
@@ -38,17 +40,17 @@ namespace
 
 auto sfn::system::get_useful_name() const -> std::optional<std::string>
 {
-   if (is_id_triplet(m_name) && m_astronomic_name.empty())
+   if (is_id_triplet(m_name.get()) && m_astronomic_name.empty())
       return std::nullopt;
    return this->get_name();
 }
 
 auto sfn::system::get_name() const -> std::string
 {
-   std::string result = m_astronomic_name;
-   if (is_id_triplet(m_name) == false && str_tolower(m_astronomic_name) != str_tolower(m_name))
+   std::string result = m_astronomic_name.get();
+   if (is_id_triplet(m_name.get()) == false && str_tolower(m_astronomic_name.get()) != str_tolower(m_name.get()))
    {
-      result += fmt::format(" (\"{}\")", m_name);
+      result += fmt::format(" (\"{}\")", m_name.get());
    }
    return result;
 
@@ -65,9 +67,9 @@ auto sfn::system::get_name() const -> std::string
 
 auto sfn::system::get_starfield_name() const -> std::optional<std::string>
 {
-   if (is_id_triplet(m_name))
+   if (is_id_triplet(m_name.get()))
       return std::nullopt;
-   return m_name;
+   return m_name.get();
 }
 
 
@@ -89,19 +91,76 @@ sfn::system::system(
    const float abs_mag,
    const bool speculative
 )
-   : m_name(name)
+   : m_reconstructed_position(pos)
+   , m_catalog_position(pos)
+   , m_abs_mag(abs_mag)
+   , m_name(name)
    , m_astronomic_name(astronomic_name)
    , m_catalog_lookup(catalog)
-   , m_reconstructed_position(pos)
    , m_size(size)
-   , m_abs_mag(abs_mag)
    , m_speculative(speculative)
 {
    static int unnamed_count = 0;
    if (name.empty())
-      m_name = fmt::format("UNNAMED {}", unnamed_count++);
+      m_name = pooled_string(fmt::format("UNNAMED {}", unnamed_count++));
+}
+
+auto sfn::get_faction_name(const factions faction) -> const char*
+{
+   switch (faction)
+   {
+   case factions::uc: return "United Colonies";
+   case factions::freestar: return "Freestar Collective";
+   case factions::crimson: return "Crimson Fleet";
+   }
+   std::terminate();
+}
+
+
+auto sfn::position_arrays::push_back(const glm::vec3& pos) -> void
+{
+   m_x.push_back(pos[0]);
+   m_y.push_back(pos[1]);
+   m_z.push_back(pos[2]);
+}
+
+
+auto sfn::position_arrays::get(const int index) const -> glm::vec3
+{
+   return glm::vec3{ m_x[index], m_y[index], m_z[index] };
+}
+
+
+auto sfn::position_arrays::size() const -> int
+{
+   return static_cast<int>(std::ssize(m_x));
+}
+
+
+auto sfn::position_arrays::get_span() const -> point_span
+{
+   return get_span(0, size());
+}
+
+
+auto sfn::position_arrays::get_span(const int begin, const int end) const -> point_span
+{
+   return point_span{
+      .m_x = m_x.data() + begin,
+      .m_y = m_y.data() + begin,
+      .m_z = m_z.data() + begin,
+      .m_count = end - begin,
+      .m_first_index = begin
+   };
+}
+
+
+auto sfn::universe_arrays::get_positions(const position_mode mode) const -> const position_arrays&
+{
+   return m_positions[static_cast<int>(mode)];
 }
 
+
 cs::cs(const glm::vec3& front, const glm::vec3& up)
    : m_front(front)
    , m_up(up)
@@ -122,11 +181,47 @@ auto universe::init() -> void
 
    for(const system& sys : m_systems)
    {
-      if (sys.m_name == "SOL")
+      if (sys.m_name.get() == "SOL")
          continue;
       m_min_abs_mag = std::min(m_min_abs_mag, sys.m_abs_mag);
       m_max_abs_mag = std::max(m_max_abs_mag, sys.m_abs_mag);
    }
+
+   m_arrays = universe_arrays{};
+   for (const position_mode mode : { position_mode::reconstructed, position_mode::from_catalog })
+   {
+      position_arrays& positions = m_arrays.m_positions[static_cast<int>(mode)];
+      positions.m_x.reserve(m_systems.size());
+      positions.m_y.reserve(m_systems.size());
+      positions.m_z.reserve(m_systems.size());
+      for (const system& sys : m_systems)
+         positions.push_back(sys.get_position(mode));
+   }
+   m_arrays.m_abs_mag.reserve(m_systems.size());
+   m_arrays.m_flags.reserve(m_systems.size());
+   for (const system& sys : m_systems)
+   {
+      m_arrays.m_abs_mag.push_back(sys.m_abs_mag);
+      uint8_t flags = 0;
+      if (sys.m_speculative)
+         flags |= system_flag_speculative;
+      if (sys.m_size == system_size::small)
+         flags |= system_flag_small;
+      m_arrays.m_flags.push_back(flags);
+   }
+
+   static std::atomic<uint64_t> next_generation = 0;
+   m_generation = ++next_generation;
+
+   m_name_index.clear();
+   for (int i = 0; i < std::ssize(m_systems); ++i)
+   {
+      m_name_index.add(m_systems[i].m_name.get(), i);
+      m_name_index.add(m_systems[i].m_astronomic_name.get(), i);
+   }
+   for (int i = 0; i < std::ssize(m_systems); ++i)
+      m_name_index.add(m_systems[i].m_catalog_lookup.get(), i);
+   m_name_index.finalize();
 }
 
 auto sfn::universe::get_position_by_name(const std::string& name, const position_mode mode) const -> glm::vec3
@@ -137,58 +232,110 @@ auto sfn::universe::get_position_by_name(const std::string& name, const position
 
 auto sfn::universe::get_index_by_name(const std::string& name) const -> int
 {
-   for (int i = 0; i < std::ssize(m_systems); ++i)
-   {
-      if (m_systems[i].m_name == name || m_systems[i].m_astronomic_name == name)
-         return i;
-   }
-   std::terminate();
+   const std::optional<int> index = find_index_by_name(name);
+   sfn_assert(index.has_value(), fmt::format("system \"{}\" not found", name));
+   return *index;
+}
+
+
+auto sfn::universe::find_index_by_name(const std::string& name) const -> std::optional<int>
+{
+   return m_name_index.find(name);
 }
 
 
 auto universe::get_distance(const int a, const int b, const position_mode mode) const -> float
 {
-   return glm::distance(
-      m_systems[a].get_position(mode),
-      m_systems[b].get_position(mode)
-   );
+   const position_arrays& positions = m_arrays.get_positions(mode);
+   return glm::distance(positions.get(a), positions.get(b));
 }
 
 
 
-auto sfn::get_graph_from_universe(const universe& universe, const float jump_range) -> graph
+auto sfn::get_graph_from_universe(
+   const universe& universe,
+   const float jump_range,
+   std::pmr::memory_resource* resource,
+   const graph_build build
+) -> graph
 {
-   graph result;
+   SFN_PROFILE_ZONE("graph build");
+   graph result(resource);
    result.m_jump_range = jump_range;
-   result.m_nodes.reserve(universe.m_systems.size());
-   result.m_connections.reserve(universe.m_systems.size() * universe.m_systems.size());
-   result.m_sorted_connections.reserve(universe.m_systems.size() * universe.m_systems.size());
 
-   const float jump_range2 = jump_range * jump_range;
-   for (int i = 0; i < std::ssize(universe.m_systems); ++i)
+   const position_arrays& positions = universe.m_arrays.get_positions(position_mode::reconstructed);
+   const int system_count = positions.size();
+
+   // Two passes over the rows, parallel unless asked otherwise: count the neighbors, then write them to their offsets in
+   // flat arrays. The graph itself is filled serially
+   const auto find_row_neighbors = [&](const int i, int*& indices, float*& distances2) -> int
    {
-      result.m_nodes.push_back(
-         node{
-            .m_index = i
-         }
-      );
+      thread_local std::vector<int> indices_scratch;
+      thread_local std::vector<float> distances2_scratch;
+      indices_scratch.resize(system_count);
+      distances2_scratch.resize(system_count);
+      indices = indices_scratch.data();
+      distances2 = distances2_scratch.data();
+      const point_span rest = positions.get_span(i + 1, system_count);
+      return get_within_radius(positions.get(i), rest, jump_range, indices, distances2);
+   };
+   const auto for_each_row = [&](const auto& fn)
+   {
+      if (build == graph_build::parallel)
+      {
+         parallel_for(0, system_count, fn, 64);
+         return;
+      }
+      for (int i = 0; i < system_count; ++i)
+         fn(i);
+   };
+   std::pmr::vector<int> row_offsets(system_count + 1, 0, resource);
+   for_each_row([&](const int i) {
+      int* indices;
+      float* distances2;
+      row_offsets[i + 1] = find_row_neighbors(i, indices, distances2);
+   });
+   for (int i = 0; i < system_count; ++i)
+      row_offsets[i + 1] += row_offsets[i];
+
+   const int connection_count = row_offsets[system_count];
+   std::pmr::vector<int> neighbor_indices(connection_count, resource);
+   std::pmr::vector<float> neighbor_distances(connection_count, resource);
+   for_each_row([&](const int i) {
+      int* indices;
+      float* distances2;
+      const int neighbor_count = find_row_neighbors(i, indices, distances2);
+      for (int k = 0; k < neighbor_count; ++k)
+      {
+         neighbor_indices[row_offsets[i] + k] = indices[k];
+         neighbor_distances[row_offsets[i] + k] = std::sqrt(distances2[k]);
+      }
+   });
+
+   std::pmr::vector<int> degrees(system_count, 0, resource);
+   for (const int j : neighbor_indices)
+      ++degrees[j];
+   result.m_nodes.reserve(system_count);
+   for (int i = 0; i < system_count; ++i)
+   {
+      result.m_nodes.emplace_back(i);
+      result.m_nodes[i].m_neighbor_nodes.reserve(degrees[i] + row_offsets[i + 1] - row_offsets[i]);
    }
+   result.m_connections.reserve(connection_count);
+   result.m_sorted_connections.reserve(connection_count);
 
-   for (int i = 0; i < universe.m_systems.size(); ++i)
+   for (int i = 0; i < system_count; ++i)
    {
-      for (int j = i + 1; j < universe.m_systems.size(); ++j)
+      for (int k = row_offsets[i]; k < row_offsets[i + 1]; ++k)
       {
-         const float distance2 = glm::distance2(universe.m_systems[i].get_position(position_mode::reconstructed), universe.m_systems[j].get_position(position_mode::reconstructed));
-         if (distance2 > jump_range2)
-            continue;
-
+         const int j = neighbor_indices[k];
          const id connection_id = id::create();
          result.m_connections.emplace(
             connection_id,
             connection{
                .m_node_index0 = i,
                .m_node_index1 = j,
-               .m_weight = std::sqrt(distance2)
+               .m_weight = neighbor_distances[k]
             }
          );
          result.m_sorted_connections.emplace_back(connection_id);
@@ -214,22 +361,25 @@ auto sfn::get_min_jump_dist(
    const position_mode mode
 ) -> float
 {
-   const float total_dist = glm::distance(
-      universe.m_systems[start_index].get_position(mode),
-      universe.m_systems[dest_index].get_position(mode)
-   );
+   const float total_dist = universe.get_distance(start_index, dest_index, mode);
+
+   // Graph and paths live in the thread's scratch arena, each iteration rewinds its own allocations. The graph is
+   // built serially, queries run in parallel with each other instead and stay off the heap
+   const arena_scope query_scope;
 
    // Initialize the graph with the total distance. That is guaranteed to work
    // graph minimum_graph(universe, 26.0f);
-   graph minimum_graph = get_graph_from_universe(universe, total_dist + 0.001f);
+   graph minimum_graph = get_graph_from_universe(universe, total_dist + 0.001f, query_scope.get_resource(), graph_build::serial);
 
    float necessary_jumprange = std::numeric_limits<float>::max();
    while (true)
    {
+      const arena_scope iteration_scope;
+
       // Plot a course through that graph
       // If no jump is possible, the previously calculated longest jump is the minimum required range
       const auto distance_getter = [&](const int i, const int j) {return universe.get_distance(i, j, mode); };
-      const std::optional<jump_path> plot = minimum_graph.get_jump_path(start_index, dest_index, distance_getter);
+      const std::optional<jump_path> plot = minimum_graph.get_jump_path(start_index, dest_index, distance_getter, iteration_scope.get_resource());
       if (plot.has_value() == false || plot->m_stops.size() == 1)
       {
          return necessary_jumprange;
@@ -238,10 +388,7 @@ auto sfn::get_min_jump_dist(
       float longest_jump = 0.0f;
       for (int i = 0; i < plot->m_stops.size() - 1; ++i)
       {
-         const float dist = glm::distance(
-            universe.m_systems[plot->m_stops[i]].get_position(mode),
-            universe.m_systems[plot->m_stops[i + 1]].get_position(mode)
-         );
+         const float dist = universe.get_distance(plot->m_stops[i], plot->m_stops[i + 1], mode);
          longest_jump = std::max(longest_jump, dist);
       }
 
@@ -270,34 +417,39 @@ auto sfn::get_min_jump_dist(
 }
 
 
+auto sfn::get_route(
+   const universe& universe,
+   const int start_index,
+   const int dest_index,
+   const float jump_range,
+   const position_mode mode
+) -> std::optional<jump_path>
+{
+   const arena_scope scope;
+   const graph route_graph = get_graph_from_universe(universe, jump_range, scope.get_resource());
+   const auto distance_getter = [&](const int i, const int j) {return universe.get_distance(i, j, mode); };
+   const std::optional<jump_path> path = route_graph.get_jump_path(start_index, dest_index, distance_getter, scope.get_resource());
+   if (path.has_value() == false)
+      return std::nullopt;
+   return jump_path{ .m_stops = std::pmr::vector<int>(path->m_stops, std::pmr::get_default_resource()) };
+}
+
+
 auto sfn::get_absolute_min_jump_range(
    const universe& universe,
    const position_mode mode
 ) -> float
 {
-   timer t;
-   std::vector<std::pair<int, int>> connections;
-   connections.reserve(universe.m_systems.size() * universe.m_systems.size());
-   for (int i = 0; i < universe.m_systems.size(); ++i)
-   {
-      for (int j = i + 1; j < universe.m_systems.size(); ++j)
-      {
-         connections.emplace_back(i, j);
-      }
-   }
-   std::vector<float> results;
-   results.resize(connections.size());
-
-   std::transform(
-      std::execution::par_unseq,
-      std::cbegin(connections),
-      std::cend(connections),
-      std::begin(results),
-      [&](const std::pair<int, int>& ppp)
-      {
-         return get_min_jump_dist(universe, ppp.first, ppp.second, mode);
-      }
-   );
+   const int system_count = static_cast<int>(std::ssize(universe.m_systems));
 
-   return *std::ranges::max_element(results);
+   // Rows get shorter towards the end, stealing evens that out
+   const auto get_row_max = [&](const int i)
+   {
+      float row_max = 0.0f;
+      for (int j = i + 1; j < system_count; ++j)
+         row_max = std::max(row_max, get_min_jump_dist(universe, i, j, mode));
+      return row_max;
+   };
+   const auto max = [](const float a, const float b) { return std::max(a, b); };
+   return parallel_reduce(0, system_count, 0.0f, get_row_max, max, 1);
 }
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <array>
+#include <memory_resource>
 #include <string>
 #include <vector>
 #include <optional>
 
+#include "distance_kernels.h"
 #include "tools.h"
+#include "name_index.h"
+#include "star_catalog.h"
+#include "string_pool.h"
 
 #include <glm/vec3.hpp>
 
@@ -13,18 +19,22 @@ namespace sfn
 {
 
    enum class factions { uc, freestar, crimson };
-   enum class system_size{big, small};
+   constexpr inline int faction_count = 3;
+   [[nodiscard]] auto get_faction_name(const factions faction) -> const char*;
+   enum class system_size : uint8_t {big, small};
    enum class position_mode{reconstructed, from_catalog};
 
+   // Hot data inline, names are handles into the string pool. Keeps copying and sorting cheap
    struct system {
-      std::string m_name;
-      std::string m_astronomic_name;
-      std::string m_catalog_lookup;
       glm::vec3 m_reconstructed_position;
       glm::vec3 m_catalog_position;
-      system_size m_size = system_size::big;
       float m_abs_mag;
+      pooled_string m_name;
+      pooled_string m_astronomic_name;
+      pooled_string m_catalog_lookup;
+      system_size m_size = system_size::big;
       bool m_speculative = false;
+      std::optional<factions> m_faction_seed; // faction home systems, territory grows from these
 
       [[nodiscard]] auto get_useful_name() const -> std::optional<std::string>;
       [[nodiscard]] auto get_name() const -> std::string;
@@ -34,6 +44,31 @@ namespace sfn
       explicit system(const glm::vec3& pos, const std::string& name, const std::string& astronomic_name, const std::string& catalog, const system_size size, const float abs_mag, const bool speculative);
    };
 
+   enum system_flags : uint8_t { system_flag_speculative = 1 << 0, system_flag_small = 1 << 1 };
+
+   struct position_arrays
+   {
+      std::vector<float> m_x;
+      std::vector<float> m_y;
+      std::vector<float> m_z;
+
+      auto push_back(const glm::vec3& pos) -> void;
+      [[nodiscard]] auto get(const int index) const -> glm::vec3;
+      [[nodiscard]] auto size() const -> int;
+      [[nodiscard]] auto get_span() const -> point_span;
+      [[nodiscard]] auto get_span(const int begin, const int end) const -> point_span;
+   };
+
+   // Structure-of-arrays copy of the hot per-system data for the distance-heavy loops. Rebuilt by universe::init()
+   struct universe_arrays
+   {
+      std::array<position_arrays, 2> m_positions; // indexed by position_mode
+      std::vector<float> m_abs_mag;
+      std::vector<uint8_t> m_flags;
+
+      [[nodiscard]] auto get_positions(const position_mode mode) const -> const position_arrays&;
+   };
+
    struct cs
    {
       glm::vec3 m_front{};
@@ -58,17 +93,27 @@ namespace sfn
       glm::mat4 m_trafo;
       bb_3D m_map_bb;
       bb_3D m_left_bb;
+      star_catalog m_catalog; // the real stars, for speculative candidates
+      name_index m_name_index;
+      universe_arrays m_arrays;
+      uint64_t m_generation = 0; // new on every init(), for caches keyed on the positions
 
       auto init() -> void;
       [[nodiscard]] auto get_position_by_name(const std::string& name, const position_mode mode) const -> glm::vec3;
       [[nodiscard]] auto get_index_by_name(const std::string& name) const -> int;
+      [[nodiscard]] auto find_index_by_name(const std::string& name) const -> std::optional<int>;
       [[nodiscard]] auto get_distance(const int a, const int b, const position_mode mode) const -> float;
    };
 
    struct graph;
-   auto get_graph_from_universe(const universe& universe, const float jump_range) -> graph;
+   struct jump_path;
+   enum class graph_build{parallel, serial};
+   // Serial builds don't touch the thread pool, whose task submission allocates on the heap
+   auto get_graph_from_universe(const universe& universe, const float jump_range, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), const graph_build build = graph_build::parallel) -> graph;
 
    [[nodiscard]] auto get_min_jump_dist(const universe& universe, const int start_index, const int dest_index, const position_mode mode) -> float;
+   // Path with the given jump range, std::nullopt if there is none. Only the result is allocated outside the thread arena
+   [[nodiscard]] auto get_route(const universe& universe, const int start_index, const int dest_index, const float jump_range, const position_mode mode) -> std::optional<jump_path>;
    [[nodiscard]] auto get_absolute_min_jump_range(const universe& universe, const position_mode mode) -> float;
 
 }
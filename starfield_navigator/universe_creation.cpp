@@ -2,7 +2,11 @@
 
 #include <vector>
 #include <fstream>
+#include <numeric>
+#include <unordered_set>
 
+#include "profiler.h"
+#include "thread_pool.h"
 #include "universe.h"
 #include "tools.h"
 
@@ -23,7 +27,7 @@ namespace {
       {
          const auto camera_pred = [&](const sfn::system& sys)
          {
-            return sys.m_name.starts_with(target);
+            return sys.m_name.get().starts_with(target);
          };
          const auto it = std::ranges::find_if(systems, camera_pred);
          if (it == std::end(systems))
@@ -66,66 +70,23 @@ namespace {
    }
 
 
-   auto get_real_entries() -> real_universe
-   {
-      // std::ifstream input("cc_hip1997.txt");
-      // std::ifstream input("cc_hip2007.txt");
-      std::ifstream input("cc_hyg.txt");
-      real_universe result;
-      for (std::string line; getline(input, line); )
-      {
-         if (line.starts_with("#"))
-            continue;
-         const auto split = get_split_string(line, ";");
-         const std::string catalog_str = get_trimmed_str(split[0]);
-         const galactic_coord galactic{
-            .m_l = glm::radians(std::stof(split[1])),
-            .m_b = glm::radians(std::stof(split[2])),
-            .m_dist = std::stof(split[3])
-         };
-         const float abs_mag = std::stof(split[5]);
-
-         result.m_stars.emplace(
-            get_catalog_id(catalog_str),
-            real_star{
-               .m_position = galactic.get_cartesian(),
-               .m_abs_mag = abs_mag
-            }
-            
-         );
-      }
-
-      return result;
-   }
-
-
-   [[nodiscard]] auto get_error(
-      const universe& fiction,
-      const ::real_universe& real,
-      const std::string& fictional_name,
-      const std::string& hip
-   ) -> float
-   {
-      const glm::vec3 fiction_pos = fiction.get_position_by_name(fictional_name, position_mode::reconstructed);
-      const glm::vec3 real_pos = real.get_star_by_cat_id(hip).m_position;
-      return glm::distance(fiction_pos, real_pos);
-   };
-
-
    [[nodiscard]] auto get_metric(
       const universe& univ,
       const ::real_universe& real
    ) -> float
    {
-      std::vector<float> errors;
-      errors.reserve(100);
-
+      position_arrays fiction_positions;
+      position_arrays real_positions;
       for (const sfn::system& system : univ.m_systems)
       {
-         if (system.m_astronomic_name.empty() || system.m_astronomic_name == "Sol" || system.m_speculative == true)
+         if (system.m_astronomic_name.empty() || system.m_astronomic_name.get() == "Sol" || system.m_speculative == true)
             continue;
-         errors.push_back(get_error(univ, real, system.m_astronomic_name, system.m_catalog_lookup));
+         fiction_positions.push_back(univ.get_position_by_name(system.m_astronomic_name.get(), position_mode::reconstructed));
+         real_positions.push_back(real.get_star_by_cat_id(system.m_catalog_lookup.get()).m_position);
       }
+
+      std::vector<float> errors(fiction_positions.size());
+      get_paired_distances(fiction_positions.get_span(), real_positions.get_span(), errors.data());
       return get_average(errors);
    };
 
@@ -158,6 +119,20 @@ namespace {
    }
 
 
+   [[nodiscard]] auto get_faction(const std::string& faction_str) -> std::optional<factions>
+   {
+      if (faction_str.empty())
+         return std::nullopt;
+      if (faction_str == "uc")
+         return factions::uc;
+      if (faction_str == "freestar")
+         return factions::freestar;
+      if (faction_str == "crimson")
+         return factions::crimson;
+      std::terminate();
+   }
+
+
    [[nodiscard]] auto get_unexplored_bb(
       const bb_3D& visible_bb,
       const glm::vec3& sol_position
@@ -185,7 +160,7 @@ namespace {
       for (const auto& m_system : m_universe.m_systems)
       {
          const glm::vec3 pos = m_system.get_position(position_mode::from_catalog);
-         std::string safe_name = m_system.m_astronomic_name;
+         std::string safe_name = m_system.m_astronomic_name.get();
          const auto it = safe_name.find('\'');
          if (it != std::string::npos)
             safe_name = safe_name.replace(it, 1, "");
@@ -239,6 +214,37 @@ auto real_universe::get_star_by_cat_id(const std::string& cat_id) const -> const
 }
 
 
+auto sfn::get_real_entries(const std::string& path) -> real_universe
+{
+   std::ifstream input(path);
+   real_universe result;
+   for (std::string line; getline(input, line); )
+   {
+      if (line.starts_with("#"))
+         continue;
+      const auto split = get_split_string(line, ";");
+      const std::string catalog_str = get_trimmed_str(split[0]);
+      const galactic_coord galactic{
+         .m_l = glm::radians(std::stof(split[1])),
+         .m_b = glm::radians(std::stof(split[2])),
+         .m_dist = std::stof(split[3])
+      };
+      const float abs_mag = std::stof(split[5]);
+
+      result.m_stars.emplace(
+         get_catalog_id(catalog_str),
+         real_star{
+            .m_position = galactic.get_cartesian(),
+            .m_abs_mag = abs_mag
+         }
+         
+      );
+   }
+
+   return result;
+}
+
+
 sfn::CTestOpt::CTestOpt()
 {
    updateDims(9);
@@ -258,15 +264,33 @@ void sfn::CTestOpt::getMaxValues(double* const p) const
    p[6] = 100.0; p[7] = 100.0; p[8] = 100.0;
 }
 
-double sfn::CTestOpt::optcost(const double* const p)
+auto sfn::CTestOpt::init_targets() -> void
 {
-   universe transformed_universe = *fiction_ref;
-   const glm::mat4 trafo = get_trafo_from_vector(p);
-   for (sfn::system& elem : transformed_universe.m_systems)
+   // Same pairs as get_metric(), but resolved once instead of on every cost evaluation
+   m_targets.clear();
+   for (const sfn::system& system : fiction_ref->m_systems)
    {
-      elem.m_reconstructed_position = apply_trafo(trafo, elem.m_reconstructed_position);
+      if (system.m_astronomic_name.empty() || system.m_astronomic_name.get() == "Sol" || system.m_speculative == true)
+         continue;
+      m_targets.push_back(
+         alignment_target{
+            .m_fiction_pos = fiction_ref->get_position_by_name(system.m_astronomic_name.get(), position_mode::reconstructed),
+            .m_real_pos = real_ref->get_star_by_cat_id(system.m_catalog_lookup.get()).m_position
+         }
+      );
    }
-   return static_cast<double>(get_metric(transformed_universe, *real_ref));
+}
+
+double sfn::CTestOpt::optcost(const double* const p)
+{
+   const glm::mat4 trafo = get_trafo_from_vector(p);
+   const auto get_target_error = [&](const int i) {
+      return glm::distance(apply_trafo(trafo, m_targets[i].m_fiction_pos), m_targets[i].m_real_pos);
+   };
+   // Only worth splitting once there are a lot more targets than the named systems
+   constexpr int grain = 256;
+   const float error_sum = parallel_reduce(0, static_cast<int>(std::ssize(m_targets)), 0.0f, get_target_error, std::plus<float>{}, grain);
+   return static_cast<double>(error_sum / std::size(m_targets));
 }
 
 auto sfn::CTestOpt::get_trafo_from_vector(const double* const p) -> glm::mat4
@@ -276,7 +300,7 @@ auto sfn::CTestOpt::get_trafo_from_vector(const double* const p) -> glm::mat4
 
 
 universe_creator::universe_creator()
-   : m_real_universe(get_real_entries())
+   : m_real_universe(get_real_entries("cc_hyg.txt"))
 {
    std::ifstream input("system_data.txt");
 
@@ -350,6 +374,10 @@ universe_creator::universe_creator()
          }
          constexpr bool speculative = false;
          m_starfield_universe.m_systems.emplace_back(pos, name, astronomical_name, catalog_entry, get_system_size(values[0]), abs_mag, speculative);
+
+         // Optional fifth value, after the constellation
+         if (values.size() >= 5)
+            m_starfield_universe.m_systems.back().m_faction_seed = get_faction(get_trimmed_str(values[4]));
       }
       else if(mode == read_mode::speculative)
       {
@@ -367,17 +395,20 @@ universe_creator::universe_creator()
       return a.m_reconstructed_position.x < b.m_reconstructed_position.x;
    };
    std::ranges::sort(m_starfield_universe.m_systems, pred);
+   m_starfield_universe.init();
 
 
    rnd.init(1); // Needs to be seeded with different values on each run.
    opt.fiction_ref = &m_starfield_universe;
    opt.real_ref = &m_real_universe;
+   opt.init_targets();
    opt.init(rnd);
 }
 
 
 auto sfn::universe_creator::get() -> creator_result
 {
+   SFN_PROFILE_ZONE("alignment");
    constexpr int n = 20000;
    constexpr int increment = n / 100;
    for (int run = 0; run<increment; ++i, ++run)
@@ -411,7 +442,7 @@ auto universe_creator::get_finished_result() -> universe
 
    const auto no_speculative_or_cam = [&](const auto& vertex) -> std::optional<glm::vec3>
    {
-      if (vertex.m_speculative || vertex.m_name.starts_with("cam"))
+      if (vertex.m_speculative || vertex.m_name.get().starts_with("cam"))
          return std::nullopt;
       return vertex.get_position(position_mode::reconstructed);
    };
@@ -425,52 +456,52 @@ auto universe_creator::get_finished_result() -> universe
          continue;
       sys.m_reconstructed_position = apply_trafo(final_transformation, sys.m_reconstructed_position);
    }
+   m_starfield_universe.init(); // arrays need the transformed positions
    fmt::print("metric with optimized trafo: {:.2f} LY\n", get_metric(m_starfield_universe, m_real_universe));
 
 
+   // Distances to all candidates in one kernel call, then only the closest three get sorted
+   const auto get_closest = [](const glm::vec3& pos, const position_arrays& candidates)
+   {
+      std::vector<float> distances(candidates.size());
+      get_distances(pos, candidates.get_span(), distances.data());
+      std::vector<int> closest(candidates.size());
+      std::iota(std::begin(closest), std::end(closest), 0);
+      const auto closest_end = std::begin(closest) + std::min<ptrdiff_t>(3, std::ssize(closest));
+      std::partial_sort(std::begin(closest), closest_end, std::end(closest), [&](const int i, const int j) {
+         return distances[i] < distances[j];
+      });
+      closest.erase(closest_end, std::end(closest));
+      std::vector<std::pair<int, float>> result;
+      for (const int i : closest)
+         result.emplace_back(i, distances[i]);
+      return result;
+   };
    const auto candidates_for_fictional = [&](const std::string& fictional_name, const position_mode mode)
    {
       const glm::vec3 pos0 = m_starfield_universe.get_position_by_name(fictional_name, mode);
-      std::vector<catalog_id> real_closest;
+      std::vector<catalog_id> real_ids;
+      position_arrays real_positions;
       for (const auto& [key, value] : m_real_universe.m_stars)
       {
-         real_closest.push_back(key);
+         real_ids.push_back(key);
+         real_positions.push_back(value.m_position);
       }
-      const auto pred = [&](const catalog_id& i, const catalog_id& j)
-      {
-         const float dist_i = glm::distance(pos0, m_real_universe.m_stars.at(i).m_position);
-         const float dist_j = glm::distance(pos0, m_real_universe.m_stars.at(j).m_position);
-         return dist_i < dist_j;
-      };
-      std::ranges::sort(real_closest, pred);
       fmt::print("\n");
-      for (int i = 0; i < 3; ++i)
+      for (int i = 0; const auto& [real_index, dist] : get_closest(pos0, real_positions))
       {
-         const float dist = glm::distance(pos0, m_real_universe.m_stars.at(real_closest[i]).m_position);
          fmt::print(
             "{}: {}, dist: {:.2f}\n",
-            i, real_closest[i].get_user_str(), dist
+            i++, real_ids[real_index].get_user_str(), dist
          );
       }
    };
    const auto candidates_for_real = [&](const std::string& cat_id)
    {
       const glm::vec3 target_pos = m_real_universe.get_star_by_cat_id(cat_id).m_position;
-      std::vector<int> real_closest;
-      for (int i = 0; i < std::ssize(m_starfield_universe.m_systems); ++i)
-         real_closest.push_back(i);
-      const auto pred = [&](const int i, const int j)
+      for (const auto& [system_index, dist] : get_closest(target_pos, m_starfield_universe.m_arrays.get_positions(position_mode::reconstructed)))
       {
-         const float dist_i = glm::distance(target_pos, m_starfield_universe.m_systems[i].m_reconstructed_position);
-         const float dist_j = glm::distance(target_pos, m_starfield_universe.m_systems[j].m_reconstructed_position);
-         return dist_i < dist_j;
-      };
-      std::ranges::sort(real_closest, pred);
-      // fmt::print("\n");
-      for (int i = 0; i < 3; ++i)
-      {
-         const float dist = glm::distance(target_pos, m_starfield_universe.m_systems[real_closest[i]].m_reconstructed_position);
-         // fmt::print("{}: {:.2f} {}\n", i, dist, m_starfield_universe.m_systems[i].get_name());
+         // fmt::print("{:.2f} {}\n", dist, m_starfield_universe.m_systems[system_index].get_name());
       }
    };
    // candidates_for_real("HIP 91262"); // vega
@@ -486,17 +517,47 @@ auto universe_creator::get_finished_result() -> universe
 
    for (const sfn::system& system : m_starfield_universe.m_systems)
    {
-      if (system.m_astronomic_name.empty() || system.m_astronomic_name == "Sol")
+      if (system.m_astronomic_name.empty() || system.m_astronomic_name.get() == "Sol")
          continue;
-      error_report(system.m_astronomic_name, system.m_catalog_lookup);
+      error_report(system.m_astronomic_name.get(), system.m_catalog_lookup.get());
    }
 
 
    m_starfield_universe.m_cam_info = get_and_delete_cam_info(m_starfield_universe.m_systems);
+
+   // Save real coordinates
+   for(system& sys : m_starfield_universe.m_systems)
+   {
+      if (sys.m_catalog_lookup.empty())
+      {
+         sys.m_catalog_position = sys.m_reconstructed_position;
+         continue;
+      }
+      else
+         sys.m_catalog_position = m_real_universe.get_star_by_cat_id(sys.m_catalog_lookup.get()).m_position;
+   }
+
+   m_starfield_universe.init(); // indices shifted
    m_starfield_universe.m_trafo = final_transformation;
    m_starfield_universe.m_map_bb = old_coord_bb;
-   m_starfield_universe.m_left_bb = get_unexplored_bb(old_coord_bb, m_starfield_universe.get_position_by_name("SOL", position_mode::reconstructed));;
-   m_starfield_universe.init();
+   m_starfield_universe.m_left_bb = get_unexplored_bb(old_coord_bb, m_starfield_universe.get_position_by_name("SOL", position_mode::reconstructed));
+
+   {
+      std::unordered_set<std::string> known_entries;
+      for (const sfn::system& sys : m_starfield_universe.m_systems)
+         known_entries.insert(sys.m_catalog_lookup.get());
+      std::vector<catalog_star> catalog_stars;
+      catalog_stars.reserve(m_real_universe.m_stars.size());
+      for (const auto& [cat_id, star] : m_real_universe.m_stars)
+      {
+         const std::string& name = cat_id.get_user_str();
+         catalog_stars.push_back(catalog_star{ .m_position = star.m_position, .m_abs_mag = star.m_abs_mag, .m_name = name, .m_known = known_entries.contains(name) });
+      }
+
+      // Hash map order isn't stable, the catalog should be
+      std::ranges::sort(catalog_stars, {}, &catalog_star::m_name);
+      m_starfield_universe.m_catalog = get_star_catalog(catalog_stars);
+   }
 
    // std::vector<std::string> mu_herculis_ids{ "HIP 86974", "GLIESE 695B", "GLIESE 695C" };
    // std::vector<std::string> zet_herculis_ids{ "HIP 81693", "GLIESE 635B" };
@@ -511,18 +572,6 @@ auto universe_creator::get_finished_result() -> universe
    //    }
    // }
 
-   // Save real coordinates
-   for(system& sys : m_starfield_universe.m_systems)
-   {
-      if (sys.m_catalog_lookup.empty())
-      {
-         sys.m_catalog_position = sys.m_reconstructed_position;
-         continue;
-      }
-      else
-         sys.m_catalog_position = m_real_universe.get_star_by_cat_id(sys.m_catalog_lookup).m_position;
-   }
-
    // {
    //    const float sufficient_jump_range = get_absolute_min_jump_range(starfield_universe);
    //    fmt::print("sufficient_jump_range: {:.1f}\n", sufficient_jump_range);
@@ -46,10 +46,20 @@ namespace sfn{
       [[nodiscard]] auto get_star_by_cat_id(const std::string& cat_id) const -> const real_star&;
    };
 
+   // Reads a catalog in the cc_hyg.txt format: "id;l;b;distance;mag;abs_mag" per line
+   [[nodiscard]] auto get_real_entries(const std::string& path) -> real_universe;
+
+   struct alignment_target
+   {
+      glm::vec3 m_fiction_pos;
+      glm::vec3 m_real_pos;
+   };
+
    struct CTestOpt : public CBiteOpt
    {
       const universe* fiction_ref;
       const real_universe* real_ref;
+      std::vector<alignment_target> m_targets;
       // 0, 1, 2: rotation angles
       // 3, 4, 5: scale factors
       // 6, 7, 8: translation
@@ -58,6 +68,7 @@ namespace sfn{
       auto getMinValues(double* const p) const -> void override;
       auto getMaxValues(double* const p) const -> void override;
       [[nodiscard]] static auto get_trafo_from_vector(const double* const p) -> glm::mat4;
+      auto init_targets() -> void;
       auto optcost(const double* const p) -> double override;
    };
 